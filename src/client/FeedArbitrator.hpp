@@ -0,0 +1,155 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <endian.h>
+
+#include "FeedDecoder.hpp"
+
+enum class Feed : uint8_t { A, B };
+
+// Merges the redundant A and B copies of the market data feed into one gap-free stream for a
+// FeedDecoder. The first copy of each sequence number to arrive is taken and the other is
+// dropped as a duplicate. Messages are handed to the decoder in sequence order: one that
+// arrives after a hole waits in a window of WINDOW_SIZE slots until the hole is filled by the
+// other feed. A hole is only a gap once both feeds have moved past it. Each feed is in order on
+// its own, so a feed that has moved past a sequence number will not deliver it any more.
+//
+// Seen sequence numbers are bits in a bitmap over the window, so telling a duplicate costs one
+// bit test. A feed that stops entirely would keep holes open; they are given up once the
+// window is full, or by Flush when the socket goes quiet.
+template<typename Handler>
+class FeedArbitrator
+{
+public:
+    static constexpr size_t WINDOW_SIZE = 4096;
+    static constexpr size_t MAX_MESSAGE_SIZE = 64;
+
+    struct Stats
+    {
+        std::array<uint64_t, 2> received{};
+        std::array<uint64_t, 2> taken{};
+        uint64_t duplicates = 0;
+    };
+
+private:
+    static_assert(std::has_single_bit(WINDOW_SIZE));
+
+    FeedDecoder<Handler> decoder;
+
+    // Next sequence number to hand to the decoder, and the highest each feed has delivered
+    uint64_t nextSequenceNumber = 1;
+    std::array<uint64_t, 2> highest{};
+
+    // Bit and slot `s % WINDOW_SIZE` belong to sequence number s in [next, next + WINDOW_SIZE)
+    std::array<uint64_t, WINDOW_SIZE / 64> seen{};
+    std::array<uint16_t, WINDOW_SIZE> lengths{};
+    std::array<std::array<char, MAX_MESSAGE_SIZE>, WINDOW_SIZE> slots;
+
+    Stats stats;
+
+    static size_t Slot(uint64_t sequenceNumber)
+    {
+        return sequenceNumber & (WINDOW_SIZE - 1);
+    }
+
+    bool IsSeen(uint64_t sequenceNumber) const
+    {
+        return seen[Slot(sequenceNumber) / 64] & (uint64_t(1) << (sequenceNumber % 64));
+    }
+
+    void SetSeen(uint64_t sequenceNumber)
+    {
+        seen[Slot(sequenceNumber) / 64] |= uint64_t(1) << (sequenceNumber % 64);
+    }
+
+    void ClearSeen(uint64_t sequenceNumber)
+    {
+        seen[Slot(sequenceNumber) / 64] &= ~(uint64_t(1) << (sequenceNumber % 64));
+    }
+
+    // Hands buffered messages to the decoder from the next sequence number on, skipping holes
+    // below `giveUpBelow`
+    void Drain(uint64_t giveUpBelow)
+    {
+        // Nothing past the window is buffered, so a longer run of holes is skipped at once
+        for (uint64_t end = std::min(giveUpBelow, nextSequenceNumber + WINDOW_SIZE); nextSequenceNumber < end; nextSequenceNumber++)
+            if (IsSeen(nextSequenceNumber))
+                Deliver(nextSequenceNumber);
+        nextSequenceNumber = std::max(nextSequenceNumber, giveUpBelow);
+
+        for (; IsSeen(nextSequenceNumber); nextSequenceNumber++)
+            Deliver(nextSequenceNumber);
+    }
+
+    void Deliver(uint64_t sequenceNumber)
+    {
+        ClearSeen(sequenceNumber);
+        size_t slot = Slot(sequenceNumber);
+        decoder.Decode(slots[slot].data(), lengths[slot]);
+    }
+
+public:
+    explicit FeedArbitrator(Handler & handler) : decoder(handler) {}
+
+    // Returns false once the end of market hours message has been decoded
+    bool OnPacket(Feed feed, const char* data, size_t length)
+    {
+        if (length < sizeof(ItchHeader) || length > MAX_MESSAGE_SIZE)
+            return !decoder.Finished();
+
+        uint64_t sequenceNumber = be64toh(reinterpret_cast<const ItchHeader*>(data)->sequenceNumber);
+        auto index = static_cast<size_t>(feed);
+        stats.received[index]++;
+        highest[index] = std::max(highest[index], sequenceNumber);
+
+        if (sequenceNumber < nextSequenceNumber || (sequenceNumber < nextSequenceNumber + WINDOW_SIZE && IsSeen(sequenceNumber)))
+        {
+            stats.duplicates++;
+        }
+        else
+        {
+            stats.taken[index]++;
+            if (sequenceNumber >= nextSequenceNumber + WINDOW_SIZE)
+                Drain(sequenceNumber - WINDOW_SIZE + 1);
+
+            if (sequenceNumber == nextSequenceNumber)
+            {
+                decoder.Decode(data, length);
+                nextSequenceNumber++;
+            }
+            else
+            {
+                size_t slot = Slot(sequenceNumber);
+                memcpy(slots[slot].data(), data, length);
+                lengths[slot] = length;
+                SetSeen(sequenceNumber);
+            }
+        }
+
+        // Holes that both feeds have moved past are lost
+        Drain(std::min(highest[0], highest[1]));
+        return !decoder.Finished();
+    }
+
+    // Gives up on every hole and hands over all buffered messages, when the feeds go quiet
+    void Flush()
+    {
+        Drain(std::max(highest[0], highest[1]) + 1);
+    }
+
+    const FeedDecoder<Handler> & Decoder() const
+    {
+        return decoder;
+    }
+
+    const Stats & GetStats() const
+    {
+        return stats;
+    }
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <endian.h>
+
+#include "ItchMessage.hpp"
+
+// Decodes the market data feed, one ITCH message per datagram, for the feed handler and for
+// offline replay. Tracks sequence numbers to count dropped messages and passes each message,
+// still in wire byte order, to the handler policy.
+template<typename Handler>
+class FeedDecoder
+{
+private:
+    Handler & handler;
+    uint64_t nextSequenceNumber = 1;
+    uint64_t messagesDropped = 0;
+    bool finished = false;
+
+    template<typename Msg>
+    static const Msg* As(const char* data, size_t length)
+    {
+        return length >= sizeof(Msg) ? reinterpret_cast<const Msg*>(data) : nullptr;
+    }
+
+public:
+    explicit FeedDecoder(Handler & handler_) : handler(handler_) {}
+
+    // Returns false once the end of market hours message has been decoded
+    bool Decode(const char* data, size_t length)
+    {
+        auto header = As<ItchHeader>(data, length);
+        if (header == nullptr)
+            return !finished;
+
+        uint64_t sequenceNumber = be64toh(header->sequenceNumber);
+        if (sequenceNumber != nextSequenceNumber)
+        {
+            handler.OnSequenceGap(nextSequenceNumber, sequenceNumber);
+            messagesDropped += sequenceNumber - nextSequenceNumber;
+        }
+        nextSequenceNumber = sequenceNumber + 1;
+
+        switch (header->messageType)
+        {
+        case 'A':
+            if (auto msg = As<OrderAddMsg>(data, length))
+                handler.OnOrderAdd(*msg);
+            break;
+        case 'E':
+            if (auto msg = As<OrderExecMsg>(data, length))
+                handler.OnOrderExecuted(*msg);
+            break;
+        case 'D':
+            if (auto msg = As<OrderDeleteMsg>(data, length))
+                handler.OnOrderDeleted(*msg);
+            break;
+        case 'U':
+            if (auto msg = As<OrderReplaceMsg>(data, length))
+                handler.OnOrderReplaced(*msg);
+            break;
+        case 'H':
+            if (auto msg = As<TradingActionMsg>(data, length))
+                handler.OnTradingAction(*msg);
+            break;
+        case 'P':
+            if (auto msg = As<TradeMsg>(data, length))
+                handler.OnTrade(*msg);
+            break;
+        case 'M':
+            finished = true;
+            break;
+        default:
+            break;
+        }
+        return !finished;
+    }
+
+    // Messages received up to the last one decoded, the end of market hours message included
+    uint64_t MessagesProcessed() const
+    {
+        return nextSequenceNumber - 1 - messagesDropped;
+    }
+
+    uint64_t MessagesDropped() const
+    {
+        return messagesDropped;
+    }
+
+    bool Finished() const
+    {
+        return finished;
+    }
+};
+
+// Handler that counts messages by type, for replay and benchmarks
+struct FeedStats
+{
+    uint64_t orderAdds = 0;
+    uint64_t orderExecutions = 0;
+    uint64_t orderDeletes = 0;
+    uint64_t orderReplaces = 0;
+    uint64_t tradingActions = 0;
+    uint64_t trades = 0;
+    uint64_t gaps = 0;
+    uint64_t volume = 0;
+
+    void OnOrderAdd(const OrderAddMsg &) { orderAdds++; }
+    void OnOrderExecuted(const OrderExecMsg &) { orderExecutions++; }
+    void OnOrderDeleted(const OrderDeleteMsg &) { orderDeletes++; }
+    void OnOrderReplaced(const OrderReplaceMsg &) { orderReplaces++; }
+    void OnTradingAction(const TradingActionMsg &) { tradingActions++; }
+    void OnSequenceGap(uint64_t expected, uint64_t received) { gaps++; }
+
+    void OnTrade(const TradeMsg & msg)
+    {
+        trades++;
+        volume += be32toh(msg.quantity);
+    }
+};
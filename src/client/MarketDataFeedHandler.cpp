@@ -1,110 +1,101 @@
 #include <iostream>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <cstring>
 
+#include <poll.h>
 #include <sys/socket.h>
 #include <netinet/ip.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 
-#include "ItchMessage.hpp"
+#include "FeedAddress.hpp"
+#include "FeedArbitrator.hpp"
+#include "FeedDecoder.hpp"
 
 constexpr size_t MAX_PACKET_SIZE = 128;
 
-void HandleOrderAdd(OrderAddMsg* msg)
+// Prints every message of the feed
+struct PrintingFeedHandler
 {
-    uint64_t seqNumber = be64toh(msg->header.sequenceNumber);
-    uint64_t timestamp = be64toh(msg->header.timestamp);
-    uint64_t orderId = be64toh(msg->orderId);
-    char side = msg->side;
-    uint32_t quantity = be32toh(msg->quantity);
-    std::string symbol(msg->symbol);
-    uint32_t price = be32toh(msg->price);
-
-    std::cout << "Order added: ID=" << orderId << " Side=" << side << " Symbol=" << symbol << " Quantity=" << quantity << " Price=$" << price / 100.0 << "\n";
-}
+    void OnOrderAdd(const OrderAddMsg & msg)
+    {
+        uint64_t orderId = be64toh(msg.orderId);
+        char side = msg.side;
+        uint32_t quantity = be32toh(msg.quantity);
+        std::string symbol(msg.symbol, strnlen(msg.symbol, sizeof(msg.symbol)));
+        uint32_t price = be32toh(msg.price);
 
-void HandleOrderExecuted(OrderExecMsg* msg)
-{
-    uint64_t seqNumber = be64toh(msg->header.sequenceNumber);
-    uint64_t timestamp = be64toh(msg->header.timestamp);
-    uint64_t orderId = be64toh(msg->orderId);
-    uint32_t quantity = be32toh(msg->quantity);
-    uint64_t matchId = be64toh(msg->matchId);
+        std::cout << "Order added: ID=" << orderId << " Side=" << side << " Symbol=" << symbol << " Quantity=" << quantity << " Price=$" << price / 100.0 << "\n";
+    }
 
-    std::cout << "Order executed: ID=" << orderId << " Quantity=" << quantity << " MatchNumber=" << matchId << "\n";
-}
+    void OnOrderExecuted(const OrderExecMsg & msg)
+    {
+        uint64_t orderId = be64toh(msg.orderId);
+        uint32_t quantity = be32toh(msg.quantity);
+        uint64_t matchId = be64toh(msg.matchId);
 
-void HandleOrderDeleted(OrderDeleteMsg* msg)
-{
-    uint64_t seqNumber = be64toh(msg->header.sequenceNumber);
-    uint64_t timestamp = be64toh(msg->header.timestamp);
-    uint64_t orderId = be64toh(msg->orderId);
+        std::cout << "Order executed: ID=" << orderId << " Quantity=" << quantity << " MatchNumber=" << matchId << "\n";
+    }
 
-    std::cout << "Order deleted: ID=" << orderId << "\n";
-}
+    void OnOrderDeleted(const OrderDeleteMsg & msg)
+    {
+        uint64_t orderId = be64toh(msg.orderId);
 
-void HandleTradeMessage(TradeMsg* msg)
-{
-    uint64_t seqNumber = be64toh(msg->header.sequenceNumber);
-    uint64_t timestamp = be64toh(msg->header.timestamp);
-    char side = msg->side;
-    uint32_t quantity = be32toh(msg->quantity);
-    std::string symbol(msg->symbol);
-    uint32_t price = be32toh(msg->price);
-    uint64_t matchId = be64toh(msg->matchId);
-
-    std::cout << "Trade message: Side=" << side << " Symbol=" << symbol << " Quantity=" << quantity << " Price=$" << price / 100.0 << " MatchNumber=" << matchId << "\n";
-}
+        std::cout << "Order deleted: ID=" << orderId << "\n";
+    }
 
-void ProcessMessages(int sock)
-{
-    char buf[MAX_PACKET_SIZE];
-    uint64_t seqNumber = 1;
-    uint64_t messagesDropped = 0;
-    while (true)
+    void OnOrderReplaced(const OrderReplaceMsg & msg)
     {
-        int bytesRead = recvfrom(sock, buf, sizeof(buf), 0, nullptr, nullptr);
-        ItchHeader* header = reinterpret_cast<ItchHeader*>(buf);
+        uint64_t orderId = be64toh(msg.orderId);
+        uint32_t quantity = be32toh(msg.quantity);
+        uint32_t price = be32toh(msg.price);
 
-        uint64_t headerSeqNumber = be64toh(header->sequenceNumber);
-        if (headerSeqNumber != seqNumber)
-        {
-            std::cout << "Sequence number mismatch: got " << headerSeqNumber << ", expected " << seqNumber << "\n";
-            messagesDropped += headerSeqNumber - seqNumber;
-        }
+        std::cout << "Order replaced: ID=" << orderId << " Quantity=" << quantity << " Price=$" << price / 100.0 << "\n";
+    }
 
-        switch (header->messageType)
-        {
-        case 'A':
-            HandleOrderAdd(reinterpret_cast<OrderAddMsg*>(buf));
-            break;
-        case 'E':
-            HandleOrderExecuted(reinterpret_cast<OrderExecMsg*>(buf));
-            break;
-        case 'D':
-            HandleOrderDeleted(reinterpret_cast<OrderDeleteMsg*>(buf));
-            break;
-        case 'P':
-            HandleTradeMessage(reinterpret_cast<TradeMsg*>(buf));
-            break;
-        case 'M':
-            std::cout << "Messages processed: " << headerSeqNumber - messagesDropped << " Messages dropped: " << messagesDropped << "\n";
-            return;
-        default:
-            break;
-        }
+    void OnTradingAction(const TradingActionMsg & msg)
+    {
+        std::string symbol(msg.symbol, strnlen(msg.symbol, sizeof(msg.symbol)));
+
+        std::cout << "Trading action: Symbol=" << symbol << " State=" << (msg.tradingState == 'H' ? "HALTED" : "TRADING") << "\n";
+    }
 
-        seqNumber = headerSeqNumber + 1;
+    void OnTrade(const TradeMsg & msg)
+    {
+        char side = msg.side;
+        uint32_t quantity = be32toh(msg.quantity);
+        std::string symbol(msg.symbol, strnlen(msg.symbol, sizeof(msg.symbol)));
+        uint32_t price = be32toh(msg.price);
+        uint64_t matchId = be64toh(msg.matchId);
+
+        std::cout << "Trade message: Side=" << side << " Symbol=" << symbol << " Quantity=" << quantity << " Price=$" << price / 100.0 << " MatchNumber=" << matchId << "\n";
     }
+
+    void OnSequenceGap(uint64_t expected, uint64_t received)
+    {
+        std::cout << "Sequence number mismatch: got " << received << ", expected " << expected << "\n";
+    }
+};
+
+void PrintUsage(const char* program)
+{
+    std::cout << "Usage: " << program << " [options]\n"
+              << "Options:\n"
+              << "  --feed-a <g>:<p>  multicast group and port of the market data feed (default " << FeedAddress{}.ToString() << ")\n"
+              << "  --feed-b <g>:<p>  also join the redundant B feed and arbitrate between the two (e.g. " << FeedAddress::DefaultB().ToString() << ")\n";
 }
 
-int main(int argc, char **argv)
+// Socket bound to the feed's group and port, so that it receives no other group on the port,
+// and joined to the group on loopback
+int JoinFeed(const FeedAddress & address)
 {
     int sock = socket(AF_INET, SOCK_DGRAM, 0);
     if (sock < 0)
     {
         perror("socket");
-        return 1;
+        return -1;
     }
 
     int rcvbuf = 4 * 1024 * 1024;
@@ -113,24 +104,126 @@ int main(int argc, char **argv)
     int reuse = 1;
     setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
 
-    sockaddr_in server_addr{};
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(12345);
-    server_addr.sin_addr.s_addr = INADDR_ANY;
-
+    sockaddr_in server_addr = address.SocketAddress();
     if (bind(sock, (sockaddr*)&server_addr, sizeof(server_addr)) == -1)
     {
         perror("bind");
-        return 1;
+        close(sock);
+        return -1;
     }
 
     ip_mreq group = {};
-    group.imr_multiaddr.s_addr = inet_addr("239.0.0.1");
+    group.imr_multiaddr = server_addr.sin_addr;
     group.imr_interface.s_addr = inet_addr("127.0.0.1");
     setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, (void*)&group, sizeof(group));
+    return sock;
+}
 
-    ProcessMessages(sock);
+void ProcessMessages(int sock)
+{
+    char buf[MAX_PACKET_SIZE];
+    PrintingFeedHandler handler;
+    FeedDecoder decoder(handler);
+    while (true)
+    {
+        int bytesRead = recvfrom(sock, buf, sizeof(buf), 0, nullptr, nullptr);
+        if (bytesRead < 0)
+        {
+            perror("recvfrom");
+            return;
+        }
+        if (!decoder.Decode(buf, bytesRead))
+            break;
+    }
+    std::cout << "Messages processed: " << decoder.MessagesProcessed() << " Messages dropped: " << decoder.MessagesDropped() << "\n";
+}
+
+// Reads both feeds as they become readable and arbitrates between them. When both have been
+// quiet for FLUSH_TIMEOUT_MS, messages held back behind a hole are handed over.
+void ProcessMessages(int sockA, int sockB)
+{
+    constexpr int FLUSH_TIMEOUT_MS = 1000;
+
+    char buf[MAX_PACKET_SIZE];
+    PrintingFeedHandler handler;
+    FeedArbitrator arbitrator(handler);
+    pollfd fds[2] = { { sockA, POLLIN, 0 }, { sockB, POLLIN, 0 } };
+    bool running = true;
+    while (running)
+    {
+        int ready = poll(fds, 2, FLUSH_TIMEOUT_MS);
+        if (ready < 0)
+        {
+            perror("poll");
+            return;
+        }
+        if (ready == 0)
+        {
+            arbitrator.Flush();
+            running = !arbitrator.Decoder().Finished();
+            continue;
+        }
+
+        for (int i = 0; i < 2 && running; i++)
+        {
+            if (!(fds[i].revents & POLLIN))
+                continue;
+            int bytesRead;
+            while (running && (bytesRead = recv(fds[i].fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+                running = arbitrator.OnPacket(i == 0 ? Feed::A : Feed::B, buf, bytesRead);
+        }
+    }
+
+    const auto & decoder = arbitrator.Decoder();
+    const auto & stats = arbitrator.GetStats();
+    std::cout << "Messages processed: " << decoder.MessagesProcessed() << " Messages dropped: " << decoder.MessagesDropped() << "\n";
+    std::cout << "Feed A: received " << stats.received[0] << ", first " << stats.taken[0]
+              << " Feed B: received " << stats.received[1] << ", first " << stats.taken[1]
+              << " Duplicates: " << stats.duplicates << "\n";
+}
+
+int main(int argc, char **argv)
+{
+    FeedAddress feedA;
+    std::optional<FeedAddress> feedB;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg = argv[i];
+        if ((arg != "--feed-a" && arg != "--feed-b") || i + 1 >= argc)
+        {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+
+        auto parsed = FeedAddress::Parse(argv[++i]);
+        if (!parsed)
+        {
+            std::cout << arg << " expects <multicast group>:<port>\n";
+            return 1;
+        }
+        (arg == "--feed-a" ? feedA : feedB.emplace()) = *parsed;
+    }
+
+    int sockA = JoinFeed(feedA);
+    if (sockA < 0)
+        return 1;
+
+    if (!feedB)
+    {
+        ProcessMessages(sockA);
+        close(sockA);
+        return 0;
+    }
+
+    int sockB = JoinFeed(*feedB);
+    if (sockB < 0)
+    {
+        close(sockA);
+        return 1;
+    }
+    ProcessMessages(sockA, sockB);
 
-    close(sock);
+    close(sockA);
+    close(sockB);
     return 0;
 }
@@ -0,0 +1,156 @@
+#pragma once
+#include "OrderBook.hpp"
+#include "InstrumentTraits.hpp"
+
+#include <memory>
+#include <tuple>
+#include <variant>
+
+// Order storage shared by all books of an engine: one order store per quantity width and one
+// stop store, each created with the first book that needs it
+class OrderStores
+{
+private:
+    size_t numMaxOrders;
+    std::tuple<std::unique_ptr<OrderStore<uint32_t>>, std::unique_ptr<OrderStore<uint16_t>>> orderStores;
+    std::unique_ptr<StopStore> stopStore;
+
+public:
+    explicit OrderStores(size_t numMaxOrders_) : numMaxOrders(numMaxOrders_) {}
+
+    template<typename Quantity>
+    OrderStore<Quantity> & Orders()
+    {
+        auto & store = std::get<std::unique_ptr<OrderStore<Quantity>>>(orderStores);
+        if (!store)
+            store = std::make_unique<OrderStore<Quantity>>(numMaxOrders);
+        return *store;
+    }
+
+    StopStore & Stops()
+    {
+        if (!stopStore)
+            stopStore = std::make_unique<StopStore>(numMaxOrders);
+        return *stopStore;
+    }
+
+    void Prefault(const WarmupOptions & options)
+    {
+        std::apply([&](auto & ... store) { ((store ? store->Prefault(options) : void()), ...); }, orderStores);
+        if (stopStore)
+            stopStore->Prefault(options);
+    }
+};
+
+// A book of one of the precompiled instrument classes, picked when the symbol is set up. Every
+// call is a visit over a closed set of three, a jump on the variant index that is the same for
+// every request of a symbol, and the book it lands in runs with its class's constants inlined.
+class AnyOrderBook
+{
+private:
+    using Books = std::variant<OrderBook<EquityTraits>, OrderBook<FutureTraits>, OrderBook<PennyStockTraits>>;
+
+    Books book;
+
+    template<typename Traits>
+    static Books MakeBook(SymbolId symbolId, std::string_view symbol, OrderStores & stores, RiskManager* risk)
+    {
+        return Books(std::in_place_type<OrderBook<Traits>>, symbolId, symbol, stores.Orders<typename Traits::Quantity>(), stores.Stops(), risk);
+    }
+
+    static Books MakeBook(InstrumentClass instrumentClass, SymbolId symbolId, std::string_view symbol, OrderStores & stores, RiskManager* risk)
+    {
+        switch (instrumentClass)
+        {
+        case InstrumentClass::EQUITY:
+            return MakeBook<EquityTraits>(symbolId, symbol, stores, risk);
+        case InstrumentClass::FUTURE:
+            return MakeBook<FutureTraits>(symbolId, symbol, stores, risk);
+        case InstrumentClass::PENNY_STOCK:
+            return MakeBook<PennyStockTraits>(symbolId, symbol, stores, risk);
+        }
+        throw std::runtime_error{ "Unknown instrument class" };
+    }
+
+    template<typename F>
+    decltype(auto) Visit(F && f)
+    {
+        return std::visit(std::forward<F>(f), book);
+    }
+
+    template<typename F>
+    decltype(auto) Visit(F && f) const
+    {
+        return std::visit(std::forward<F>(f), book);
+    }
+
+public:
+    AnyOrderBook(InstrumentClass instrumentClass, SymbolId symbolId, std::string_view symbol, OrderStores & stores, RiskManager* risk = nullptr)
+        : book(MakeBook(instrumentClass, symbolId, symbol, stores, risk)) {}
+
+    InstrumentClass Class() const
+    {
+        return static_cast<InstrumentClass>(book.index());
+    }
+
+    size_t NumPriceLevels() const
+    {
+        return Visit([](const auto & b) { return b.NumPriceLevels(); });
+    }
+
+    RejectionType CheckLimits(uint32_t quantity, uint32_t price, uint32_t stopPrice = 0) const
+    {
+        return Visit([&](const auto & b) { return b.CheckLimits(quantity, price, stopPrice); });
+    }
+
+    void Prefault(const WarmupOptions & options) { Visit([&](auto & b) { b.Prefault(options); }); }
+    size_t HugePageSize() const { return Visit([](const auto & b) { return b.HugePageSize(); }); }
+    void Reset() { Visit([](auto & b) { b.Reset(); }); }
+
+    void OpenAuction() { Visit([](auto & b) { b.OpenAuction(); }); }
+    bool InAuction() const { return Visit([](const auto & b) { return b.InAuction(); }); }
+
+    template<typename OutputPolicy>
+    AuctionResult Uncross(uint64_t requestId, OutputPolicy & output)
+    {
+        return Visit([&](auto & b) { return b.Uncross(requestId, output); });
+    }
+
+    void SetPriceBand(uint32_t widthTicks, uint32_t referencePrice = 0) { Visit([&](auto & b) { b.SetPriceBand(widthTicks, referencePrice); }); }
+    bool IsHalted() const { return Visit([](const auto & b) { return b.IsHalted(); }); }
+    uint32_t ReferencePrice() const { return Visit([](const auto & b) { return b.ReferencePrice(); }); }
+    void Resume(uint32_t newReferencePrice = 0) { Visit([&](auto & b) { b.Resume(newReferencePrice); }); }
+
+    void PrefetchLevels(const Order & order) { Visit([&](auto & b) { b.PrefetchLevels(order); }); }
+    void PrefetchTopOrder(const Order & order) { Visit([&](auto & b) { b.PrefetchTopOrder(order); }); }
+    void PrefetchLookup(uint64_t targetOrderId) { Visit([&](auto & b) { b.PrefetchLookup(targetOrderId); }); }
+    void PrefetchOrder(uint64_t targetOrderId) { Visit([&](auto & b) { b.PrefetchOrder(targetOrderId); }); }
+    void PrefetchNeighbours(uint64_t targetOrderId) { Visit([&](auto & b) { b.PrefetchNeighbours(targetOrderId); }); }
+
+    template<typename OutputPolicy>
+    void CancelOrder(uint64_t targetOrderId, uint64_t requestId, OutputPolicy & output)
+    {
+        Visit([&](auto & b) { b.CancelOrder(targetOrderId, requestId, output); });
+    }
+
+    template<typename OutputPolicy>
+    size_t MassCancel(uint16_t sessionId, std::optional<Side> side, uint64_t requestId, OutputPolicy & output)
+    {
+        return Visit([&](auto & b) { return b.MassCancel(sessionId, side, requestId, output); });
+    }
+
+    template<typename OutputPolicy>
+    void ModifyOrder(uint64_t targetOrderId, uint64_t requestId, uint32_t newQuantity, uint32_t newPrice, OutputPolicy & output)
+    {
+        Visit([&](auto & b) { b.ModifyOrder(targetOrderId, requestId, newQuantity, newPrice, output); });
+    }
+
+    template<typename OutputPolicy>
+    void MatchOrder(Order* order, OutputPolicy & output)
+    {
+        Visit([&](auto & b) { b.MatchOrder(order, output); });
+    }
+
+    std::pair<uint32_t, uint32_t> GetTopOfBook() { return Visit([](auto & b) { return b.GetTopOfBook(); }); }
+    void PrintBook(int levels = 5) { Visit([&](auto & b) { b.PrintBook(levels); }); }
+};
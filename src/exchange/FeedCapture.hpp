@@ -0,0 +1,166 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <arpa/inet.h>
+
+#include "FeedAddress.hpp"
+#include "ItchEncoder.hpp"
+#include "PcapFile.hpp"
+#include "SPSCQueue.hpp"
+#include "Threading.hpp"
+#include "Timer.hpp"
+#include "WaitStrategy.hpp"
+
+// Records the market data a transmitter sends to a pcap file. The transmitter hands over each
+// encoded batch with one TSC read; messages are copied into a ring and a background thread
+// stamps them with wall-clock time and writes them out through a buffered PcapWriter, so the
+// publisher never waits on the file. When the ring is full the publisher yields until the
+// writer catches up rather than losing messages. A failed write ends the capture, not the
+// session.
+class FeedCapture
+{
+private:
+    struct CapturedMessage
+    {
+        uint64_t tsc;
+        uint16_t length;
+        char data[ItchEncoder::MAX_MESSAGE_SIZE];
+    };
+
+    static constexpr size_t RING_SIZE = 1 << 16;
+
+    // Polls the ring and backs off to sleeps of up to 1 ms, so the publisher never has to wake
+    // the writer with a syscall
+    using IdleWait = BackoffWaitT<64, 1'000, 1'000'000>;
+
+    std::string path;
+    PcapWriter writer;
+    SPSCQueue<CapturedMessage> ring{ RING_SIZE };
+    std::thread thread;
+    std::atomic<bool> running{ true };
+    int cpuId;
+    bool failed = false;
+    uint64_t messagesCaptured = 0;
+
+    // Wall-clock time of TSC `startTsc`, the base of the timestamps written
+    uint64_t startNs;
+    uint64_t startTsc;
+
+    void Run()
+    {
+        PinThread(cpuId);
+        IdleWait wait;
+        while (true)
+        {
+            auto batch = ring.ReadSpan(RING_SIZE);
+            if (batch.empty())
+            {
+                if (!running.load(std::memory_order_acquire) && ring.IsEmpty())
+                    break;
+                wait.Idle(ring);
+                continue;
+            }
+            wait.Reset();
+
+            // After a failed write the ring is still drained, so the publisher never waits on it
+            if (!failed)
+                WriteBatch(batch);
+            ring.UpdateReadIndex(batch.size());
+        }
+        if (!failed)
+            Flush();
+    }
+
+    void WriteBatch(std::span<CapturedMessage> batch)
+    {
+        try
+        {
+            for (const auto & message : batch)
+                writer.Write(startNs + Timer::cycles_to_ns(message.tsc - startTsc), message.data, message.length);
+            messagesCaptured += batch.size();
+        }
+        catch (const std::runtime_error & e)
+        {
+            Fail(e);
+        }
+    }
+
+    void Flush()
+    {
+        try
+        {
+            writer.Flush();
+        }
+        catch (const std::runtime_error & e)
+        {
+            Fail(e);
+        }
+    }
+
+    void Fail(const std::runtime_error & e)
+    {
+        std::cerr << "Feed capture stopped: " << e.what() << "\n";
+        failed = true;
+    }
+
+public:
+    // The writer thread runs on `cpuId`, or wherever the constructing thread may run when -1
+    explicit FeedCapture(const std::string & path_, const FeedAddress & address = {}, int cpuId_ = -1)
+        : path(path_), writer(path, inet_addr("127.0.0.1"), inet_addr(address.group.c_str()), address.port), cpuId(cpuId_)
+    {
+        startTsc = Timer::rdtsc();
+        startNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        thread = std::thread(&FeedCapture::Run, this);
+    }
+
+    FeedCapture(const FeedCapture&) = delete;
+    FeedCapture& operator=(const FeedCapture&) = delete;
+
+    ~FeedCapture()
+    {
+        running.store(false, std::memory_order_release);
+        thread.join();
+        std::cout << "Captured " << messagesCaptured << " messages to " << path;
+        if (failed)
+            std::cout << " before the capture failed";
+        std::cout << "\n";
+    }
+
+    // `count` messages laid out back to back in `data`, their sizes in `lengths`
+    void Write(const char* data, const uint16_t* lengths, size_t count)
+    {
+        uint64_t tsc = Timer::rdtsc();
+        for (size_t written = 0; written < count;)
+        {
+            size_t filled = 0;
+            CapturedMessage* message;
+            while (written + filled < count && (message = ring.GetWriteIndex(filled)) != nullptr)
+            {
+                uint16_t length = lengths[written + filled];
+                message->tsc = tsc;
+                message->length = length;
+                memcpy(message->data, data, length);
+                data += length;
+                filled++;
+            }
+
+            if (filled == 0)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            ring.UpdateWriteIndex(filled);
+            written += filled;
+        }
+    }
+};
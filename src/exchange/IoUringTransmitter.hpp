@@ -0,0 +1,387 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "FeedCapture.hpp"
+#include "ItchEncoder.hpp"
+#include "ItchMessage.hpp"
+#include "Timer.hpp"
+#include "UDPTransmitter.hpp"
+
+struct IoUringOptions
+{
+    // Let a kernel thread poll the submission ring, when permitted
+    bool sqPoll = true;
+    // CPU of the polling thread, -1 leaves it unpinned
+    int sqPollCpu = -1;
+    // Send with IORING_OP_SEND_ZC straight from the registered buffers instead of copying
+    bool zeroCopy = false;
+};
+
+// Market data transmitter that hands its sends to an io_uring instead of calling sendto. Batches
+// are encoded into buffers registered with the ring, the socket is a registered file, and each
+// message is one send SQE (one datagram). With SQPOLL a kernel thread picks up new SQEs, so
+// in steady state neither submitting nor reaping completions is a syscall; io_uring_enter is
+// only called to wake the thread once it has gone idle. Without SQPOLL every batch is submitted
+// with one io_uring_enter, like one sendmmsg.
+//
+// Registered buffers only save work for zero-copy sends, which pin the pages they send from.
+// Market data messages are 30 to 44 bytes, and on loopback zero-copy falls back to a copy and
+// adds a notification per send, so plain sends that copy are the default.
+class IoUringTransmitter
+{
+private:
+    static constexpr uint32_t QUEUE_DEPTH = 1024;
+    static constexpr size_t MAX_BATCH_EVENTS = 64;
+    static constexpr size_t NUM_BUFFERS = 8;
+    static constexpr size_t BUFFER_SIZE = ItchEncoder::BufferSize(MAX_BATCH_EVENTS);
+    static constexpr size_t MAX_BATCH_MESSAGES = MAX_BATCH_EVENTS * ItchEncoder::MAX_MESSAGES_PER_EVENT;
+    static constexpr unsigned SQ_THREAD_IDLE_MS = 1000;
+    static constexpr int SOCKET_INDEX = 0;
+
+    static_assert(MAX_BATCH_MESSAGES <= QUEUE_DEPTH);
+
+    int sock;
+    sockaddr_in groupSock;
+    uint64_t nextSequenceNumber = 1;
+    FeedCapture* capture = nullptr;
+    IoUringTransmitter* mirror = nullptr;
+
+    int ringFd = -1;
+    bool sqPoll = false;
+    bool zeroCopy;
+    io_uring_params params{};
+
+    void* sqRing = MAP_FAILED;
+    size_t sqRingSize = 0;
+    void* cqRing = MAP_FAILED;
+    size_t cqRingSize = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqesSize = 0;
+
+    uint32_t* sqHead;
+    uint32_t* sqTail;
+    uint32_t* sqFlags;
+    uint32_t sqMask;
+    uint32_t* sqArray;
+    uint32_t* cqHead;
+    uint32_t* cqTail;
+    uint32_t cqMask;
+    io_uring_cqe* cqes;
+
+    // Encode buffers, registered with the ring. A buffer is reused once all its sends completed.
+    std::vector<char> buffers = std::vector<char>(NUM_BUFFERS * BUFFER_SIZE);
+    std::vector<uint16_t> lengths = std::vector<uint16_t>(MAX_BATCH_MESSAGES);
+    uint32_t pendingSends[NUM_BUFFERS] = {};
+    size_t nextBuffer = 0;
+    uint32_t inFlight = 0;
+    uint64_t failedSends = 0;
+
+    static int Setup(uint32_t entries, io_uring_params & p)
+    {
+        return syscall(__NR_io_uring_setup, entries, &p);
+    }
+
+    int Enter(uint32_t toSubmit, uint32_t minComplete, uint32_t flags)
+    {
+        return syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, nullptr, 0);
+    }
+
+    int Register(unsigned opcode, const void* arg, unsigned numArgs)
+    {
+        return syscall(__NR_io_uring_register, ringFd, opcode, arg, numArgs);
+    }
+
+    template<typename T>
+    T* RingField(void* ring, uint32_t offset)
+    {
+        return reinterpret_cast<T*>(static_cast<char*>(ring) + offset);
+    }
+
+    void MapRings()
+    {
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+            sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED)
+            throw std::runtime_error{ "Failed to map io_uring submission ring" };
+        cqRing = (params.features & IORING_FEAT_SINGLE_MMAP) ? sqRing
+            : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED)
+            throw std::runtime_error{ "Failed to map io_uring completion ring" };
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES));
+        if (sqes == MAP_FAILED)
+            throw std::runtime_error{ "Failed to map io_uring submission entries" };
+
+        sqHead = RingField<uint32_t>(sqRing, params.sq_off.head);
+        sqTail = RingField<uint32_t>(sqRing, params.sq_off.tail);
+        sqFlags = RingField<uint32_t>(sqRing, params.sq_off.flags);
+        sqMask = *RingField<uint32_t>(sqRing, params.sq_off.ring_mask);
+        sqArray = RingField<uint32_t>(sqRing, params.sq_off.array);
+        cqHead = RingField<uint32_t>(cqRing, params.cq_off.head);
+        cqTail = RingField<uint32_t>(cqRing, params.cq_off.tail);
+        cqMask = *RingField<uint32_t>(cqRing, params.cq_off.ring_mask);
+        cqes = RingField<io_uring_cqe>(cqRing, params.cq_off.cqes);
+
+        // SQE i always sits at index i of the array
+        for (uint32_t i = 0; i < params.sq_entries; i++)
+            sqArray[i] = i;
+    }
+
+    void Unmap()
+    {
+        if (sqes != MAP_FAILED)
+            munmap(sqes, sqesSize);
+        if (cqRing != MAP_FAILED && cqRing != sqRing)
+            munmap(cqRing, cqRingSize);
+        if (sqRing != MAP_FAILED)
+            munmap(sqRing, sqRingSize);
+        if (ringFd != -1)
+            close(ringFd);
+    }
+
+    void Reap()
+    {
+        uint32_t head = *cqHead;
+        uint32_t tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++)
+        {
+            const io_uring_cqe & cqe = cqes[head & cqMask];
+            // A plain send completes once. A zero-copy send completes twice: with its result and
+            // F_MORE set, then with a notification once its buffer is no longer used.
+            if (!(cqe.flags & IORING_CQE_F_NOTIF) && cqe.res < 0 && failedSends++ == 0)
+                std::cerr << "io_uring send: " << strerror(-cqe.res) << "\n";
+            if (!zeroCopy || !(cqe.flags & IORING_CQE_F_MORE))
+            {
+                pendingSends[cqe.user_data]--;
+                inFlight--;
+            }
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    }
+
+    // Reaps completions until `done` holds, sleeping in io_uring_enter while it does not. Only
+    // happens when the ring or every encode buffer is still busy with earlier batches.
+    template<typename Condition>
+    void WaitFor(Condition done)
+    {
+        Reap();
+        while (!done())
+        {
+            uint32_t flags = IORING_ENTER_GETEVENTS;
+            if (sqPoll && (__atomic_load_n(sqFlags, __ATOMIC_RELAXED) & IORING_SQ_NEED_WAKEUP))
+                flags |= IORING_ENTER_SQ_WAKEUP;
+            Enter(0, 1, flags);
+            Reap();
+        }
+    }
+
+    void Submit(size_t buffer, const char* data, const uint16_t* sizes, size_t count)
+    {
+        uint32_t tail = *sqTail;
+        for (size_t i = 0; i < count; i++)
+        {
+            io_uring_sqe & sqe = sqes[tail++ & sqMask];
+            memset(&sqe, 0, sizeof(sqe));
+            sqe.flags = IOSQE_FIXED_FILE;
+            sqe.fd = SOCKET_INDEX;
+            sqe.addr = reinterpret_cast<uint64_t>(data);
+            sqe.len = sizes[i];
+            sqe.user_data = buffer;
+            if (zeroCopy)
+            {
+                sqe.opcode = IORING_OP_SEND_ZC;
+                sqe.ioprio = IORING_RECVSEND_FIXED_BUF;
+                sqe.buf_index = buffer;
+            }
+            else
+            {
+                sqe.opcode = IORING_OP_SEND;
+            }
+            data += sizes[i];
+        }
+        pendingSends[buffer] += count;
+        inFlight += count;
+        __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+
+        if (!sqPoll)
+        {
+            Enter(count, 0, 0);
+            return;
+        }
+        // The tail store must be visible before the poll thread's idle flag is read
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(sqFlags, __ATOMIC_RELAXED) & IORING_SQ_NEED_WAKEUP)
+            Enter(0, 0, IORING_ENTER_SQ_WAKEUP);
+    }
+
+    // Next free encode buffer, waiting for the sends of its previous batch if needed
+    size_t AcquireBuffer(size_t numMessages)
+    {
+        size_t buffer = nextBuffer;
+        nextBuffer = (nextBuffer + 1) % NUM_BUFFERS;
+        WaitFor([&] { return pendingSends[buffer] == 0 && inFlight + numMessages <= params.sq_entries; });
+        return buffer;
+    }
+
+public:
+    explicit IoUringTransmitter(const FeedAddress & address = {}, const IoUringOptions & options = {})
+        : sock(OpenMulticastSocket(address, groupSock)), zeroCopy(options.zeroCopy)
+    {
+        // Sends carry no destination address
+        if (connect(sock, reinterpret_cast<sockaddr*>(&groupSock), sizeof(groupSock)) == -1)
+        {
+            perror("connect");
+            close(sock);
+            throw std::runtime_error{ "Failed to connect socket to the multicast group" };
+        }
+
+        if (options.sqPoll)
+        {
+            params.flags = IORING_SETUP_SQPOLL | (options.sqPollCpu >= 0 ? IORING_SETUP_SQ_AFF : 0);
+            params.sq_thread_cpu = std::max(options.sqPollCpu, 0);
+            params.sq_thread_idle = SQ_THREAD_IDLE_MS;
+            ringFd = Setup(QUEUE_DEPTH, params);
+            sqPoll = ringFd >= 0;
+        }
+        if (ringFd < 0)
+        {
+            params = {};
+            ringFd = Setup(QUEUE_DEPTH, params);
+        }
+        if (ringFd < 0)
+        {
+            perror("io_uring_setup");
+            close(sock);
+            throw std::runtime_error{ "Failed to set up io_uring" };
+        }
+
+        try
+        {
+            MapRings();
+
+            if (Register(IORING_REGISTER_FILES, &sock, 1) < 0)
+                throw std::runtime_error{ "Failed to register socket with io_uring" };
+
+            std::vector<iovec> iovecs(NUM_BUFFERS);
+            for (size_t i = 0; i < NUM_BUFFERS; i++)
+                iovecs[i] = { buffers.data() + i * BUFFER_SIZE, BUFFER_SIZE };
+            if (Register(IORING_REGISTER_BUFFERS, iovecs.data(), iovecs.size()) < 0)
+                throw std::runtime_error{ "Failed to register buffers with io_uring" };
+        }
+        catch (...)
+        {
+            Unmap();
+            close(sock);
+            throw;
+        }
+    }
+
+    IoUringTransmitter(const IoUringTransmitter&) = delete;
+    IoUringTransmitter& operator=(const IoUringTransmitter&) = delete;
+
+    ~IoUringTransmitter()
+    {
+        WaitFor([&] { return inFlight == 0; });
+        std::cout << "io_uring Transmitter sent " << nextSequenceNumber - 1 << " messages";
+        if (failedSends != 0)
+            std::cout << ", " << failedSends << " failed";
+        std::cout << "\n";
+        Unmap();
+        close(sock);
+    }
+
+    // Also records everything sent to `capture`, nullptr to stop
+    void SetCapture(FeedCapture* capture_)
+    {
+        capture = capture_;
+    }
+
+    // Also sends every message as encoded for this feed on `mirror`, the redundant B feed, so
+    // both feeds carry the same sequence numbers. nullptr to stop.
+    void SetMirror(IoUringTransmitter* mirror_)
+    {
+        mirror = mirror_;
+    }
+
+    bool UsesSqPoll() const
+    {
+        return sqPoll;
+    }
+
+    // Encodes each MAX_BATCH_EVENTS events into a registered buffer and queues one send per
+    // message. Returns without waiting for the sends.
+    void SendBatch(std::span<const MarketDataEvent> events, const ItchEncoder & encoder)
+    {
+        for (size_t start = 0; start < events.size(); start += MAX_BATCH_EVENTS)
+        {
+            auto chunk = events.subspan(start, std::min(MAX_BATCH_EVENTS, events.size() - start));
+            size_t buffer = AcquireBuffer(MAX_BATCH_MESSAGES);
+            char* data = buffers.data() + buffer * BUFFER_SIZE;
+            size_t count = encoder.Encode(chunk, nextSequenceNumber, data, lengths.data());
+            if (capture)
+                capture->Write(data, lengths.data(), count);
+            if (count != 0)
+                Submit(buffer, data, lengths.data(), count);
+            if (mirror)
+                mirror->SendEncoded(data, lengths.data(), count);
+        }
+    }
+
+    // Queues `count` messages encoded elsewhere, laid out back to back in `data`. They are
+    // copied into a registered buffer, as the sends complete after this returns.
+    void SendEncoded(const char* data, const uint16_t* sizes, size_t count)
+    {
+        nextSequenceNumber += count;
+        if (capture)
+            capture->Write(data, sizes, count);
+        for (size_t start = 0; start < count;)
+        {
+            size_t buffer = AcquireBuffer(MAX_BATCH_MESSAGES);
+            size_t chunk = 0, bytes = 0;
+            while (start + chunk < count && chunk < MAX_BATCH_MESSAGES && bytes + sizes[start + chunk] <= BUFFER_SIZE)
+                bytes += sizes[start + chunk++];
+
+            char* copy = buffers.data() + buffer * BUFFER_SIZE;
+            memcpy(copy, data, bytes);
+            Submit(buffer, copy, sizes + start, chunk);
+            data += bytes;
+            start += chunk;
+        }
+    }
+
+    void SendEndMarketHours()
+    {
+        size_t buffer = AcquireBuffer(1);
+        char* data = buffers.data() + buffer * BUFFER_SIZE;
+
+        EndMarketMsg msg;
+        msg.header.sequenceNumber = htobe64(nextSequenceNumber++);
+        msg.header.messageType = 'M';
+        msg.header.timestamp = htobe64(Timer::rdtsc());
+        memcpy(data, &msg, sizeof(msg));
+
+        uint16_t size = sizeof(msg);
+        if (capture)
+            capture->Write(data, &size, 1);
+        Submit(buffer, data, &size, 1);
+        if (mirror)
+            mirror->SendEncoded(data, &size, 1);
+        WaitFor([&] { return inFlight == 0; });
+    }
+};
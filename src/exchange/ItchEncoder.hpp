@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+#include <endian.h>
+#include <immintrin.h>
+
+#include "ItchMessage.hpp"
+#include "MarketDataEvent.hpp"
+#include "SymbolDirectory.hpp"
+
+// Encodes a batch of market data events into ITCH messages laid out back to back in one buffer,
+// with the length of each message alongside so a transmitter can send them as one datagram each.
+// Symbols are kept as their 8 wire bytes per symbol id. The big-endian fields of an event
+// (timestamp, trade id, resting order id, price and quantity) sit next to each other in
+// MarketDataEvent and are swapped with one AVX2 shuffle per event.
+class ItchEncoder
+{
+public:
+    // Messages an event can produce at most (a fill: two executions and a trade) and their size
+    static constexpr size_t MAX_MESSAGES_PER_EVENT = 3;
+    static constexpr size_t MAX_MESSAGE_SIZE = sizeof(TradeMsg);
+
+    static constexpr size_t BufferSize(size_t numEvents)
+    {
+        return numEvents * MAX_MESSAGES_PER_EVENT * MAX_MESSAGE_SIZE;
+    }
+
+private:
+    std::vector<uint64_t> symbolBytes;
+
+    // Same layout as MarketDataEvent from timestamp to quantity, each field big-endian
+    struct SwappedFields
+    {
+        uint64_t timestamp;
+        uint64_t tradeId;
+        uint64_t restingOrderId;
+        uint32_t price;
+        uint32_t quantity;
+    };
+
+    static_assert(offsetof(MarketDataEvent, tradeId) == offsetof(MarketDataEvent, timestamp) + offsetof(SwappedFields, tradeId));
+    static_assert(offsetof(MarketDataEvent, restingOrderId) == offsetof(MarketDataEvent, timestamp) + offsetof(SwappedFields, restingOrderId));
+    static_assert(offsetof(MarketDataEvent, price) == offsetof(MarketDataEvent, timestamp) + offsetof(SwappedFields, price));
+    static_assert(offsetof(MarketDataEvent, quantity) == offsetof(MarketDataEvent, timestamp) + offsetof(SwappedFields, quantity));
+    static_assert(sizeof(SwappedFields) == 32);
+
+    static SwappedFields SwapFields(const MarketDataEvent & event)
+    {
+        SwappedFields swapped;
+#ifdef __AVX2__
+        // Reverses the bytes of three 64-bit fields and two 32-bit fields in one shuffle
+        const __m256i mask = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                              7, 6, 5, 4, 3, 2, 1, 0, 11, 10, 9, 8, 15, 14, 13, 12);
+        __m256i fields = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&event.timestamp));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&swapped), _mm256_shuffle_epi8(fields, mask));
+#else
+        swapped = { htobe64(event.timestamp), htobe64(event.tradeId), htobe64(event.restingOrderId), htobe32(event.price), htobe32(event.quantity) };
+#endif
+        return swapped;
+    }
+
+    template<typename T>
+    static void Store(char* out, size_t offset, T value)
+    {
+        memcpy(out + offset, &value, sizeof(T));
+    }
+
+    static void WriteHeader(char* out, uint64_t & sequenceNumber, char type, uint64_t timestamp)
+    {
+        Store(out, offsetof(ItchHeader, sequenceNumber), htobe64(sequenceNumber++));
+        Store(out, offsetof(ItchHeader, messageType), type);
+        Store(out, offsetof(ItchHeader, timestamp), timestamp);
+    }
+
+public:
+    explicit ItchEncoder(const SymbolDirectory & symbols) : symbolBytes(symbols.Size())
+    {
+        for (size_t i = 0; i < symbols.Size(); i++)
+        {
+            auto name = symbols.Name(i);
+            memcpy(&symbolBytes[i], name.data(), std::min(name.size(), sizeof(uint64_t)));
+        }
+    }
+
+    // Writes the messages of `events` to `out` (at least BufferSize(events.size()) bytes) and
+    // their sizes to `lengths` (room for MAX_MESSAGES_PER_EVENT per event). Returns the number
+    // of messages.
+    size_t Encode(std::span<const MarketDataEvent> events, uint64_t & sequenceNumber, char* out, uint16_t* lengths) const
+    {
+        size_t count = 0;
+        auto emit = [&](size_t size) {
+            out += size;
+            lengths[count++] = size;
+        };
+
+        for (const auto & event : events)
+        {
+            SwappedFields be = SwapFields(event);
+            uint8_t side = event.side == Side::BUY ? 'B' : 'S';
+
+            switch (event.type)
+            {
+            case EventType::ORDER_ACKED:
+                WriteHeader(out, sequenceNumber, 'A', be.timestamp);
+                Store(out, offsetof(OrderAddMsg, orderId), htobe64(event.orderId));
+                Store(out, offsetof(OrderAddMsg, side), side);
+                Store(out, offsetof(OrderAddMsg, quantity), be.quantity);
+                Store(out, offsetof(OrderAddMsg, symbol), symbolBytes[event.symbolId]);
+                Store(out, offsetof(OrderAddMsg, price), be.price);
+                emit(sizeof(OrderAddMsg));
+                break;
+            case EventType::ORDER_FILLED:
+                WriteHeader(out, sequenceNumber, 'E', be.timestamp);
+                Store(out, offsetof(OrderExecMsg, orderId), htobe64(event.orderId));
+                Store(out, offsetof(OrderExecMsg, quantity), be.quantity);
+                Store(out, offsetof(OrderExecMsg, matchId), be.tradeId);
+                emit(sizeof(OrderExecMsg));
+
+                WriteHeader(out, sequenceNumber, 'E', be.timestamp);
+                Store(out, offsetof(OrderExecMsg, orderId), be.restingOrderId);
+                Store(out, offsetof(OrderExecMsg, quantity), be.quantity);
+                Store(out, offsetof(OrderExecMsg, matchId), be.tradeId);
+                emit(sizeof(OrderExecMsg));
+
+                WriteHeader(out, sequenceNumber, 'P', be.timestamp);
+                Store(out, offsetof(TradeMsg, side), side);
+                Store(out, offsetof(TradeMsg, quantity), be.quantity);
+                Store(out, offsetof(TradeMsg, symbol), symbolBytes[event.symbolId]);
+                Store(out, offsetof(TradeMsg, price), be.price);
+                Store(out, offsetof(TradeMsg, matchId), be.tradeId);
+                emit(sizeof(TradeMsg));
+                break;
+            case EventType::ORDER_CANCELLED:
+                WriteHeader(out, sequenceNumber, 'D', be.timestamp);
+                Store(out, offsetof(OrderDeleteMsg, orderId), htobe64(event.orderId));
+                emit(sizeof(OrderDeleteMsg));
+                break;
+            case EventType::ORDER_REPLACED:
+            case EventType::ORDER_REPLENISHED:
+                WriteHeader(out, sequenceNumber, 'U', be.timestamp);
+                Store(out, offsetof(OrderReplaceMsg, orderId), htobe64(event.orderId));
+                Store(out, offsetof(OrderReplaceMsg, quantity), be.quantity);
+                Store(out, offsetof(OrderReplaceMsg, price), be.price);
+                emit(sizeof(OrderReplaceMsg));
+                break;
+            case EventType::TRADING_HALTED:
+            case EventType::TRADING_RESUMED:
+                WriteHeader(out, sequenceNumber, 'H', be.timestamp);
+                Store(out, offsetof(TradingActionMsg, symbol), symbolBytes[event.symbolId]);
+                Store(out, offsetof(TradingActionMsg, tradingState), event.type == EventType::TRADING_HALTED ? 'H' : 'T');
+                emit(sizeof(TradingActionMsg));
+                break;
+            default:
+                break;
+            }
+        }
+        return count;
+    }
+};
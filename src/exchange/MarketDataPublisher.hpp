@@ -1,8 +1,11 @@
 #pragma once
+#include "ItchEncoder.hpp"
 #include "SPSCQueue.hpp"
-#include "OrderBook.hpp"
+#include "MarketDataEvent.hpp"
+#include "SymbolDirectory.hpp"
 #include "Threading.hpp"
 #include "UDPTransmitter.hpp"
+#include "WaitStrategy.hpp"
 
 #include <thread>
 #include <atomic>
@@ -11,18 +14,24 @@
 #include <iomanip>
 #include <immintrin.h>
 
-template<typename Transmitter>
+template<typename Transmitter, typename WaitStrategy = BusySpinWait>
 class MarketDataPublisher {
 private:
     std::shared_ptr<SPSCQueue<MarketDataEvent>> queue;
     std::thread thread;
     std::atomic<bool> running{ false };
+    int cpuId = CpuConfig{}.publisherCpu;
 
     Transmitter & transmitter;
+    SymbolDirectory symbols;
+    ItchEncoder encoder;
+
+    static constexpr size_t MAX_BATCH_SIZE = 64;
 
 public:
-    MarketDataPublisher(std::shared_ptr<SPSCQueue<MarketDataEvent>> queue_, Transmitter & transmitter_, size_t numRequests)
-        : queue(queue_), transmitter(transmitter_)
+    MarketDataPublisher(std::shared_ptr<SPSCQueue<MarketDataEvent>> queue_, Transmitter & transmitter_, size_t numRequests,
+                        const SymbolDirectory & symbols_ = SymbolDirectory::Default())
+        : queue(queue_), transmitter(transmitter_), symbols(symbols_), encoder(symbols)
     {
         receiveTimes.resize(numRequests);
         for (int i = 0; i < numRequests; i++)
@@ -34,6 +43,11 @@ public:
         Stop();
     }
 
+    void SetCpu(int cpuId_)
+    {
+        cpuId = cpuId_;
+    }
+
     void Start()
     {
         running = true;
@@ -52,8 +66,9 @@ public:
 
     void Run()
     {
-        PinThread(6);
+        PinThread(cpuId);
         uint64_t eventsProcessed = 0;
+        WaitStrategy waitStrategy;
 
         while (running)
         {
@@ -61,14 +76,28 @@ public:
 
             if (event == nullptr)
             {
-                _mm_pause();
+                waitStrategy.Idle(*queue);
                 continue;
             }
+            waitStrategy.Reset();
+
+            // Everything the engine has published so far goes out as one batch when the
+            // transmitter can encode batches, otherwise message by message
+            auto batch = queue->ReadSpan(MAX_BATCH_SIZE);
+            for (const auto & e : batch)
+                Record(e);
+            if constexpr (requires { transmitter.SendBatch(batch, encoder); })
+            {
+                transmitter.SendBatch(batch, encoder);
+            }
+            else
+            {
+                for (const auto & e : batch)
+                    Transmit(e);
+            }
+            eventsProcessed += batch.size();
 
-            Publish(*event);
-            eventsProcessed++;
-
-            queue->UpdateReadIndex();
+            queue->UpdateReadIndex(batch.size());
         }
 
         std::cout << "Market data publisher processed " << eventsProcessed << " events\n";
@@ -86,7 +115,7 @@ public:
     }
 
 private:
-    void Publish(const MarketDataEvent& event)
+    void Record(const MarketDataEvent& event)
     {
         if (!seenRequestIds[event.requestId])
         {
@@ -98,22 +127,59 @@ private:
         switch (event.type)
         {
         case EventType::ORDER_ACKED:
-            transmitter.SendOrderAdd(event.orderId, SYMBOLS[event.symbolId], event.side == Side::BUY ? 'B' : 'S', event.price, event.quantity, event.timestamp);
             stats.ackedOrders++;
             break;
         case EventType::ORDER_FILLED:
-            transmitter.SendOrderExecuted(event.orderId, event.quantity, event.tradeId, event.timestamp);
-            transmitter.SendOrderExecuted(event.restingOrderId, event.quantity, event.tradeId, event.timestamp);
-            transmitter.SendTradeMessage(SYMBOLS[event.symbolId], event.side == Side::BUY ? 'B' : 'S', event.price, event.quantity, event.tradeId, event.timestamp);
             stats.filledOrders++;
             break;
         case EventType::ORDER_CANCELLED:
-            transmitter.SendOrderDeleted(event.orderId, event.timestamp);
             stats.canceledOrders++;
             break;
         case EventType::ORDER_REJECTED:
             stats.rejectedOrders++;
             break;
+        case EventType::ORDER_REPLACED:
+            stats.replacedOrders++;
+            break;
+        case EventType::ORDER_REPLENISHED:
+            stats.replenishedOrders++;
+            break;
+        case EventType::STOP_ACCEPTED:
+            stats.stopOrders++;
+            break;
+        case EventType::TRADING_HALTED:
+            stats.haltedSymbols++;
+            break;
+        default:
+            break;
+        }
+    }
+
+    void Transmit(const MarketDataEvent& event)
+    {
+        switch (event.type)
+        {
+        case EventType::ORDER_ACKED:
+            transmitter.SendOrderAdd(event.orderId, symbols.Name(event.symbolId), event.side == Side::BUY ? 'B' : 'S', event.price, event.quantity, event.timestamp);
+            break;
+        case EventType::ORDER_FILLED:
+            transmitter.SendOrderExecuted(event.orderId, event.quantity, event.tradeId, event.timestamp);
+            transmitter.SendOrderExecuted(event.restingOrderId, event.quantity, event.tradeId, event.timestamp);
+            transmitter.SendTradeMessage(symbols.Name(event.symbolId), event.side == Side::BUY ? 'B' : 'S', event.price, event.quantity, event.tradeId, event.timestamp);
+            break;
+        case EventType::ORDER_CANCELLED:
+            transmitter.SendOrderDeleted(event.orderId, event.timestamp);
+            break;
+        case EventType::ORDER_REPLACED:
+        case EventType::ORDER_REPLENISHED:
+            transmitter.SendOrderReplaced(event.orderId, event.quantity, event.price, event.timestamp);
+            break;
+        case EventType::TRADING_HALTED:
+            transmitter.SendTradingAction(symbols.Name(event.symbolId), 'H', event.timestamp);
+            break;
+        case EventType::TRADING_RESUMED:
+            transmitter.SendTradingAction(symbols.Name(event.symbolId), 'T', event.timestamp);
+            break;
         default:
             break;
         }
@@ -129,5 +195,9 @@ public:
         uint64_t ackedOrders{0};
         uint64_t canceledOrders{0};
         uint64_t rejectedOrders{0};
+        uint64_t replacedOrders{0};
+        uint64_t replenishedOrders{0};
+        uint64_t stopOrders{0};
+        uint64_t haltedSymbols{0};
     } stats;
 };
\ No newline at end of file
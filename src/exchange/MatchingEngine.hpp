@@ -1,47 +1,253 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <span>
 #include <thread>
 
-#include "OrderBook.hpp"
+#include "AnyOrderBook.hpp"
+#include "RiskManager.hpp"
 #include "SPSCQueue.hpp"
-#include "SymbolMap.hpp"
+#include "SymbolDirectory.hpp"
 #include "OutputPolicy.hpp"
 #include "Threading.hpp"
+#include "WaitStrategy.hpp"
+#include "Memory.hpp"
 
-template<typename OutputPolicy>
+template<typename OutputPolicy, typename WaitStrategy = BusySpinWait>
 class MatchingEngine {
 private:
-    std::vector<std::unique_ptr<OrderBook>> books;
+    SymbolDirectory symbols;
+    RiskManager risk;
 
-    std::vector<char> orderToSymbol;
+    // Books are created on a symbol's first order, an idle symbol costs a null pointer. Their
+    // orders live in stores shared by all books.
+    OrderStores stores;
+    std::vector<std::unique_ptr<AnyOrderBook>> books;
+    // Set by a market-wide OpenAuction, books created during the call phase start in it
+    bool marketInAuction = false;
+
+    static constexpr SymbolId NO_SYMBOL = std::numeric_limits<SymbolId>::max();
+    std::vector<SymbolId> orderToSymbol;
+
+    static constexpr size_t MAX_BATCH_SIZE = 32;
 
     std::shared_ptr<SPSCQueue<OrderRequest>> inputQueue;
     OutputPolicy & output;
 
     std::thread thread;
     std::atomic<bool> running{ false };
+    int cpuId = CpuConfig{}.engineCpu;
 
     RejectionType ValidateOrder(const Order& order)
     {
         if (order.quantity == 0)
             return RejectionType::INVALID_QUANTITY;
 
-        if (order.type == OrderType::LIMIT && order.price <= 0)
+        if ((order.type == OrderType::LIMIT || order.type == OrderType::STOP_LIMIT) && order.price <= 0)
+            return RejectionType::INVALID_PRICE;
+
+        if ((order.type == OrderType::STOP || order.type == OrderType::STOP_LIMIT) && order.stopPrice == 0)
             return RejectionType::INVALID_PRICE;
 
+        if (order.sessionId >= MAX_SESSIONS)
+            return RejectionType::INVALID_SESSION;
+
+        if (order.accountId >= MAX_ACCOUNTS)
+            return RejectionType::INVALID_ACCOUNT;
+
         return RejectionType::NONE;
     }
 
-public:
-    MatchingEngine(std::shared_ptr<SPSCQueue<OrderRequest>> input, OutputPolicy & output_, size_t numBooks, size_t maxNumOrders)
-        : inputQueue(input), output(output_)
+    void ExecuteOrder(Order* order, RejectionType rejection)
+    {
+        if (rejection > RejectionType::NONE)
+        {
+            output.OnMarketEvent(MarketDataEvent(order->orderId, order->orderId, rejection));
+            return;
+        }
+
+        auto book = GetBook(order->symbolId);
+        rejection = book->CheckLimits(order->quantity, order->price, order->stopPrice);
+        if (rejection > RejectionType::NONE)
+        {
+            output.OnMarketEvent(MarketDataEvent(order->orderId, order->orderId, rejection));
+            return;
+        }
+        if (book->IsHalted())
+        {
+            output.OnMarketEvent(MarketDataEvent(order->orderId, order->orderId, RejectionType::SYMBOL_HALTED));
+            return;
+        }
+        if (book->InAuction() && order->type != OrderType::LIMIT)
+        {
+            output.OnMarketEvent(MarketDataEvent(order->orderId, order->orderId, RejectionType::NOT_ALLOWED_IN_AUCTION));
+            return;
+        }
+
+        rejection = risk.Check(*order);
+        if (rejection > RejectionType::NONE)
+        {
+            output.OnMarketEvent(MarketDataEvent(order->orderId, order->orderId, rejection));
+            return;
+        }
+
+        book->MatchOrder(order, output);
+        orderToSymbol[order->orderId] = order->symbolId;
+    }
+
+    AnyOrderBook* FindBookOfOrder(uint64_t orderId)
+    {
+        if (orderId >= orderToSymbol.size() || orderToSymbol[orderId] == NO_SYMBOL)
+            return nullptr;
+        return books[orderToSymbol[orderId]].get();
+    }
+
+    // The symbol's book if it has been created
+    AnyOrderBook* FindBook(SymbolId symbolId)
+    {
+        return symbolId < books.size() ? books[symbolId].get() : nullptr;
+    }
+
+    AnyOrderBook* FindBook(const Order & order)
+    {
+        return FindBook(order.symbolId);
+    }
+
+    AnyOrderBook* CreateBook(SymbolId symbolId)
     {
-        orderToSymbol.resize(maxNumOrders, -1);
-        books.reserve(numBooks);
-        for (int i = 0; i < numBooks; i++)
-            books.emplace_back(std::make_unique<OrderBook>(SYMBOLS[i], maxNumOrders));
+        auto & book = books[symbolId];
+        book = std::make_unique<AnyOrderBook>(symbols.Class(symbolId), symbolId, symbols.Name(symbolId), stores, &risk);
+        if (marketInAuction)
+            book->OpenAuction();
+        return book.get();
     }
 
+    template<typename F>
+    void ForEachBook(F f)
+    {
+        for (auto & book : books)
+            if (book)
+                f(*book);
+    }
+
+    // Order a cancel or modify acts on
+    static const uint64_t* TargetOf(const OrderRequest & req)
+    {
+        if (auto cancel = std::get_if<CancelRequest>(&req.data))
+            return &cancel->targetOrderId;
+        if (auto modify = std::get_if<ModifyRequest>(&req.data))
+            return &modify->targetOrderId;
+        return nullptr;
+    }
+
+    // At most MAX_BATCH_SIZE requests: validation, then staged prefetches, then execution
+    void SubmitWindow(std::span<OrderRequest> requests)
+    {
+        std::array<RejectionType, MAX_BATCH_SIZE> rejections;
+        for (size_t i = 0; i < requests.size(); i++)
+            if (const Order* order = std::get_if<Order>(&requests[i].data))
+                rejections[i] = ValidateOrder(*order);
+
+        for (auto & req : requests)
+        {
+            if (const Order* order = std::get_if<Order>(&req.data))
+            {
+                if (auto book = FindBook(*order))
+                    book->PrefetchLevels(*order);
+            }
+            else if (auto target = TargetOf(req); target && *target < orderToSymbol.size())
+            {
+                __builtin_prefetch(&orderToSymbol[*target]);
+            }
+        }
+        for (auto & req : requests)
+        {
+            if (const Order* order = std::get_if<Order>(&req.data))
+            {
+                if (auto book = FindBook(*order))
+                    book->PrefetchTopOrder(*order);
+            }
+            else if (auto target = TargetOf(req))
+            {
+                if (auto book = FindBookOfOrder(*target))
+                    book->PrefetchLookup(*target);
+            }
+        }
+        for (auto & req : requests)
+            if (auto target = TargetOf(req))
+                if (auto book = FindBookOfOrder(*target))
+                    book->PrefetchOrder(*target);
+        for (auto & req : requests)
+            if (auto target = TargetOf(req))
+                if (auto book = FindBookOfOrder(*target))
+                    book->PrefetchNeighbours(*target);
+
+        for (size_t i = 0; i < requests.size(); i++)
+        {
+            if (Order* order = std::get_if<Order>(&requests[i].data))
+            {
+                if (order->orderId >= orderToSymbol.size())
+                    throw std::runtime_error{ "Order id exceeds capacity" };
+                EventClock::StartRequest();
+                ExecuteOrder(order, rejections[i]);
+            }
+            else
+            {
+                ProcessRequest(requests[i]);
+            }
+        }
+    }
+
+    // Runs an add / fill / add / cancel cycle per symbol through the normal request path to
+    // warm caches, TLBs and branch predictors. Leaves the books empty and emits no output.
+    void RunSyntheticOrders(size_t count)
+    {
+        static constexpr uint32_t WARMUP_PRICE = 15000;
+
+        std::vector<SymbolId> active;
+        for (size_t symbolId = 0; symbolId < books.size(); symbolId++)
+            if (books[symbolId])
+                active.push_back(symbolId);
+
+        count = std::min(count, orderToSymbol.size()) / 4 * 4;
+        for (uint64_t id = 0; id < count; id += 4)
+        {
+            SymbolId symbolId = active[(id / 4) % active.size()];
+            uint32_t price = std::min<uint32_t>(WARMUP_PRICE, books[symbolId]->NumPriceLevels() / 2) + (id / 4) % 100;
+
+            Order sell(id, symbolId, Side::SELL, OrderType::LIMIT, 100, price);
+            SubmitOrder(&sell);
+            output.Discard();
+
+            Order buy(id + 1, symbolId, Side::BUY, OrderType::LIMIT, 100, price);
+            SubmitOrder(&buy);
+            output.Discard();
+
+            Order bid(id + 2, symbolId, Side::BUY, OrderType::LIMIT, 100, price - 1);
+            SubmitOrder(&bid);
+            output.Discard();
+
+            CancelOrder(id + 2, id + 3);
+            output.Discard();
+        }
+
+        std::fill(orderToSymbol.begin(), orderToSymbol.begin() + count, NO_SYMBOL);
+        ForEachBook([](AnyOrderBook & book) { book.Reset(); });
+        risk.Reset();
+    }
+
+public:
+    // Trades every symbol of the directory, each with a book of its instrument class
+    MatchingEngine(std::shared_ptr<SPSCQueue<OrderRequest>> input, OutputPolicy & output_, const SymbolDirectory & symbols_, size_t maxNumOrders)
+        : symbols(symbols_), risk(symbols_.Size()), stores(maxNumOrders), books(symbols_.Size()), orderToSymbol(maxNumOrders, NO_SYMBOL),
+          inputQueue(input), output(output_) {}
+
+    // The first numBooks built-in symbols, all equities
+    MatchingEngine(std::shared_ptr<SPSCQueue<OrderRequest>> input, OutputPolicy & output_, size_t numBooks, size_t maxNumOrders)
+        : MatchingEngine(input, output_, SymbolDirectory::Default(numBooks), maxNumOrders) {}
+
     MatchingEngine(OutputPolicy & output_, size_t numBooks = 1, size_t maxNumOrders = 20'000'000)
         : MatchingEngine(nullptr, output_, numBooks, maxNumOrders) {}
 
@@ -50,21 +256,98 @@ public:
         Stop();
     }
 
+    // Prepares the engine before trading opens: faults in (and optionally locks) every book
+    // created so far, the order stores and rings, then runs synthetic orders through the matching
+    // code on those books (on the first symbol's when there are none). Create the books of the
+    // symbols expected to trade with GetBook first. Call it from the engine's CPU and before the
+    // output consumer is started.
+    void WarmUp(const WarmupOptions & options = {})
+    {
+        if (std::none_of(books.begin(), books.end(), [](const auto & book) { return book != nullptr; }))
+            GetBook(0);
+
+        ForEachBook([&](AnyOrderBook & book) { book.Prefault(options); });
+        stores.Prefault(options);
+        PrefaultRange(orderToSymbol.data(), orderToSymbol.size() * sizeof(SymbolId), options);
+
+        if (inputQueue)
+            inputQueue->Prefault(options);
+        if constexpr (requires { output.Prefault(options); })
+            output.Prefault(options);
+
+        RunSyntheticOrders(options.syntheticOrders);
+    }
+
     void SubmitOrder(Order* order)
     {
         if (order->orderId >= orderToSymbol.size())
             throw std::runtime_error{ "Order id exceeds capacity" };
 
-        RejectionType rejection = ValidateOrder(*order);
+        EventClock::StartRequest();
+        ExecuteOrder(order, ValidateOrder(*order));
+    }
+
+    bool ModifyOrder(uint64_t targetOrderId, uint32_t newQuantity, uint32_t newPrice, uint64_t requestId = 0)
+    {
+        if (targetOrderId >= orderToSymbol.size())
+            throw std::runtime_error{ "Order id exceeds capacity" };
+
+        if (orderToSymbol[targetOrderId] == NO_SYMBOL)
+            return false;
+
+        EventClock::StartRequest();
+        RejectionType rejection = RejectionType::NONE;
+        if (newQuantity == 0)
+            rejection = RejectionType::INVALID_QUANTITY;
+        else if (newPrice == 0)
+            rejection = RejectionType::INVALID_PRICE;
+
+        auto book = GetBook(orderToSymbol[targetOrderId]);
+        if (rejection == RejectionType::NONE)
+            rejection = book->CheckLimits(newQuantity, newPrice);
+
         if (rejection > RejectionType::NONE)
         {
-            output.OnMarketEvent(MarketDataEvent(order->orderId, order->orderId, rejection));
-            return;
+            output.OnMarketEvent(MarketDataEvent(targetOrderId, requestId, rejection));
+            return false;
         }
 
-        auto book = GetBook(order->symbolId);
-        book->MatchOrder(order, output);
-        orderToSymbol[order->orderId] = order->symbolId;
+        if (book->IsHalted())
+        {
+            output.OnMarketEvent(MarketDataEvent(targetOrderId, requestId, RejectionType::SYMBOL_HALTED));
+            return false;
+        }
+        book->ModifyOrder(targetOrderId, requestId, newQuantity, newPrice, output);
+        return true;
+    }
+
+    // Cancels every matching resting order and publishes the cancels as one batch. Returns how
+    // many orders were cancelled.
+    size_t MassCancel(const MassCancelRequest & request)
+    {
+        EventClock::StartRequest();
+        if (request.sessionId != MassCancelRequest::ALL_SESSIONS && request.sessionId >= MAX_SESSIONS)
+        {
+            output.OnMarketEvent(MarketDataEvent(0, request.requestId, RejectionType::INVALID_SESSION));
+            return 0;
+        }
+
+        if constexpr (requires { output.BeginBatch(); })
+            output.BeginBatch();
+
+        size_t cancelled = 0;
+        if (request.symbolId == MassCancelRequest::ALL_SYMBOLS)
+        {
+            ForEachBook([&](AnyOrderBook & book) { cancelled += book.MassCancel(request.sessionId, request.side, request.requestId, output); });
+        }
+        else if (auto book = FindBook(request.symbolId))
+        {
+            cancelled = book->MassCancel(request.sessionId, request.side, request.requestId, output);
+        }
+
+        if constexpr (requires { output.EndBatch(); })
+            output.EndBatch();
+        return cancelled;
     }
 
     bool CancelOrder(uint64_t targetOrderId, uint64_t requestId = 0)
@@ -72,19 +355,157 @@ public:
         if (targetOrderId >= orderToSymbol.size())
             throw std::runtime_error{ "Order id exceeds capacity" };
 
-        if (orderToSymbol[targetOrderId] < 0)
+        if (orderToSymbol[targetOrderId] == NO_SYMBOL)
             return false;
 
+        EventClock::StartRequest();
         auto book = GetBook(orderToSymbol[targetOrderId]);
         book->CancelOrder(targetOrderId, requestId, output);
         return true;
     }
 
-    OrderBook* GetBook(uint8_t symbolId)
+    // Cancels in arrival order, with the lookups and dependent loads of the whole batch issued
+    // up front so their cache misses overlap instead of being paid one after another
+    void CancelBatch(std::span<const CancelRequest> cancels)
     {
-        if (symbolId < 0 || symbolId >= books.size())
+        for (const auto & cancel : cancels)
+            if (cancel.targetOrderId < orderToSymbol.size())
+                __builtin_prefetch(&orderToSymbol[cancel.targetOrderId]);
+        for (const auto & cancel : cancels)
+            if (auto book = FindBookOfOrder(cancel.targetOrderId))
+                book->PrefetchLookup(cancel.targetOrderId);
+        for (const auto & cancel : cancels)
+            if (auto book = FindBookOfOrder(cancel.targetOrderId))
+                book->PrefetchOrder(cancel.targetOrderId);
+        for (const auto & cancel : cancels)
+            if (auto book = FindBookOfOrder(cancel.targetOrderId))
+                book->PrefetchNeighbours(cancel.targetOrderId);
+
+        for (const auto & cancel : cancels)
+            CancelOrder(cancel.targetOrderId, cancel.requestId);
+    }
+
+    // Processes a burst of requests in strict arrival order, so priority is the same as
+    // submitting them one by one. Each window of the batch is validated up front and the
+    // books, levels and order slots it will touch are prefetched before anything executes.
+    // Output of the whole batch is published at once when the output policy supports it.
+    void SubmitBatch(std::span<OrderRequest> requests)
+    {
+        if constexpr (requires { output.BeginBatch(); })
+            output.BeginBatch();
+
+        for (size_t start = 0; start < requests.size(); start += MAX_BATCH_SIZE)
+            SubmitWindow(requests.subspan(start, std::min(MAX_BATCH_SIZE, requests.size() - start)));
+
+        if constexpr (requires { output.EndBatch(); })
+            output.EndBatch();
+    }
+
+    void ProcessRequest(OrderRequest & req)
+    {
+        if (Order* order = std::get_if<Order>(&req.data))
+        {
+            SubmitOrder(order);
+        }
+        else if (CancelRequest* cancelReq = std::get_if<CancelRequest>(&req.data))
+        {
+            CancelOrder(cancelReq->targetOrderId, cancelReq->requestId);
+        }
+        else if (ModifyRequest* modifyReq = std::get_if<ModifyRequest>(&req.data))
+        {
+            ModifyOrder(modifyReq->targetOrderId, modifyReq->quantity, modifyReq->price, modifyReq->requestId);
+        }
+        else if (MassCancelRequest* massCancelReq = std::get_if<MassCancelRequest>(&req.data))
+        {
+            MassCancel(*massCancelReq);
+        }
+    }
+
+    // Bounds how far one request can sweep the symbol: executions stay within widthTicks of a
+    // reference price that follows the last trade, and an order that runs into the band halts
+    // the symbol. While halted new orders and modifies are rejected, cancels still go through.
+    void SetPriceBand(SymbolId symbolId, uint32_t widthTicks, uint32_t referencePrice = 0)
+    {
+        GetBook(symbolId)->SetPriceBand(widthTicks, referencePrice);
+    }
+
+    // Call auctions for the open, the close or a reopening after a halt. Between the two calls
+    // only limit orders are accepted and nothing matches. A market-wide auction also covers
+    // books created during it.
+    void OpenAuction(SymbolId symbolId = MassCancelRequest::ALL_SYMBOLS)
+    {
+        if (symbolId == MassCancelRequest::ALL_SYMBOLS)
+        {
+            marketInAuction = true;
+            ForEachBook([](AnyOrderBook & book) { book.OpenAuction(); });
+        }
+        else
+        {
+            GetBook(symbolId)->OpenAuction();
+        }
+    }
+
+    // Uncrosses one symbol or all of them and publishes the fills as one batch. Returns the
+    // executed volume.
+    uint64_t Uncross(SymbolId symbolId = MassCancelRequest::ALL_SYMBOLS, uint64_t requestId = 0)
+    {
+        EventClock::StartRequest();
+        if constexpr (requires { output.BeginBatch(); })
+            output.BeginBatch();
+
+        uint64_t volume = 0;
+        if (symbolId == MassCancelRequest::ALL_SYMBOLS)
+        {
+            marketInAuction = false;
+            ForEachBook([&](AnyOrderBook & book) { volume += book.Uncross(requestId, output).volume; });
+        }
+        else if (auto book = FindBook(symbolId))
+        {
+            volume = book->Uncross(requestId, output).volume;
+        }
+
+        if constexpr (requires { output.EndBatch(); })
+            output.EndBatch();
+        return volume;
+    }
+
+    void ResumeTrading(SymbolId symbolId, uint32_t newReferencePrice = 0, uint64_t requestId = 0)
+    {
+        EventClock::StartRequest();
+        auto book = GetBook(symbolId);
+        book->Resume(newReferencePrice);
+        output.OnMarketEvent(MarketDataEvent(EventType::TRADING_RESUMED, 0, requestId, symbolId, Side::BUY, book->ReferencePrice(), 0));
+    }
+
+    // Limits are set through here, before the engine starts
+    RiskManager & GetRiskManager()
+    {
+        return risk;
+    }
+
+    // The symbol's book, created if the symbol has not been used yet
+    AnyOrderBook* GetBook(SymbolId symbolId)
+    {
+        if (symbolId >= books.size())
             throw std::runtime_error{ "Invalid symbol id" };
-        return books[symbolId].get();
+        if (auto book = books[symbolId].get()) [[likely]]
+            return book;
+        return CreateBook(symbolId);
+    }
+
+    const SymbolDirectory & Symbols() const
+    {
+        return symbols;
+    }
+
+    size_t NumActiveBooks() const
+    {
+        return std::count_if(books.begin(), books.end(), [](const auto & book) { return book != nullptr; });
+    }
+
+    void SetCpu(int cpuId_)
+    {
+        cpuId = cpuId_;
     }
 
     void Start()
@@ -104,27 +525,22 @@ public:
 
     void Run()
     {
-        PinThread(3);
+        PinThread(cpuId);
+        WaitStrategy waitStrategy;
         while (running)
         {
             OrderRequest* req = inputQueue->GetReadIndex();
 
             if (req == nullptr)
             {
-                _mm_pause();
+                waitStrategy.Idle(*inputQueue);
                 continue;
             }
+            waitStrategy.Reset();
 
-            if (Order* order = std::get_if<Order>(&req->data))
-            {
-                SubmitOrder(order);
-            }
-            else if (CancelRequest* cancelReq = std::get_if<CancelRequest>(&req->data))
-            {
-                CancelOrder(cancelReq->targetOrderId, cancelReq->requestId);
-            }
-
-            inputQueue->UpdateReadIndex();
+            auto batch = inputQueue->ReadSpan(MAX_BATCH_SIZE);
+            SubmitBatch(batch);
+            inputQueue->UpdateReadIndex(batch.size());
         }
     }
 };
\ No newline at end of file
@@ -1,101 +1,266 @@
 #pragma once
 #include "Order.hpp"
 #include "MarketDataEvent.hpp"
-#include "ObjectPool.hpp"
+#include "OrderStore.hpp"
 #include "OutputPolicy.hpp"
+#include "HugePageArena.hpp"
+#include "RiskManager.hpp"
+#include "PrefixSum.hpp"
+#include "PriceBitmap.hpp"
+#include "StopBook.hpp"
+#include "InstrumentTraits.hpp"
 
 #include <array>
 #include <span>
 #include <iostream>
 #include <vector>
 
-static constexpr double MAX_PRICE = 10000.0;
-static constexpr double TICK_SIZE = 0.01;
-static constexpr size_t NUM_PRICE_LEVELS = MAX_PRICE / TICK_SIZE + 1;
-
+// quantity is the open quantity of all orders at the level, kept up to date in the same
+// cache line the matching loop already writes
 struct PriceLevel
 {
-    Order* head = nullptr;
-    Order* tail = nullptr;
+    uint32_t head = NULL_SLOT;
+    uint32_t tail = NULL_SLOT;
+    uint64_t quantity = 0;
+};
+
+struct AuctionResult
+{
+    uint32_t price = 0;
+    uint64_t volume = 0;
 };
 
+// One instrument's book. The traits fix the ladder length and quantity width at compile time,
+// AnyOrderBook picks among the precompiled classes at runtime.
+template<InstrumentTraits Traits = EquityTraits>
 class OrderBook
 {
 private:
+    using Quantity = typename Traits::Quantity;
+    using Node = OrderNode<Quantity>;
+
+    static constexpr size_t NUM_PRICE_LEVELS = Traits::NUM_PRICE_LEVELS;
+
+    SymbolId symbolId;
     std::string_view symbol;
 
-    std::array<PriceLevel, NUM_PRICE_LEVELS> bids;
-    std::array<PriceLevel, NUM_PRICE_LEVELS> asks;
+    // Trade ids are the symbol id in the top bits over a sequence of the book's own, so they are
+    // unique across books and each book numbers its trades the same whichever engine or thread
+    // it runs in
+    static constexpr int TRADE_SEQUENCE_BITS = 48;
+    uint64_t nextTradeSequence = 1;
+
+    // Ladders, level bitmaps and session list heads live in one huge page backed mapping, the
+    // orders in the store shared with the other books of the same quantity width
+    HugePageArena arena;
+
+    std::span<PriceLevel> bids;
+    std::span<PriceLevel> asks;
 
     uint32_t maxBid = 0;
     uint32_t minAsk = NUM_PRICE_LEVELS;
 
-    std::vector<Order*> orders;
-    ObjectPool<Order> orderPool;
+    // Prices with resting orders on each side, for finding the next occupied level
+    PriceBitmap bidLevels;
+    PriceBitmap askLevels;
+
+    std::span<uint32_t> orders;
+    ObjectPool<Node> & nodes;
+    std::span<OrderInfo> infos;
+    std::span<uint32_t> sessionHeads;
+
+    // Told about fills and orders entering and leaving the book, optional
+    RiskManager* risk = nullptr;
+
+    // Dynamic price band: matching only executes within bandWidth ticks of the reference
+    // price, which follows the last trade. Reaching the band edge with liquidity left beyond it
+    // halts the symbol. A zero width or reference disables the band.
+    uint32_t bandWidth = 0;
+    uint32_t bandReference = 0;
+    uint32_t referencePrice = 0;
+    bool halted = false;
+
+    // Call phase of an auction, orders rest without matching until the uncross
+    bool inAuction = false;
+
+    // Pending stops, checked against the last trade price after every request that traded.
+    // Triggered ones wait in triggeredStops for their turn to match.
+    StopBook stops;
+    uint32_t lastTradePrice = 0;
+    std::vector<Order> triggeredStops;
+
+    // Level quantities over the crossed range and their running totals, reused between uncrosses
+    std::vector<uint64_t> bidDepth;
+    std::vector<uint64_t> askDepth;
+    std::vector<uint64_t> cumulativeBids;
+    std::vector<uint64_t> cumulativeAsks;
 
     uint64_t NextTradeId()
     {
-        static uint64_t nextTradeId = 1;
-        return nextTradeId++;
+        return (uint64_t(symbolId) << TRADE_SEQUENCE_BITS) | nextTradeSequence++;
     }
 
-    Order* RemoveOrder(Order* order, PriceLevel & level)
+    uint32_t RemoveOrder(uint32_t slot, PriceLevel & level)
     {
-        orders[order->orderId] = nullptr;
+        const auto & info = infos[slot];
+        if (info.sessionPrev != NULL_SLOT) infos[info.sessionPrev].sessionNext = info.sessionNext;
+        else sessionHeads[info.sessionId] = info.sessionNext;
 
-        if (order->prev) order->prev->next = order->next;
-        if (order->next) order->next->prev = order->prev;
+        if (info.sessionNext != NULL_SLOT) infos[info.sessionNext].sessionPrev = info.sessionPrev;
 
-        if (level.head == order) level.head = order->next;
-        if (level.tail == order) level.tail = order->prev;
+        return RemoveFromLevel(slot, level);
+    }
+
+    // Unlinks from the price level and id lookup only, for callers that drop the whole
+    // session list themselves
+    uint32_t RemoveFromLevel(uint32_t slot, PriceLevel & level)
+    {
+        if (risk)
+            risk->OnOrderClosed(infos[slot].accountId, infos[slot].symbolId);
+
+        auto & node = nodes[slot];
+        orders[node.orderId] = NULL_SLOT;
+        level.quantity -= node.RemainingQuantity() + infos[slot].reserveQuantity;
 
-        auto nextOrder = order->next;
-        order->next = nullptr;
-        order->prev = nullptr;
+        if (node.prev != NULL_SLOT) nodes[node.prev].next = node.next;
+        else level.head = node.next;
 
-        orderPool.Deallocate(order);
-        return nextOrder;
+        if (node.next != NULL_SLOT) nodes[node.next].prev = node.prev;
+        else level.tail = node.prev;
+
+        if (level.head == NULL_SLOT)
+            (infos[slot].side == Side::BUY ? bidLevels : askLevels).Clear(infos[slot].price);
+
+        auto nextSlot = node.next;
+        nodes.Deallocate(slot);
+        return nextSlot;
     }
 
+    // Shows the next slice of an iceberg whose slice was just used up and moves it to the back
+    // of its level by relinking in place. The order keeps its slot, id and session link and the
+    // level total does not change. Returns the order to continue matching with.
     template<typename OutputPolicy>
-    void AddOrder(Order* orderToAdd, OutputPolicy & output)
+    uint32_t Replenish(uint32_t slot, PriceLevel & level, uint64_t requestId, OutputPolicy & output)
+    {
+        auto & node = nodes[slot];
+        auto & info = infos[slot];
+
+        uint32_t slice = std::min(info.displayQuantity, info.reserveQuantity);
+        info.reserveQuantity -= slice;
+        node.quantity += slice;
+
+        auto nextSlot = node.next;
+        if (nextSlot != NULL_SLOT)
+        {
+            if (node.prev != NULL_SLOT) nodes[node.prev].next = nextSlot;
+            else level.head = nextSlot;
+            nodes[nextSlot].prev = node.prev;
+
+            nodes[level.tail].next = slot;
+            node.prev = level.tail;
+            node.next = NULL_SLOT;
+            level.tail = slot;
+        }
+
+        output.OnMarketEvent(MarketDataEvent(EventType::ORDER_REPLENISHED, node.orderId, requestId, info.symbolId, info.side, info.price, slice));
+        return nextSlot != NULL_SLOT ? nextSlot : slot;
+    }
+
+    // An order whose shown quantity is used up either shows its next slice or leaves the book
+    template<typename OutputPolicy>
+    uint32_t RetireFilled(uint32_t slot, PriceLevel & level, uint64_t requestId, OutputPolicy & output)
+    {
+        if (infos[slot].reserveQuantity > 0)
+            return Replenish(slot, level, requestId, output);
+        return RemoveOrder(slot, level);
+    }
+
+    template<typename OutputPolicy>
+    void AddOrder(Order* order, OutputPolicy & output)
+    {
+        auto slot = InsertOrder(order);
+        output.OnMarketEvent(MarketDataEvent(order->orderId, order->orderId, order->symbolId, order->side, order->price, nodes[slot].RemainingQuantity()));
+    }
+
+    // Returns the slot the order rests at
+    uint32_t InsertOrder(Order* orderToAdd)
     {
         if (orderToAdd->orderId >= orders.size())
             throw std::runtime_error{ "Order id exceeds capacity" };
 
-        Order* order = orderPool.Allocate();
-        *order = *orderToAdd;
+        uint32_t slot = nodes.Allocate();
+        if (slot == NULL_SLOT)
+            throw std::runtime_error{ "Order pool exhausted" };
 
-        orders[order->orderId] = order;
+        Order* order = orderToAdd;
+        orders[order->orderId] = slot;
 
         PriceLevel & level = (order->side == Side::BUY ? bids[order->price] : asks[order->price]);
 
-        if (level.head == nullptr)
+        uint32_t remaining = order->RemainingQuantity();
+        uint32_t shown = order->displayQuantity > 0 ? std::min(order->displayQuantity, remaining) : remaining;
+
+        auto & sessionHead = sessionHeads[order->sessionId];
+        nodes[slot] = Node{ NULL_SLOT, level.tail, Quantity(order->filledQuantity + shown), Quantity(order->filledQuantity), order->orderId };
+        infos[slot] = OrderInfo{ order->timestamp, order->price, order->displayQuantity, remaining - shown, sessionHead, NULL_SLOT, order->sessionId, order->accountId, order->symbolId, order->side, order->type };
+        if (sessionHead != NULL_SLOT)
+            infos[sessionHead].sessionPrev = slot;
+        sessionHead = slot;
+
+        if (risk)
+            risk->OnOrderRested(order->accountId, order->symbolId);
+
+        if (level.head == NULL_SLOT)
         {
-            level.head = order;
-            level.tail = order;
-            order->next = nullptr;
-            order->prev = nullptr;
+            level.head = slot;
+            (order->side == Side::BUY ? bidLevels : askLevels).Set(order->price);
         }
         else
         {
-            level.tail->next = order;
-            order->prev = level.tail;
-            order->next = nullptr;
-            level.tail = order;
+            nodes[level.tail].next = slot;
         }
+        level.tail = slot;
+        level.quantity += remaining;
 
         if (order->side == Side::BUY)
             maxBid = std::max(maxBid, order->price);
         else
             minAsk = std::min(minAsk, order->price);
+        return slot;
+    }
 
-        output.OnMarketEvent(MarketDataEvent(order->orderId, order->orderId, order->symbolId, order->side, order->price, order->RemainingQuantity()));
+    // Matches an incoming order against the opposite side, FOK orders only if they fill fully.
+    // Its events carry requestId, which is the order's own id unless a modify moved it.
+    // Returns false when a FOK order was killed.
+    template<typename OutputPolicy>
+    bool MatchIncoming(Order* order, uint64_t requestId, OutputPolicy & output)
+    {
+        const bool banded = bandWidth > 0 && referencePrice > 0;
+        if (order->side == Side::BUY)
+        {
+            uint32_t bandEdge = banded ? std::min<uint32_t>(referencePrice + bandWidth, NUM_PRICE_LEVELS - 1) : NUM_PRICE_LEVELS;
+            if (order->type == OrderType::FOK && !CheckAvailableLiquidity(order, asks, minAsk, NUM_PRICE_LEVELS, bandEdge, 1, false))
+                return false;
+            MatchAgainstBook(order, requestId, asks, askLevels, minAsk, NUM_PRICE_LEVELS, bandEdge, 1, false, output);
+        }
+        else
+        {
+            uint32_t bandEdge = banded ? (referencePrice > bandWidth ? referencePrice - bandWidth : 1) : 0;
+            if (order->type == OrderType::FOK && !CheckAvailableLiquidity(order, bids, maxBid, 0, bandEdge, -1, true))
+                return false;
+            MatchAgainstBook(order, requestId, bids, bidLevels, maxBid, 0, bandEdge, -1, true, output);
+        }
+        return true;
     }
 
+    // bandEdge is the last price the sweep may execute at, endOfBook when there is no band.
+    // Stopping at the band with the order still marketable halts the symbol.
     template<typename OutputPolicy>
-    void MatchAgainstBook(Order* order, std::span<PriceLevel> bookSide, uint32_t & topPrice, uint32_t endOfBook, char dir, bool shouldBeLess, OutputPolicy & output)
+    void MatchAgainstBook(Order* order, uint64_t requestId, std::span<PriceLevel> bookSide, const PriceBitmap & occupied, uint32_t & topPrice, uint32_t endOfBook, uint32_t bandEdge, char dir, bool shouldBeLess, OutputPolicy & output)
     {
+        const uint32_t filledBefore = order->filledQuantity;
+        uint32_t lastFillPrice = 0;
+
         while (topPrice != endOfBook && order->RemainingQuantity() > 0)
         {
             if (order->price > 0 && topPrice != order->price && (topPrice < order->price) == shouldBeLess)
@@ -103,121 +268,604 @@ private:
 
             auto & level = bookSide[topPrice];
 
-            if (level.head == nullptr)
+            if (topPrice != bandEdge && (topPrice < bandEdge) == shouldBeLess)
+            {
+                // Only liquidity beyond the band is a breach, empty levels just settle the top
+                if (level.head == NULL_SLOT)
+                {
+                    topPrice += dir;
+                    continue;
+                }
+                halted = true;
+                output.OnMarketEvent(MarketDataEvent(EventType::TRADING_HALTED, 0, requestId, order->symbolId, order->side, bandEdge, 0));
+                break;
+            }
+
+            if (level.head == NULL_SLOT)
             {
                 topPrice += dir;
                 continue;
             }
+            lastFillPrice = topPrice;
+
+            // Start pulling in the first order of the next occupied level
+            auto nextPrice = shouldBeLess ? occupied.PrevSet(topPrice - 1) : occupied.NextSet(topPrice + 1);
+            if (nextPrice != PriceBitmap::NONE)
+                __builtin_prefetch(&nodes[bookSide[nextPrice].head], 1);
 
             auto resting = level.head;
-            while (resting != nullptr && order->RemainingQuantity() > 0)
+            while (resting != NULL_SLOT && order->RemainingQuantity() > 0)
             {
-                uint32_t filledQty = std::min(order->RemainingQuantity(), resting->RemainingQuantity());
+                auto & node = nodes[resting];
+
+                // One fill and its event is enough work to hide the next order's miss. Going two
+                // ahead needs a dependent load and measured slower.
+                __builtin_prefetch(&nodes[node.next], 1);
+
+                uint32_t filledQty = std::min<uint32_t>(order->RemainingQuantity(), node.RemainingQuantity());
 
                 order->filledQuantity += filledQty;
-                resting->filledQuantity += filledQty;
+                node.filledQuantity += filledQty;
+                level.quantity -= filledQty;
+
+                if (risk)
+                    risk->OnFill(infos[resting].accountId, order->symbolId, infos[resting].side, filledQty);
 
-                output.OnMarketEvent(MarketDataEvent(order->orderId, order->orderId, order->symbolId, NextTradeId(), resting->orderId, resting->price, filledQty));
+                output.OnMarketEvent(MarketDataEvent(order->orderId, requestId, order->symbolId, NextTradeId(), node.orderId, topPrice, filledQty));
 
-                if (resting->IsFilled())
-                    resting = RemoveOrder(resting, level);
+                if (node.IsFilled())
+                    resting = RetireFilled(resting, level, requestId, output);
             }
 
-            if (level.head == nullptr)
+            if (level.head == NULL_SLOT)
                 topPrice += dir;
         }
+
+        if (order->filledQuantity > filledBefore)
+        {
+            referencePrice = lastFillPrice;
+            lastTradePrice = lastFillPrice;
+
+            // The aggressor's position moves once for the whole sweep
+            if (risk)
+            {
+                risk->OnFill(order->accountId, order->symbolId, order->side, order->filledQuantity - filledBefore);
+                risk->OnTrade(order->symbolId, lastFillPrice);
+            }
+        }
     }
 
-    bool CheckAvailableLiquidity(Order* order, std::span<PriceLevel> bookSide, uint32_t topPrice, uint32_t endOfBook, char dir, bool shouldBeLess)
+    // Over the crossed range [lo, hi] demand at p is every bid at p or above, supply every ask
+    // at p or below. Both come from one prefix sum over the level quantities of each side.
+    AuctionResult FindEquilibrium(uint32_t lo, uint32_t hi)
     {
-        uint32_t availableShares = 0;
-        auto idx = topPrice;
+        size_t count = hi - lo + 1;
+        bidDepth.resize(count);
+        askDepth.resize(count);
+        cumulativeBids.resize(count);
+        cumulativeAsks.resize(count);
 
-        while (idx != endOfBook && availableShares < order->quantity)
+        for (size_t i = 0; i < count; i++)
         {
-            if (order->price > 0 && idx != order->price && (idx < order->price) == shouldBeLess)
-                break;
+            bidDepth[i] = bids[lo + i].quantity;
+            askDepth[i] = asks[lo + i].quantity;
+        }
+        InclusivePrefixSum(bidDepth.data(), cumulativeBids.data(), count);
+        InclusivePrefixSum(askDepth.data(), cumulativeAsks.data(), count);
 
-            auto & level = bookSide[idx];
+        const uint64_t totalBids = cumulativeBids[count - 1];
+        AuctionResult best;
+        uint64_t bestImbalance = UINT64_MAX;
+        uint32_t bestDistance = UINT32_MAX;
 
-            if (level.head == nullptr)
+        for (size_t i = 0; i < count; i++)
+        {
+            uint64_t demand = totalBids - cumulativeBids[i] + bidDepth[i];
+            uint64_t supply = cumulativeAsks[i];
+            uint64_t volume = std::min(demand, supply);
+            uint64_t imbalance = demand > supply ? demand - supply : supply - demand;
+
+            uint32_t price = lo + i;
+            uint32_t distance = referencePrice == 0 ? 0 : (price > referencePrice ? price - referencePrice : referencePrice - price);
+
+            if (volume > best.volume
+                || (volume == best.volume && (imbalance < bestImbalance || (imbalance == bestImbalance && distance < bestDistance))))
             {
-                idx += dir;
-                continue;
+                best = { price, volume };
+                bestImbalance = imbalance;
+                bestDistance = distance;
             }
+        }
+        return best;
+    }
 
-            auto resting = level.head;
-            while (resting != nullptr && availableShares < order->quantity)
+    // Pairs off the best bid and best ask in time priority until the auction volume is done,
+    // every fill at the auction price
+    template<typename OutputPolicy>
+    void ExecuteAuction(const AuctionResult & auction, uint64_t requestId, OutputPolicy & output)
+    {
+        uint64_t remaining = auction.volume;
+        uint32_t bidPrice = maxBid;
+        uint32_t askPrice = minAsk;
+
+        while (remaining > 0)
+        {
+            while (bids[bidPrice].head == NULL_SLOT) bidPrice--;
+            while (asks[askPrice].head == NULL_SLOT) askPrice++;
+
+            auto & bidLevel = bids[bidPrice];
+            auto & askLevel = asks[askPrice];
+            auto bidSlot = bidLevel.head;
+            auto askSlot = askLevel.head;
+            auto & bid = nodes[bidSlot];
+            auto & ask = nodes[askSlot];
+            __builtin_prefetch(&nodes[bid.next], 1);
+            __builtin_prefetch(&nodes[ask.next], 1);
+            __builtin_prefetch(&infos[bid.next], 1);
+            __builtin_prefetch(&infos[ask.next], 1);
+            __builtin_prefetch(&orders[bid.orderId], 1);
+            __builtin_prefetch(&orders[ask.orderId], 1);
+
+            uint32_t filledQty = std::min<uint64_t>({ remaining, bid.RemainingQuantity(), ask.RemainingQuantity() });
+            bid.filledQuantity += filledQty;
+            ask.filledQuantity += filledQty;
+            bidLevel.quantity -= filledQty;
+            askLevel.quantity -= filledQty;
+            remaining -= filledQty;
+
+            const auto & bidInfo = infos[bidSlot];
+            const auto & askInfo = infos[askSlot];
+            if (risk)
+            {
+                risk->OnFill(bidInfo.accountId, bidInfo.symbolId, Side::BUY, filledQty);
+                risk->OnFill(askInfo.accountId, askInfo.symbolId, Side::SELL, filledQty);
+            }
+
+            output.OnMarketEvent(MarketDataEvent(bid.orderId, requestId, bidInfo.symbolId, NextTradeId(), ask.orderId, auction.price, filledQty));
+
+            if (risk && remaining == 0)
+                risk->OnTrade(bidInfo.symbolId, auction.price);
+
+            if (bid.IsFilled())
+                RetireFilled(bidSlot, bidLevel, requestId, output);
+            if (ask.IsFilled())
+                RetireFilled(askSlot, askLevel, requestId, output);
+        }
+    }
+
+    // Continuous matching of a new order, what is left of a limit order rests
+    template<typename OutputPolicy>
+    void ExecuteNewOrder(Order* order, OutputPolicy & output)
+    {
+        if (!MatchIncoming(order, order->orderId, output))
+        {
+            output.OnMarketEvent(MarketDataEvent(order->orderId, order->orderId));
+            return;
+        }
+
+        // An order stopped by the band would cross the book if it rested, its remainder is cancelled
+        if (order->RemainingQuantity() > 0)
+        {
+            if (order->type == OrderType::LIMIT && !halted)
+                AddOrder(order, output);
+            else
+                output.OnMarketEvent(MarketDataEvent(order->orderId, order->orderId));
+        }
+    }
+
+    static OrderType TriggeredType(OrderType type)
+    {
+        return type == OrderType::STOP ? OrderType::MARKET : OrderType::LIMIT;
+    }
+
+    // Runs the stops the last trade triggered, in the order StopBook hands them out. Trades they
+    // make can trigger more, which queue behind them, so a whole cascade completes within the
+    // request that set it off and always in the same order. Triggered orders are risk checked
+    // again and are rejected once the symbol has halted.
+    template<typename OutputPolicy>
+    void RunStopCascade(OutputPolicy & output)
+    {
+        stops.CollectTriggered(lastTradePrice, triggeredStops);
+        for (size_t i = 0; i < triggeredStops.size(); i++)
+        {
+            Order order = triggeredStops[i];
+            order.type = TriggeredType(order.type);
+
+            RejectionType rejection = halted ? RejectionType::SYMBOL_HALTED : (risk ? risk->Check(order) : RejectionType::NONE);
+            if (rejection > RejectionType::NONE)
             {
-                availableShares += resting->RemainingQuantity();
-                resting = resting->next;
+                output.OnMarketEvent(MarketDataEvent(order.orderId, order.orderId, rejection));
+                continue;
             }
 
+            ExecuteNewOrder(&order, output);
+            if (stops.AnyTriggered(lastTradePrice))
+                stops.CollectTriggered(lastTradePrice, triggeredStops);
+        }
+        triggeredStops.clear();
+    }
+
+    // Counts whole levels from their totals, which include iceberg reserves, without walking the
+    // orders. Liquidity beyond the band does not count, a FOK order that needs it is killed.
+    bool CheckAvailableLiquidity(Order* order, std::span<PriceLevel> bookSide, uint32_t topPrice, uint32_t endOfBook, uint32_t bandEdge, char dir, bool shouldBeLess)
+    {
+        uint64_t availableShares = 0;
+        auto idx = topPrice;
+
+        while (idx != endOfBook && availableShares < order->quantity)
+        {
+            if (order->price > 0 && idx != order->price && (idx < order->price) == shouldBeLess)
+                break;
+
+            if (idx != bandEdge && (idx < bandEdge) == shouldBeLess)
+                break;
+
+            availableShares += bookSide[idx].quantity;
             idx += dir;
         }
         return availableShares >= order->quantity;
     }
 
 public:
-    OrderBook(std::string_view symbol_, size_t numMaxOrders) : symbol(std::move(symbol_)), orderPool(numMaxOrders)
+    OrderBook(SymbolId symbolId_, std::string_view symbol_, OrderStore<Quantity> & store, StopStore & stopStore, RiskManager* risk_ = nullptr)
+        : symbolId(symbolId_),
+          symbol(std::move(symbol_)),
+          arena(2 * HugePageArena::BytesFor<PriceLevel>(NUM_PRICE_LEVELS) + 2 * PriceBitmap::BytesFor(NUM_PRICE_LEVELS)
+                + HugePageArena::BytesFor<uint32_t>(MAX_SESSIONS), false),
+          bids(arena.Allocate<PriceLevel>(NUM_PRICE_LEVELS), NUM_PRICE_LEVELS),
+          asks(arena.Allocate<PriceLevel>(NUM_PRICE_LEVELS), NUM_PRICE_LEVELS),
+          bidLevels(NUM_PRICE_LEVELS, arena),
+          askLevels(NUM_PRICE_LEVELS, arena),
+          orders(store.orders),
+          nodes(store.nodes),
+          infos(store.infos),
+          sessionHeads(arena.Allocate<uint32_t>(MAX_SESSIONS), MAX_SESSIONS),
+          risk(risk_),
+          stops(NUM_PRICE_LEVELS, stopStore)
     {
-        orders.resize(numMaxOrders, nullptr);
+        // Zero-filled arena memory already is empty levels, bitmaps and session lists. The ladders
+        // start on 4 KB pages so a book created mid-session faults in a few pages instead of whole
+        // huge pages, Prefault moves them to huge pages.
     }
 
+    void Prefault(const WarmupOptions & options)
+    {
+        arena.Prefault(options);
+        stops.Prefault(options);
+    }
+
+    size_t HugePageSize() const
+    {
+        return arena.HugePageSize();
+    }
+
+    static constexpr size_t NumPriceLevels()
+    {
+        return NUM_PRICE_LEVELS;
+    }
+
+    // Rejects prices beyond the ladder and quantities wider than the instrument's quantity type
+    static constexpr RejectionType CheckLimits(uint32_t quantity, uint32_t price, uint32_t stopPrice = 0)
+    {
+        if (quantity > std::numeric_limits<Quantity>::max())
+            return RejectionType::INVALID_QUANTITY;
+        if (price >= NUM_PRICE_LEVELS || stopPrice >= NUM_PRICE_LEVELS)
+            return RejectionType::INVALID_PRICE;
+        return RejectionType::NONE;
+    }
+
+    // Removes every resting order and puts the top of book back to the empty state
+    void Reset()
+    {
+        for (auto price = maxBid; price > 0; price--)
+            while (bids[price].head != NULL_SLOT)
+                RemoveOrder(bids[price].head, bids[price]);
+
+        for (auto price = minAsk; price < NUM_PRICE_LEVELS; price++)
+            while (asks[price].head != NULL_SLOT)
+                RemoveOrder(asks[price].head, asks[price]);
+
+        maxBid = 0;
+        minAsk = NUM_PRICE_LEVELS;
+        stops.Reset();
+        lastTradePrice = 0;
+        referencePrice = bandReference;
+        halted = false;
+        inAuction = false;
+        nextTradeSequence = 1;
+    }
+
+    // Starts the call phase. Limit orders rest without matching and the book may cross until
+    // Uncross. Opening an auction on a halted book lifts the halt, so it reopens through it.
+    void OpenAuction()
+    {
+        inAuction = true;
+        halted = false;
+    }
+
+    bool InAuction() const
+    {
+        return inAuction;
+    }
+
+    // Ends the call phase at the single price that executes the most volume, then leaves the
+    // smallest imbalance, then is closest to the reference price (the lowest one without a
+    // reference). Fills follow price and then time priority on both sides.
     template<typename OutputPolicy>
-    void CancelOrder(uint64_t targetOrderId, uint64_t requestId, OutputPolicy & output)
+    AuctionResult Uncross(uint64_t requestId, OutputPolicy & output)
+    {
+        inAuction = false;
+
+        auto [bestBid, bestAsk] = GetTopOfBook();
+        if (bestBid == 0 || bestAsk == NUM_PRICE_LEVELS || bestBid < bestAsk)
+            return {};
+
+        auto auction = FindEquilibrium(bestAsk, bestBid);
+        ExecuteAuction(auction, requestId, output);
+        referencePrice = auction.price;
+        lastTradePrice = auction.price;
+
+        GetTopOfBook();
+        if (stops.AnyTriggered(lastTradePrice))
+            RunStopCascade(output);
+        return auction;
+    }
+
+    // Band of widthTicks around referencePrice, which then moves with every trade. Without a
+    // reference price the band starts at the first trade. A zero width turns the band off.
+    void SetPriceBand(uint32_t widthTicks, uint32_t referencePrice_ = 0)
+    {
+        bandWidth = widthTicks;
+        bandReference = referencePrice_;
+        referencePrice = referencePrice_;
+    }
+
+    bool IsHalted() const
+    {
+        return halted;
+    }
+
+    uint32_t ReferencePrice() const
+    {
+        return referencePrice;
+    }
+
+    // Reopens a halted symbol, optionally around a new reference price
+    void Resume(uint32_t newReferencePrice = 0)
     {
-        if (orders[targetOrderId] == nullptr)
+        if (newReferencePrice > 0)
+            referencePrice = newReferencePrice;
+        halted = false;
+    }
+
+    // Stages of the batched submit pipeline: the levels a new order is going to touch (the best
+    // opposite level, the level it would rest at and its id slot), then the best opposite order
+    void PrefetchLevels(const Order & order)
+    {
+        if (order.side == Side::BUY)
         {
-            output.OnMarketEvent(MarketDataEvent(targetOrderId, requestId, RejectionType::ORDER_NOT_FOUND));
-            return;
+            __builtin_prefetch(&asks[std::min<uint32_t>(minAsk, NUM_PRICE_LEVELS - 1)]);
+            if (order.price < NUM_PRICE_LEVELS)
+                __builtin_prefetch(&bids[order.price], 1);
         }
+        else
+        {
+            __builtin_prefetch(&bids[maxBid]);
+            if (order.price < NUM_PRICE_LEVELS)
+                __builtin_prefetch(&asks[order.price], 1);
+        }
+
+        if (order.orderId < orders.size())
+            __builtin_prefetch(&orders[order.orderId], 1);
+    }
+
+    void PrefetchTopOrder(const Order & order)
+    {
+        const auto & level = (order.side == Side::BUY ? asks[std::min<uint32_t>(minAsk, NUM_PRICE_LEVELS - 1)] : bids[maxBid]);
+        __builtin_prefetch(&nodes[level.head], 1);
+    }
+
+    // Stages of the batched cancel pipeline. Each stage reads what the previous one prefetched:
+    // the id lookup, then the order's node and info, then its neighbours and price level.
+    void PrefetchLookup(uint64_t targetOrderId)
+    {
+        __builtin_prefetch(&orders[targetOrderId]);
+    }
 
-        auto order = orders[targetOrderId];
+    void PrefetchOrder(uint64_t targetOrderId)
+    {
+        auto slot = orders[targetOrderId];
+        __builtin_prefetch(&nodes[slot], 1);
+        __builtin_prefetch(&infos[slot]);
+    }
+
+    void PrefetchNeighbours(uint64_t targetOrderId)
+    {
+        auto slot = orders[targetOrderId];
+        if (slot == NULL_SLOT)
+            return;
 
-        auto & level = (order->side == Side::BUY ? bids[order->price] : asks[order->price]);
-        RemoveOrder(order, level);
+        const auto & node = nodes[slot];
+        __builtin_prefetch(&nodes[node.prev], 1);
+        __builtin_prefetch(&nodes[node.next], 1);
 
-        output.OnMarketEvent(MarketDataEvent(order->orderId, requestId));
+        const auto & info = infos[slot];
+        __builtin_prefetch(info.side == Side::BUY ? &bids[info.price] : &asks[info.price], 1);
     }
 
     template<typename OutputPolicy>
-    void MatchOrder(Order* order, OutputPolicy & output)
+    void CancelOrder(uint64_t targetOrderId, uint64_t requestId, OutputPolicy & output)
     {
-        if (order->side == Side::BUY)
+        auto slot = orders[targetOrderId];
+        if (slot == NULL_SLOT)
         {
-            if (order->type == OrderType::FOK && !CheckAvailableLiquidity(order, asks, minAsk, NUM_PRICE_LEVELS, 1, false))
+            if (auto stop = stops.Cancel(targetOrderId))
+                output.OnMarketEvent(MarketDataEvent(EventType::STOP_CANCELLED, targetOrderId, requestId, stop->symbolId, stop->side, stop->stopPrice, stop->quantity));
+            else
+                output.OnMarketEvent(MarketDataEvent(targetOrderId, requestId, RejectionType::ORDER_NOT_FOUND));
+            return;
+        }
+
+        const auto & info = infos[slot];
+        auto & level = (info.side == Side::BUY ? bids[info.price] : asks[info.price]);
+        RemoveOrder(slot, level);
+
+        output.OnMarketEvent(MarketDataEvent(targetOrderId, requestId));
+    }
+
+    // Cancels the resting orders of one session (or of every session for ALL_SESSIONS), on one
+    // side or both, by walking only that session's list. Without a side filter the whole list
+    // is dropped at once instead of being unlinked order by order. Returns how many orders
+    // were cancelled.
+    template<typename OutputPolicy>
+    size_t MassCancel(uint16_t sessionId, std::optional<Side> side, uint64_t requestId, OutputPolicy & output)
+    {
+        size_t cancelled = 0;
+
+        auto cancelSession = [&](uint16_t session) {
+            auto slot = sessionHeads[session];
+            if (!side)
+                sessionHeads[session] = NULL_SLOT;
+
+            while (slot != NULL_SLOT)
             {
-                output.OnMarketEvent(MarketDataEvent(order->orderId, order->orderId));
-                return;
+                const auto & info = infos[slot];
+                auto next = info.sessionNext;
+                __builtin_prefetch(&infos[next]);
+
+                if (!side || info.side == *side)
+                {
+                    uint64_t orderId = nodes[slot].orderId;
+                    auto & level = (info.side == Side::BUY ? bids[info.price] : asks[info.price]);
+                    if (side)
+                        RemoveOrder(slot, level);
+                    else
+                        RemoveFromLevel(slot, level);
+
+                    output.OnMarketEvent(MarketDataEvent(orderId, requestId));
+                    cancelled++;
+                }
+                slot = next;
             }
+        };
 
-            MatchAgainstBook(order, asks, minAsk, NUM_PRICE_LEVELS, 1, false, output);
+        if (sessionId == MassCancelRequest::ALL_SESSIONS)
+        {
+            for (uint16_t session = 0; session < MAX_SESSIONS; session++)
+                if (sessionHeads[session] != NULL_SLOT)
+                    cancelSession(session);
         }
         else
         {
-            if (order->type == OrderType::FOK && !CheckAvailableLiquidity(order, bids, maxBid, 0, -1, true))
+            cancelSession(sessionId);
+        }
+
+        stops.MassCancel(sessionId, side, [&](const StopNode & stop) {
+            output.OnMarketEvent(MarketDataEvent(EventType::STOP_CANCELLED, stop.orderId, requestId, stop.symbolId, stop.side, stop.stopPrice, stop.quantity));
+            cancelled++;
+        });
+
+        // Removal leaves the best prices stale, settle them once for the whole batch
+        GetTopOfBook();
+        return cancelled;
+    }
+
+    // Reducing the open quantity at an unchanged price is done in place and keeps the order's
+    // place in the queue. A price change or size increase takes the order out and re-enters it
+    // at the new terms, matching first if the new price crosses. Either way the feed sees one
+    // replace event, followed by any fills.
+    template<typename OutputPolicy>
+    void ModifyOrder(uint64_t targetOrderId, uint64_t requestId, uint32_t newQuantity, uint32_t newPrice, OutputPolicy & output)
+    {
+        auto slot = orders[targetOrderId];
+        if (slot == NULL_SLOT)
+        {
+            output.OnMarketEvent(MarketDataEvent(targetOrderId, requestId, RejectionType::ORDER_NOT_FOUND));
+            return;
+        }
+
+        auto & node = nodes[slot];
+        const auto info = infos[slot];
+        const uint64_t now = EventClock::Now();
+
+        if (risk)
+        {
+            Order terms(targetOrderId, info.symbolId, info.side, OrderType::LIMIT, newQuantity, newPrice, info.sessionId, info.accountId, now);
+            if (auto rejection = risk->Check(terms, false); rejection > RejectionType::NONE)
             {
-                output.OnMarketEvent(MarketDataEvent(order->orderId, order->orderId));
+                output.OnMarketEvent(MarketDataEvent(targetOrderId, requestId, rejection));
                 return;
             }
+        }
 
-            MatchAgainstBook(order, bids, maxBid, 0, -1, true, output);
+        // For icebergs the new quantity is the total of the shown slice and the reserve, a
+        // reduction comes out of the reserve first
+        const uint32_t openQuantity = node.RemainingQuantity() + info.reserveQuantity;
+        if (newPrice == info.price && newQuantity <= openQuantity)
+        {
+            auto & level = (info.side == Side::BUY ? bids[info.price] : asks[info.price]);
+            level.quantity -= openQuantity - newQuantity;
+
+            uint32_t shown = std::min<uint32_t>(node.RemainingQuantity(), newQuantity);
+            infos[slot].reserveQuantity = newQuantity - shown;
+            node.quantity = node.filledQuantity + shown;
+            output.OnMarketEvent(MarketDataEvent(EventType::ORDER_REPLACED, targetOrderId, requestId, info.symbolId, info.side, newPrice, shown));
+            return;
         }
 
-        if (order->RemainingQuantity() > 0)
+        auto & level = (info.side == Side::BUY ? bids[info.price] : asks[info.price]);
+        RemoveOrder(slot, level);
+
+        uint32_t shown = info.displayQuantity > 0 ? std::min(info.displayQuantity, newQuantity) : newQuantity;
+        output.OnMarketEvent(MarketDataEvent(EventType::ORDER_REPLACED, targetOrderId, requestId, info.symbolId, info.side, newPrice, shown));
+
+        Order order(targetOrderId, info.symbolId, info.side, OrderType::LIMIT, newQuantity, newPrice, info.sessionId, info.accountId, now);
+        order.displayQuantity = info.displayQuantity;
+        if (!inAuction)
+            MatchIncoming(&order, requestId, output);
+        if (order.RemainingQuantity() > 0)
         {
-            if (order->type == OrderType::LIMIT)
-                AddOrder(order, output);
+            if (halted)
+                output.OnMarketEvent(MarketDataEvent(targetOrderId, requestId));
             else
-                output.OnMarketEvent(MarketDataEvent(order->orderId, order->orderId));
+                InsertOrder(&order);
         }
+
+        if (stops.AnyTriggered(lastTradePrice))
+            RunStopCascade(output);
+    }
+
+    template<typename OutputPolicy>
+    void MatchOrder(Order* order, OutputPolicy & output)
+    {
+        if (inAuction)
+        {
+            AddOrder(order, output);
+            return;
+        }
+
+        // A stop waits in the stop book, unless the last trade already went through its price
+        if (order->type == OrderType::STOP || order->type == OrderType::STOP_LIMIT)
+        {
+            if (!stops.Triggers(*order, lastTradePrice))
+            {
+                stops.Add(*order);
+                output.OnMarketEvent(MarketDataEvent(EventType::STOP_ACCEPTED, order->orderId, order->orderId, order->symbolId, order->side, order->stopPrice, order->quantity));
+                return;
+            }
+            order->type = TriggeredType(order->type);
+        }
+
+        ExecuteNewOrder(order, output);
+
+        if (stops.AnyTriggered(lastTradePrice))
+            RunStopCascade(output);
     }
 
     std::pair<uint32_t, uint32_t> GetTopOfBook()
     {
-        while (bids[maxBid].head == nullptr && maxBid > 0) maxBid--;
-        while (asks[minAsk].head == nullptr && minAsk < NUM_PRICE_LEVELS) minAsk++;
+        while (bids[maxBid].head == NULL_SLOT && maxBid > 0) maxBid--;
+        while (asks[minAsk].head == NULL_SLOT && minAsk < NUM_PRICE_LEVELS) minAsk++;
         return { maxBid, minAsk };
     }
 
@@ -230,15 +878,15 @@ public:
         {
             int totalQty = 0;
             auto & level = asks[askIdx];
-            if (level.head == nullptr)
+            if (level.head == NULL_SLOT)
                 continue;
 
             i++;
-            auto order = level.head;
-            while (order != nullptr)
+            auto slot = level.head;
+            while (slot != NULL_SLOT)
             {
-                totalQty += order->RemainingQuantity();
-                order = order->next;
+                totalQty += nodes[slot].RemainingQuantity();
+                slot = nodes[slot].next;
             }
 
             std::cout << "  ASK: " << askIdx << " | " << totalQty << " shares\n";
@@ -252,15 +900,15 @@ public:
         {
             int totalQty = 0;
             auto & level = bids[bidIdx];
-            if (level.head == nullptr)
+            if (level.head == NULL_SLOT)
                 continue;
 
             i++;
-            auto order = level.head;
-            while (order != nullptr)
+            auto slot = level.head;
+            while (slot != NULL_SLOT)
             {
-                totalQty += order->RemainingQuantity();
-                order = order->next;
+                totalQty += nodes[slot].RemainingQuantity();
+                slot = nodes[slot].next;
             }
 
             std::cout << "  BID: " << bidIdx << " | " << totalQty << " shares\n";
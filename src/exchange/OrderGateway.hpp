@@ -2,33 +2,59 @@
 
 #include <memory>
 #include <vector>
-#include <random>
+#include <span>
+#include <string>
 #include <thread>
 #include <atomic>
 #include <iostream>
+#include <immintrin.h>
 
 #include "SPSCQueue.hpp"
 #include "Order.hpp"
+#include "RequestRecord.hpp"
+#include "RequestFile.hpp"
+#include "ScenarioGenerator.hpp"
 #include "Timer.hpp"
-#include "SymbolMap.hpp"
+#include "SymbolDirectory.hpp"
 #include "Threading.hpp"
 
+enum class ReplayMode
+{
+    FULL_SPEED, // send as fast as the queue accepts
+    FIXED_RATE, // evenly spaced at the configured rate
+    RECORDED    // at the recorded sendTimeNs, scaled by the configured speed
+};
+
 class OrderGateway
 {
 private:
     std::shared_ptr<SPSCQueue<OrderRequest>> queue;
-    std::vector<OrderRequest> requests;
-    std::vector<uint64_t> activeOrderIds;
+    std::vector<RequestRecord> generated;
+    std::unique_ptr<RequestFile> replayFile;
+    std::span<const RequestRecord> requests;
+
+    ReplayMode replayMode = ReplayMode::FULL_SPEED;
+    double replayRate = 0.0;
 
     std::thread thread;
     std::atomic<bool> running{ false };
+    int cpuId = CpuConfig{}.gatewayCpu;
 
 public:
     OrderGateway(std::shared_ptr<SPSCQueue<OrderRequest>> queue_, size_t numSymbols, size_t numRequests)
-        : queue(queue_)
+        : OrderGateway(queue_, ScenarioConfig::Preset(Scenario::UNIFORM, numRequests, numSymbols)) {}
+
+    OrderGateway(std::shared_ptr<SPSCQueue<OrderRequest>> queue_, const ScenarioConfig & config)
+        : queue(queue_), generated(GenerateScenario(config)), requests(generated)
+    {
+        requestTimes.resize(requests.size(), 0);
+    }
+
+    OrderGateway(std::shared_ptr<SPSCQueue<OrderRequest>> queue_, const std::string & replayPath)
+        : queue(queue_), replayFile(std::make_unique<RequestFile>(replayPath)), requests(replayFile->Records())
     {
-        GenerateRequests(numRequests, numSymbols);
-        requestTimes.resize(numRequests, 0);
+        std::cout << "Loaded " << requests.size() << " requests from " << replayPath << "\n";
+        requestTimes.resize(requests.size(), 0);
     }
 
     ~OrderGateway()
@@ -36,6 +62,11 @@ public:
         Stop();
     }
 
+    void SetCpu(int cpuId_)
+    {
+        cpuId = cpuId_;
+    }
+
     void Start()
     {
         running = true;
@@ -50,6 +81,25 @@ public:
         WaitUntilFinished();
     }
 
+    // Rate is in requests per second for FIXED_RATE and a speed multiplier for RECORDED.
+    void SetReplayMode(ReplayMode mode, double rate = 0.0)
+    {
+        if (mode != ReplayMode::FULL_SPEED && rate <= 0.0)
+            throw std::runtime_error{ "Replay rate must be positive" };
+        replayMode = mode;
+        replayRate = rate;
+    }
+
+    size_t NumRequests() const
+    {
+        return requests.size();
+    }
+
+    std::span<const RequestRecord> Requests() const
+    {
+        return requests;
+    }
+
     void WaitUntilFinished()
     {
         if (thread.joinable())
@@ -62,7 +112,7 @@ public:
 
         OrderRequest* slot = queue->GetWriteIndex();
         if (slot == nullptr) return false;
-        *slot = requests[index];
+        requests[index].Decode(*slot);
 
         requestTimes[index] = Timer::rdtsc();
         queue->UpdateWriteIndex();
@@ -70,96 +120,49 @@ public:
     }
 
 private:
-    void GenerateRequests(size_t numRequests, size_t numSymbols)
-    {
-        requests.reserve(numRequests);
-        activeOrderIds.reserve(numRequests / 2);
-
-        std::random_device rd;
-        std::mt19937 gen(42);
-        std::uniform_real_distribution<> type_dist(0, 1);
-        std::uniform_int_distribution<> price_dist(14900, 15100);
-        std::uniform_int_distribution<> qty_dist(100, 1000);
-        std::uniform_int_distribution<> side_dist(0, 1);
-        std::uniform_int_distribution<> symbol_dist(0, numSymbols - 1);
+    static constexpr uint64_t SCHEDULE_LEAD_NS = 1'000'000;
 
-        uint32_t mid_price = 15000;
+    // Intended send time of every request, computed before the first send so that the
+    // sending loop only compares against precomputed deadlines.
+    void BuildSchedule(uint64_t startCycles)
+    {
+        scheduledTimes.resize(requests.size());
 
-        for (size_t i = 0; i < numRequests; ++i)
+        if (replayMode == ReplayMode::FIXED_RATE)
         {
-            double p;
-            // Pre-fill order books so that they are not empty
-            if (i < numRequests / 10)
-                p = 1.0;
-            else
-                p = type_dist(gen);
-
-            OrderRequest req;
-
-            uint8_t symbol = symbol_dist(gen);
-
-            if (p < 0.10 && !activeOrderIds.empty())
-            {
-                // 10% Cancel orders
-
-                std::uniform_int_distribution<> cancel_dist(0, activeOrderIds.size() - 1);
-                size_t idx = cancel_dist(gen);
-                req.data = CancelRequest{ i, activeOrderIds[idx], Timer::rdtsc() };
-
-                activeOrderIds[idx] = activeOrderIds.back();
-                activeOrderIds.pop_back();
-            }
-            else if (p < 0.30)
-            {
-                // 20% Market orders
-                req.data = Order(i, symbol, side_dist(gen) == 0 ? Side::BUY : Side::SELL, OrderType::MARKET, qty_dist(gen), 0);
-            }
-            else if (p < 0.60)
-            {
-                // 30% Limit orders that match immediately
-
-                Side side = side_dist(gen) == 0 ? Side::BUY : Side::SELL;
-                uint32_t aggressive_price;
-
-                if (side == Side::BUY)
-                    aggressive_price = mid_price + 5 + type_dist(gen) * 10;
-                else
-                    aggressive_price = mid_price - 5 - type_dist(gen) * 10;
-
-                req.data = Order(i, symbol, side, OrderType::LIMIT, qty_dist(gen), aggressive_price);
-                activeOrderIds.push_back(i);
-            }
-            else
-            {
-                // 40% Limit orders that rest
-
-                Side side = side_dist(gen) == 0 ? Side::BUY : Side::SELL;
-                uint32_t resting_price;
-
-                if (side == Side::BUY)
-                    resting_price = mid_price - 5 - type_dist(gen) * 50;
-                else
-                    resting_price = mid_price + 5 + type_dist(gen) * 50;
-
-                req.data = Order(i, symbol, side, OrderType::LIMIT, qty_dist(gen), resting_price);
-                activeOrderIds.push_back(i);
-            }
-            requests.push_back(req);
+            double interval = Timer::ns_to_cycles(1'000'000'000) / replayRate;
+            for (size_t i = 0; i < requests.size(); i++)
+                scheduledTimes[i] = startCycles + static_cast<uint64_t>(i * interval);
+        }
+        else
+        {
+            for (size_t i = 0; i < requests.size(); i++)
+                scheduledTimes[i] = startCycles + Timer::ns_to_cycles(requests[i].sendTimeNs / replayRate);
         }
-
-        std::cout << "Generated " << requests.size() << " requests\n";
     }
 
     void Run()
     {
-        PinThread(5);
+        PinThread(cpuId);
         size_t sent = 0;
+        bool paced = replayMode != ReplayMode::FULL_SPEED;
+        if (paced)
+            BuildSchedule(Timer::rdtsc() + Timer::ns_to_cycles(SCHEDULE_LEAD_NS));
+
         auto start = std::chrono::steady_clock::now();
 
         for (int i = 0; i < requests.size(); i++)
         {
             if (!running) break;
-            
+
+            // Open loop: never wait for the engine, only for the schedule. If we fall behind,
+            // requests go out back to back and the delay is charged to them via scheduledTimes.
+            if (paced)
+            {
+                while (Timer::rdtsc() < scheduledTimes[i])
+                    _mm_pause();
+            }
+
             while (!SendRequest(i))
                 _mm_pause();
 
@@ -174,4 +177,5 @@ private:
 
 public:
     std::vector<uint64_t> requestTimes;
+    std::vector<uint64_t> scheduledTimes;
 };
\ No newline at end of file
@@ -0,0 +1,83 @@
+#pragma once
+#include "Order.hpp"
+#include "ObjectPool.hpp"
+#include "HugePageArena.hpp"
+#include "Memory.hpp"
+
+#include <span>
+
+static constexpr uint32_t NULL_SLOT = ObjectPool<uint32_t>::NULL_SLOT;
+
+// Resting order state the matching loop touches, 24 B. Linked by 32-bit pool slots.
+template<typename Quantity>
+struct OrderNode
+{
+    uint32_t next;
+    uint32_t prev;
+    Quantity quantity;
+    Quantity filledQuantity;
+    uint64_t orderId;
+
+    Quantity RemainingQuantity() const
+    {
+        return quantity - filledQuantity;
+    }
+
+    bool IsFilled() const
+    {
+        return filledQuantity >= quantity;
+    }
+};
+
+// Resting order state only needed to locate or report on it, stored at the same slot as its node.
+// Also links the order into the list of its session's live orders in its book. For icebergs the
+// node holds the shown slice and the reserve waits here until the slice is used up.
+struct OrderInfo
+{
+    uint64_t timestamp;
+    uint32_t price;
+    uint32_t displayQuantity;
+    uint32_t reserveQuantity;
+    uint32_t sessionNext;
+    uint32_t sessionPrev;
+    uint16_t sessionId;
+    uint16_t accountId;
+    SymbolId symbolId;
+    Side side;
+    OrderType type;
+};
+
+// Resting orders of every book with the same quantity width: the order id lookup, the node pool
+// and the infos at the same slots. Sized once for the engine's order capacity instead of once
+// per book, so a book itself only owns its ladders.
+template<typename Quantity>
+class OrderStore
+{
+private:
+    HugePageArena arena;
+
+public:
+    std::span<uint32_t> orders;
+    ObjectPool<OrderNode<Quantity>> nodes;
+    std::span<OrderInfo> infos;
+
+    explicit OrderStore(size_t numMaxOrders)
+        : arena(HugePageArena::BytesFor<uint32_t>(numMaxOrders) + ObjectPool<OrderNode<Quantity>>::BytesFor(numMaxOrders)
+                + ObjectPool<OrderInfo>::BytesFor(numMaxOrders)),
+          orders(arena.Allocate<uint32_t>(numMaxOrders), numMaxOrders),
+          nodes(numMaxOrders, arena),
+          infos(arena.Allocate<OrderInfo>(nodes.Slots()), nodes.Slots())
+    {
+        // Zero-filled arena memory already is null order slots
+    }
+
+    void Prefault(const WarmupOptions & options)
+    {
+        arena.Prefault(options);
+    }
+
+    size_t HugePageSize() const
+    {
+        return arena.HugePageSize();
+    }
+};
@@ -8,9 +8,15 @@
 #include "MarketDataEvent.hpp"
 #include "SPSCQueue.hpp"
 
+// Discard() drops events emitted so far. The engine uses it to throw away the output of its
+// warm-up orders, so QueueOutputPolicy may only be discarded before the consumer starts.
+// Policies may also provide BeginBatch()/EndBatch(), which the engine calls around a batch of
+// requests so that all of its events can be published at once.
+
 struct NoOpOutputPolicy
 {
     void OnMarketEvent(const MarketDataEvent && event) {}
+    void Discard() {}
 };
 
 struct VectorOutputPolicy
@@ -20,22 +26,74 @@ struct VectorOutputPolicy
     {
         events.emplace_back(event);
     }
+
+    void Discard()
+    {
+        events.clear();
+    }
 };
 
 struct QueueOutputPolicy
 {
     std::shared_ptr<SPSCQueue<MarketDataEvent>> queue;
 
+    // Events written but not yet published while inside a batch, batches may nest
+    size_t pending = 0;
+    uint32_t batchDepth = 0;
+
     QueueOutputPolicy(std::shared_ptr<SPSCQueue<MarketDataEvent>> queue_)
         : queue(queue_) {}
 
     void OnMarketEvent(const MarketDataEvent && event)
     {
+        if (batchDepth > 0)
+        {
+            MarketDataEvent* slot = nullptr;
+            while ((slot = queue->GetWriteIndex(pending)) == nullptr)
+            {
+                // Ring is full, publish what we have so the consumer can make room
+                if (pending > 0)
+                    queue->UpdateWriteIndex(pending);
+                pending = 0;
+                _mm_pause();
+            }
+            *slot = event;
+            pending++;
+            return;
+        }
+
         MarketDataEvent* slot = nullptr;
         while ((slot = queue->GetWriteIndex()) == nullptr)
             _mm_pause();
         *slot = event;
         queue->UpdateWriteIndex();
     }
+
+    // Events of a batch are written into the ring as they come, but the consumer only sees
+    // them once the batch ends: one index store and at most one wakeup per batch.
+    void BeginBatch()
+    {
+        batchDepth++;
+    }
+
+    void EndBatch()
+    {
+        if (--batchDepth > 0)
+            return;
+        if (pending > 0)
+            queue->UpdateWriteIndex(pending);
+        pending = 0;
+    }
+
+    void Discard()
+    {
+        while (queue->GetReadIndex() != nullptr)
+            queue->UpdateReadIndex();
+    }
+
+    void Prefault(const WarmupOptions & options)
+    {
+        queue->Prefault(options);
+    }
 };
 
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "Order.hpp"
+#include "MarketDataEvent.hpp"
+
+struct RiskLimits
+{
+    uint32_t maxOrderQuantity = std::numeric_limits<uint32_t>::max();
+    uint32_t maxOpenOrders = std::numeric_limits<uint32_t>::max();
+    uint64_t maxNotional = std::numeric_limits<uint64_t>::max();  // quantity * price in cents
+    int64_t maxPosition = std::numeric_limits<int64_t>::max();     // absolute net position
+};
+
+// Pre-trade checks run on the engine thread. Limits and state of one account on one symbol
+// share a single entry in a per-symbol array indexed by account, so a check is one cache line
+// and a handful of integer compares. A symbol's array is only created once it is traded or
+// given limits of its own, until then the account-wide limits stand for it. The book reports
+// fills and orders entering and leaving it.
+class RiskManager
+{
+private:
+    // Padded to a cache line of its own
+    struct alignas(64) Entry
+    {
+        RiskLimits limits;
+        int64_t position = 0;
+        uint32_t openOrders = 0;
+    };
+    static_assert(sizeof(Entry) == 64);
+
+    std::vector<std::unique_ptr<Entry[]>> tables;
+    std::vector<RiskLimits> accountLimits;
+    std::vector<uint32_t> lastPrices;
+
+    Entry & At(uint16_t accountId, SymbolId symbolId)
+    {
+        auto & table = tables[symbolId];
+        if (!table) [[unlikely]]
+            table = MakeTable();
+        return table[accountId];
+    }
+
+    const Entry* Find(uint16_t accountId, SymbolId symbolId) const
+    {
+        return tables[symbolId] ? &tables[symbolId][accountId] : nullptr;
+    }
+
+    std::unique_ptr<Entry[]> MakeTable() const
+    {
+        auto table = std::make_unique<Entry[]>(MAX_ACCOUNTS);
+        for (size_t account = 0; account < MAX_ACCOUNTS; account++)
+            table[account].limits = accountLimits[account];
+        return table;
+    }
+
+public:
+    RiskManager(size_t numSymbols) : tables(numSymbols), accountLimits(MAX_ACCOUNTS), lastPrices(numSymbols, 0) {}
+
+    // Clears positions, open order counts and last prices, keeps the limits
+    void Reset()
+    {
+        for (auto & table : tables)
+        {
+            if (!table)
+                continue;
+            for (size_t account = 0; account < MAX_ACCOUNTS; account++)
+            {
+                table[account].position = 0;
+                table[account].openOrders = 0;
+            }
+        }
+        std::fill(lastPrices.begin(), lastPrices.end(), 0);
+    }
+
+    void SetLimits(uint16_t accountId, SymbolId symbolId, const RiskLimits & limits)
+    {
+        At(accountId, symbolId).limits = limits;
+    }
+
+    // Limits of the account on every symbol, including ones not traded yet
+    void SetLimits(uint16_t accountId, const RiskLimits & limits)
+    {
+        accountLimits[accountId] = limits;
+        for (auto & table : tables)
+            if (table)
+                table[accountId].limits = limits;
+    }
+
+    // Checks the order as if it filled completely. Market orders are valued at the symbol's
+    // last traded price and rejected under a notional limit when there is none. Open orders of
+    // the account are not netted into the position check. Modifies pass isNewOrder = false, the
+    // order they change is already counted as open.
+    RejectionType Check(const Order & order, bool isNewOrder = true)
+    {
+        const auto & entry = At(order.accountId, order.symbolId);
+
+        if (order.quantity > entry.limits.maxOrderQuantity)
+            return RejectionType::ORDER_SIZE_LIMIT;
+
+        // A market order on a symbol that has not traded yet cannot be valued, so it only
+        // passes an account without a notional limit
+        uint32_t price = order.price > 0 ? order.price : lastPrices[order.symbolId];
+        bool notionalLimited = entry.limits.maxNotional != std::numeric_limits<uint64_t>::max();
+        if ((price == 0 && notionalLimited) || uint64_t(order.quantity) * price > entry.limits.maxNotional)
+            return RejectionType::NOTIONAL_LIMIT;
+
+        if (isNewOrder && entry.openOrders >= entry.limits.maxOpenOrders)
+            return RejectionType::OPEN_ORDER_LIMIT;
+
+        int64_t position = entry.position + (order.side == Side::BUY ? int64_t(order.quantity) : -int64_t(order.quantity));
+        if (std::llabs(position) > entry.limits.maxPosition)
+            return RejectionType::POSITION_LIMIT;
+
+        return RejectionType::NONE;
+    }
+
+    void OnFill(uint16_t accountId, SymbolId symbolId, Side side, uint32_t quantity)
+    {
+        auto & entry = At(accountId, symbolId);
+        entry.position += side == Side::BUY ? int64_t(quantity) : -int64_t(quantity);
+    }
+
+    void OnTrade(SymbolId symbolId, uint32_t price)
+    {
+        lastPrices[symbolId] = price;
+    }
+
+    void OnOrderRested(uint16_t accountId, SymbolId symbolId)
+    {
+        At(accountId, symbolId).openOrders++;
+    }
+
+    void OnOrderClosed(uint16_t accountId, SymbolId symbolId)
+    {
+        At(accountId, symbolId).openOrders--;
+    }
+
+    int64_t Position(uint16_t accountId, SymbolId symbolId) const
+    {
+        auto entry = Find(accountId, symbolId);
+        return entry ? entry->position : 0;
+    }
+
+    uint32_t OpenOrders(uint16_t accountId, SymbolId symbolId) const
+    {
+        auto entry = Find(accountId, symbolId);
+        return entry ? entry->openOrders : 0;
+    }
+};
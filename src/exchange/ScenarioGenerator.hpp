@@ -0,0 +1,221 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#include "RequestRecord.hpp"
+#include "SymbolDirectory.hpp"
+
+enum class Scenario
+{
+    UNIFORM,
+    ZIPF,
+    BURSTY,
+    MARKET_MAKER,
+    TRENDING
+};
+
+constexpr std::array<std::string_view, 5> SCENARIO_NAMES = {
+    "uniform", "zipf", "bursty", "market_maker", "trending"
+};
+
+constexpr std::string_view ScenarioName(Scenario scenario)
+{
+    return SCENARIO_NAMES[static_cast<size_t>(scenario)];
+}
+
+inline std::optional<Scenario> ParseScenario(std::string_view name)
+{
+    for (size_t i = 0; i < SCENARIO_NAMES.size(); i++)
+        if (SCENARIO_NAMES[i] == name)
+            return static_cast<Scenario>(i);
+    return std::nullopt;
+}
+
+struct ScenarioConfig
+{
+    size_t numRequests = 1'000'000;
+    size_t numSymbols = NUM_DEFAULT_SYMBOLS;
+    uint32_t seed = 42;
+
+    // Request mix. Whatever is left after cancels, market and aggressive limit orders are
+    // limit orders that rest. The first `prefillRatio` of requests only add resting orders.
+    double cancelRatio = 0.10;
+    double marketRatio = 0.20;
+    double aggressiveRatio = 0.30;
+    double prefillRatio = 0.10;
+
+    // Symbol popularity. 0 is uniform, otherwise symbol k is picked with weight 1 / k^s.
+    double zipfExponent = 0.0;
+
+    // Cancels target one of the N most recently added orders (market maker requoting).
+    // 0 means any live order.
+    size_t cancelRecentWindow = 0;
+
+    // Per-symbol mid price random walk, in ticks per request on that symbol.
+    uint32_t midPrice = 15000;
+    double trendDrift = 0.0;
+    double trendVolatility = 0.0;
+
+    // Arrival times stored in sendTimeNs. A rate of 0 leaves them at 0 (replay at full speed).
+    double arrivalRate = 0.0;
+    double burstProbability = 0.0;
+    size_t burstLength = 0;
+    double burstRateMultiplier = 1.0;
+
+    static ScenarioConfig Preset(Scenario scenario, size_t numRequests, size_t numSymbols)
+    {
+        ScenarioConfig config;
+        config.numRequests = numRequests;
+        config.numSymbols = numSymbols;
+
+        switch (scenario)
+        {
+        case Scenario::UNIFORM:
+            break;
+        case Scenario::ZIPF:
+            config.zipfExponent = 1.0;
+            break;
+        case Scenario::BURSTY:
+            config.zipfExponent = 1.0;
+            config.arrivalRate = 500'000;
+            config.burstProbability = 0.0005;
+            config.burstLength = 5'000;
+            config.burstRateMultiplier = 20.0;
+            break;
+        case Scenario::MARKET_MAKER:
+            config.zipfExponent = 1.0;
+            config.cancelRatio = 0.45;
+            config.marketRatio = 0.05;
+            config.aggressiveRatio = 0.10;
+            config.cancelRecentWindow = 64;
+            break;
+        case Scenario::TRENDING:
+            config.zipfExponent = 1.0;
+            config.trendDrift = 0.05;
+            config.trendVolatility = 2.0;
+            break;
+        }
+        return config;
+    }
+};
+
+inline std::vector<RequestRecord> GenerateScenario(const ScenarioConfig & config)
+{
+    std::vector<RequestRecord> records;
+    records.reserve(config.numRequests);
+
+    std::vector<uint64_t> activeOrderIds;
+    activeOrderIds.reserve(config.numRequests / 2);
+
+    std::mt19937 gen(config.seed);
+    std::uniform_real_distribution<> type_dist(0, 1);
+    std::uniform_int_distribution<> qty_dist(100, 1000);
+    std::uniform_int_distribution<> side_dist(0, 1);
+    std::uniform_int_distribution<> symbol_dist(0, config.numSymbols - 1);
+
+    std::vector<double> zipfWeights;
+    for (size_t k = 1; config.zipfExponent > 0 && k <= config.numSymbols; k++)
+        zipfWeights.push_back(1.0 / std::pow(k, config.zipfExponent));
+    std::discrete_distribution<> zipf_dist(zipfWeights.begin(), zipfWeights.end());
+
+    // Trend and arrival times use their own generators so that enabling them does not
+    // change the request sequence itself.
+    std::mt19937 trendGen(config.seed + 1);
+    std::normal_distribution<> trend_dist(config.trendDrift, config.trendVolatility);
+    std::mt19937 timeGen(config.seed + 2);
+    std::exponential_distribution<> gap_dist(1.0);
+
+    std::vector<double> midPrices(config.numSymbols, config.midPrice);
+    bool trending = config.trendDrift != 0.0 || config.trendVolatility != 0.0;
+
+    double sendTimeNs = 0;
+    size_t burstRemaining = 0;
+
+    const double marketBound = config.cancelRatio + config.marketRatio;
+    const double aggressiveBound = marketBound + config.aggressiveRatio;
+    const size_t prefillCount = config.numRequests * config.prefillRatio;
+
+    for (size_t i = 0; i < config.numRequests; ++i)
+    {
+        double p;
+        // Pre-fill order books so that they are not empty
+        if (i < prefillCount)
+            p = 1.0;
+        else
+            p = type_dist(gen);
+
+        SymbolId symbol = config.zipfExponent > 0 ? zipf_dist(gen) : symbol_dist(gen);
+
+        if (trending)
+            midPrices[symbol] = std::max(100.0, midPrices[symbol] + trend_dist(trendGen));
+        uint32_t mid_price = midPrices[symbol];
+
+        if (config.arrivalRate > 0)
+        {
+            if (burstRemaining == 0 && type_dist(timeGen) < config.burstProbability)
+                burstRemaining = config.burstLength;
+
+            double rate = config.arrivalRate;
+            if (burstRemaining > 0)
+            {
+                rate *= config.burstRateMultiplier;
+                burstRemaining--;
+            }
+            sendTimeNs += gap_dist(timeGen) * 1e9 / rate;
+        }
+
+        if (p < config.cancelRatio && !activeOrderIds.empty())
+        {
+            size_t lowest = 0;
+            if (config.cancelRecentWindow > 0 && activeOrderIds.size() > config.cancelRecentWindow)
+                lowest = activeOrderIds.size() - config.cancelRecentWindow;
+
+            std::uniform_int_distribution<> cancel_dist(lowest, activeOrderIds.size() - 1);
+            size_t idx = cancel_dist(gen);
+            records.push_back(RequestRecord::MakeCancel(sendTimeNs, i, activeOrderIds[idx]));
+
+            activeOrderIds[idx] = activeOrderIds.back();
+            activeOrderIds.pop_back();
+        }
+        else if (p < marketBound)
+        {
+            Side side = side_dist(gen) == 0 ? Side::BUY : Side::SELL;
+            records.push_back(RequestRecord::MakeOrder(sendTimeNs, i, symbol, side, OrderType::MARKET, qty_dist(gen), 0));
+        }
+        else if (p < aggressiveBound)
+        {
+            Side side = side_dist(gen) == 0 ? Side::BUY : Side::SELL;
+            uint32_t aggressive_price;
+
+            if (side == Side::BUY)
+                aggressive_price = mid_price + 5 + type_dist(gen) * 10;
+            else
+                aggressive_price = mid_price - 5 - type_dist(gen) * 10;
+
+            records.push_back(RequestRecord::MakeOrder(sendTimeNs, i, symbol, side, OrderType::LIMIT, qty_dist(gen), aggressive_price));
+            activeOrderIds.push_back(i);
+        }
+        else
+        {
+            Side side = side_dist(gen) == 0 ? Side::BUY : Side::SELL;
+            uint32_t resting_price;
+
+            if (side == Side::BUY)
+                resting_price = mid_price - 5 - type_dist(gen) * 50;
+            else
+                resting_price = mid_price + 5 + type_dist(gen) * 50;
+
+            records.push_back(RequestRecord::MakeOrder(sendTimeNs, i, symbol, side, OrderType::LIMIT, qty_dist(gen), resting_price));
+            activeOrderIds.push_back(i);
+        }
+    }
+
+    std::cout << "Generated " << records.size() << " requests\n";
+    return records;
+}
@@ -0,0 +1,308 @@
+#pragma once
+#include "Order.hpp"
+#include "ObjectPool.hpp"
+#include "HugePageArena.hpp"
+#include "PriceBitmap.hpp"
+#include "Memory.hpp"
+
+#include <optional>
+#include <span>
+#include <vector>
+
+// Pending stop: the order fields it runs with once triggered, and its links in the price level
+// and in its session's list. Plain data like the resting order nodes, as the pool keeps its free
+// list inside free nodes.
+struct StopNode
+{
+    uint64_t orderId;
+    uint64_t timestamp;
+    uint32_t quantity;
+    uint32_t price;
+    uint32_t stopPrice;
+    uint32_t displayQuantity;
+    uint32_t next;
+    uint32_t prev;
+    uint32_t sessionNext;
+    uint32_t sessionPrev;
+    uint16_t sessionId;
+    uint16_t accountId;
+    SymbolId symbolId;
+    Side side;
+    OrderType type;
+
+    static StopNode From(const Order & order, uint32_t prev, uint32_t sessionNext)
+    {
+        return { order.orderId, order.timestamp, order.quantity, order.price, order.stopPrice, order.displayQuantity,
+                 ObjectPool<StopNode>::NULL_SLOT, prev, sessionNext, ObjectPool<StopNode>::NULL_SLOT,
+                 order.sessionId, order.accountId, order.symbolId, order.side, order.type };
+    }
+
+    Order ToOrder() const
+    {
+        Order order;
+        order.orderId = orderId;
+        order.symbolId = symbolId;
+        order.side = side;
+        order.type = type;
+        order.sessionId = sessionId;
+        order.accountId = accountId;
+        order.quantity = quantity;
+        order.price = price;
+        order.timestamp = timestamp;
+        order.displayQuantity = displayQuantity;
+        order.stopPrice = stopPrice;
+        return order;
+    }
+};
+
+// Pending stops of every book: the order id lookup and the node pool, sized once for the
+// engine's order capacity
+class StopStore
+{
+private:
+    HugePageArena arena;
+
+public:
+    std::span<uint32_t> lookup;
+    ObjectPool<StopNode> nodes;
+
+    explicit StopStore(size_t numMaxOrders)
+        : arena(HugePageArena::BytesFor<uint32_t>(numMaxOrders) + ObjectPool<StopNode>::BytesFor(numMaxOrders)),
+          lookup(arena.Allocate<uint32_t>(numMaxOrders), numMaxOrders),
+          nodes(numMaxOrders, arena)
+    {
+    }
+
+    // Faults in the id lookup. The pool is left to fault on first use, it is sized for the
+    // worst case and stops are rare next to resting orders.
+    void Prefault(const WarmupOptions & options)
+    {
+        PrefaultRange(lookup.data(), lookup.size_bytes(), options);
+    }
+};
+
+// Pending stop and stop-limit orders of one book, kept off the matching ladders. Each side has a
+// FIFO list per stop price and a bitmap of the prices holding stops. The lowest buy stop and the
+// highest sell stop are cached, so checking a trade is two compares, and collecting what it
+// triggered costs O(triggered) plus a bit scan per price. Each session's stops are also linked in
+// a list of their own, so a mass cancel visits only the stops it cancels.
+class StopBook
+{
+private:
+    struct StopLevel
+    {
+        uint32_t head;
+        uint32_t tail;
+    };
+
+    static constexpr uint32_t NULL_SLOT = ObjectPool<StopNode>::NULL_SLOT;
+
+    uint32_t numLevels;
+
+    HugePageArena arena;
+    std::span<StopLevel> buyStops;
+    std::span<StopLevel> sellStops;
+    std::span<uint32_t> sessionHeads;
+    std::span<uint32_t> lookup;
+    ObjectPool<StopNode> & nodes;
+
+    PriceBitmap buyPrices;
+    PriceBitmap sellPrices;
+
+    uint32_t minBuyStop;
+    uint32_t maxSellStop = 0;
+
+    void Remove(uint32_t slot)
+    {
+        const auto & node = nodes[slot];
+        bool isBuy = node.side == Side::BUY;
+        auto & level = isBuy ? buyStops[node.stopPrice] : sellStops[node.stopPrice];
+
+        lookup[node.orderId] = NULL_SLOT;
+
+        if (node.sessionPrev != NULL_SLOT) nodes[node.sessionPrev].sessionNext = node.sessionNext;
+        else sessionHeads[node.sessionId] = node.sessionNext;
+
+        if (node.sessionNext != NULL_SLOT) nodes[node.sessionNext].sessionPrev = node.sessionPrev;
+
+        if (node.prev != NULL_SLOT) nodes[node.prev].next = node.next;
+        else level.head = node.next;
+
+        if (node.next != NULL_SLOT) nodes[node.next].prev = node.prev;
+        else level.tail = node.prev;
+
+        if (level.head == NULL_SLOT)
+        {
+            if (isBuy)
+            {
+                buyPrices.Clear(node.stopPrice);
+                if (node.stopPrice == minBuyStop)
+                {
+                    auto next = buyPrices.NextSet(node.stopPrice);
+                    minBuyStop = next == PriceBitmap::NONE ? numLevels : next;
+                }
+            }
+            else
+            {
+                sellPrices.Clear(node.stopPrice);
+                if (node.stopPrice == maxSellStop)
+                {
+                    auto prev = sellPrices.PrevSet(node.stopPrice);
+                    maxSellStop = prev == PriceBitmap::NONE ? 0 : prev;
+                }
+            }
+        }
+
+        nodes.Deallocate(slot);
+    }
+
+    void TakeLevel(StopLevel & level, std::vector<Order> & triggered)
+    {
+        while (level.head != NULL_SLOT)
+        {
+            auto slot = level.head;
+            triggered.push_back(nodes[slot].ToOrder());
+            Remove(slot);
+        }
+    }
+
+public:
+    StopBook(uint32_t numLevels_, StopStore & store)
+        : numLevels(numLevels_),
+          arena(2 * HugePageArena::BytesFor<StopLevel>(numLevels_) + HugePageArena::BytesFor<uint32_t>(MAX_SESSIONS)
+                + 2 * PriceBitmap::BytesFor(numLevels_), false),
+          buyStops(arena.Allocate<StopLevel>(numLevels_), numLevels_),
+          sellStops(arena.Allocate<StopLevel>(numLevels_), numLevels_),
+          sessionHeads(arena.Allocate<uint32_t>(MAX_SESSIONS), MAX_SESSIONS),
+          lookup(store.lookup),
+          nodes(store.nodes),
+          buyPrices(numLevels_, arena),
+          sellPrices(numLevels_, arena),
+          minBuyStop(numLevels_)
+    {
+    }
+
+    void Prefault(const WarmupOptions & options)
+    {
+        arena.Prefault(options);
+    }
+
+    void Add(const Order & order)
+    {
+        if (order.orderId >= lookup.size())
+            throw std::runtime_error{ "Order id exceeds capacity" };
+
+        uint32_t slot = nodes.Allocate();
+        if (slot == NULL_SLOT)
+            throw std::runtime_error{ "Stop pool exhausted" };
+
+        bool isBuy = order.side == Side::BUY;
+        auto & level = isBuy ? buyStops[order.stopPrice] : sellStops[order.stopPrice];
+
+        auto & sessionHead = sessionHeads[order.sessionId];
+        nodes[slot] = StopNode::From(order, level.tail, sessionHead);
+        if (sessionHead != NULL_SLOT)
+            nodes[sessionHead].sessionPrev = slot;
+        sessionHead = slot;
+
+        if (level.head == NULL_SLOT)
+        {
+            level.head = slot;
+            if (isBuy)
+            {
+                buyPrices.Set(order.stopPrice);
+                minBuyStop = std::min(minBuyStop, order.stopPrice);
+            }
+            else
+            {
+                sellPrices.Set(order.stopPrice);
+                maxSellStop = std::max(maxSellStop, order.stopPrice);
+            }
+        }
+        else
+        {
+            nodes[level.tail].next = slot;
+        }
+        level.tail = slot;
+        lookup[order.orderId] = slot;
+    }
+
+    // Returns the cancelled stop, nothing if the id is not a pending stop
+    std::optional<Order> Cancel(uint64_t orderId)
+    {
+        if (orderId >= lookup.size() || lookup[orderId] == NULL_SLOT)
+            return std::nullopt;
+
+        auto slot = lookup[orderId];
+        Order order = nodes[slot].ToOrder();
+        Remove(slot);
+        return order;
+    }
+
+    // A buy stop triggers on a trade at or above its stop price, a sell stop at or below
+    bool Triggers(const Order & stop, uint32_t lastTradePrice) const
+    {
+        return lastTradePrice > 0 && (stop.side == Side::BUY ? lastTradePrice >= stop.stopPrice : lastTradePrice <= stop.stopPrice);
+    }
+
+    bool AnyTriggered(uint32_t lastTradePrice) const
+    {
+        return lastTradePrice > 0 && (lastTradePrice >= minBuyStop || lastTradePrice <= maxSellStop);
+    }
+
+    // Appends the stops a trade at lastTradePrice triggered and removes them: buy stops from the
+    // lowest stop price up, then sell stops from the highest down, each price in arrival order
+    void CollectTriggered(uint32_t lastTradePrice, std::vector<Order> & triggered)
+    {
+        while (lastTradePrice >= minBuyStop)
+            TakeLevel(buyStops[minBuyStop], triggered);
+
+        while (maxSellStop > 0 && lastTradePrice <= maxSellStop)
+            TakeLevel(sellStops[maxSellStop], triggered);
+    }
+
+    bool Empty() const
+    {
+        return minBuyStop == numLevels && maxSellStop == 0;
+    }
+
+    // Cancels pending stops of one session (or all) on one side (or both) by walking only that
+    // session's list, calling onCancelled(stop) for each
+    template<typename OnCancelled>
+    void MassCancel(uint16_t sessionId, std::optional<Side> side, OnCancelled onCancelled)
+    {
+        if (Empty())
+            return;
+
+        auto cancelSession = [&](uint16_t session) {
+            auto slot = sessionHeads[session];
+            while (slot != NULL_SLOT)
+            {
+                // Removing frees the node, the callback gets a copy
+                const StopNode stop = nodes[slot];
+                if (!side || stop.side == *side)
+                {
+                    Remove(slot);
+                    onCancelled(stop);
+                }
+                slot = stop.sessionNext;
+            }
+        };
+
+        if (sessionId == MassCancelRequest::ALL_SESSIONS)
+        {
+            for (uint16_t session = 0; session < MAX_SESSIONS; session++)
+                if (sessionHeads[session] != NULL_SLOT)
+                    cancelSession(session);
+        }
+        else
+        {
+            cancelSession(sessionId);
+        }
+    }
+
+    void Reset()
+    {
+        MassCancel(MassCancelRequest::ALL_SESSIONS, std::nullopt, [](const StopNode &) {});
+    }
+};
@@ -1,45 +1,203 @@
+#include <chrono>
 #include <iostream>
 #include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include "MatchingEngine.hpp"
 #include "OrderGateway.hpp"
 #include "MarketDataPublisher.hpp"
+#include "IoUringTransmitter.hpp"
+#include "CpuTopology.hpp"
+#include "SymbolDirectory.hpp"
+#include "WaitStrategy.hpp"
+
+// Idle policy of the engine and publisher threads, chosen at build time (see WaitStrategy.hpp)
+#ifndef ENGINE_WAIT_STRATEGY
+#define ENGINE_WAIT_STRATEGY BusySpinWait
+#endif
+
+#ifndef PUBLISHER_WAIT_STRATEGY
+#define PUBLISHER_WAIT_STRATEGY BusySpinWait
+#endif
+
+// How the publisher sends market data: UDPTransmitter (sendmmsg) or IoUringTransmitter
+#ifndef PUBLISHER_TRANSMITTER
+#define PUBLISHER_TRANSMITTER UDPTransmitter
+#endif
+
+using Engine = MatchingEngine<QueueOutputPolicy, ENGINE_WAIT_STRATEGY>;
+using Transmitter = PUBLISHER_TRANSMITTER;
+using Publisher = MarketDataPublisher<Transmitter, PUBLISHER_WAIT_STRATEGY>;
+
+void PrintUsage(const char* program)
+{
+    std::cout << "Usage: " << program << " <num_orders> [<num_symbols> (default: all symbols)] [<queue_size> (default 1000)] [options]\n"
+              << "       " << program << " --replay <file> [<num_symbols>] [<queue_size>] [options]\n"
+              << "Options:\n"
+              << "  --scenario <name>  generated workload: uniform (default), zipf, bursty, market_maker, trending\n"
+              << "  --replay <file>    replay a request file written by scenariogen\n"
+              << "  --rate <n>         send at a fixed rate of n requests per second\n"
+              << "  --speed <x>        send at the recorded request times, x times faster\n"
+              << "  --symbols <file>   symbol directory, lines of \"<symbol> [equity|future|penny]\" (default: " << NUM_DEFAULT_SYMBOLS << " built-in equities)\n"
+              << "  --cpus <g>,<e>,<p> CPUs for gateway, engine and publisher threads, -1 to not pin (default 5,3,6)\n"
+              << "  --auto-cpus        pick CPUs on one NUMA node from the topology, avoiding SMT siblings\n"
+              << "  --warmup           prefault pools and rings and run synthetic orders before trading\n"
+              << "  --mlock            with --warmup, also lock pools and rings in memory\n"
+              << "  --capture <file>   record the market data sent to a pcap file, for feedreplay\n"
+              << "  --capture-cpu <n>  CPU for the capture writer thread (default: not pinned)\n"
+              << "  --feed-a <g>:<p>   multicast group and port of the market data feed (default " << FeedAddress{}.ToString() << ")\n"
+              << "  --feed-b <g>:<p>   also publish the feed to a second group for A/B arbitration (e.g. " << FeedAddress::DefaultB().ToString() << ")\n";
+}
 
 int main(int argc, char **argv)
 {
     const size_t DEFAULT_QUEUE_SIZE = 1000;
 
-    int numOrders;
-    int numSymbols = MAX_NUM_SYMBOLS;
+    int numOrders = 0;
+    int numSymbols = 0;
     int queueSize = DEFAULT_QUEUE_SIZE;
 
-    if (argc < 2)
+    Scenario scenario = Scenario::UNIFORM;
+    std::string replayPath;
+    std::string symbolConfigPath;
+    std::string capturePath;
+    int captureCpu = -1;
+    FeedAddress feedA;
+    std::optional<FeedAddress> feedB;
+    ReplayMode replayMode = ReplayMode::FULL_SPEED;
+    double replayRate = 0.0;
+
+    CpuConfig cpus;
+    bool autoCpus = false;
+    bool warmup = false;
+    WarmupOptions warmupOptions;
+
+    std::vector<const char*> positional;
+    for (int i = 1; i < argc; i++)
     {
-        std::cout << "Usage: " << argv[0] << " <num_orders> [<num_symbols> (default " << MAX_NUM_SYMBOLS << ")] [<queue_size> (default " << DEFAULT_QUEUE_SIZE << ")]\n";
-        return 1;
-    }
+        std::string_view arg = argv[i];
+        if (!arg.starts_with("--"))
+        {
+            positional.push_back(argv[i]);
+            continue;
+        }
+
+        if (arg == "--auto-cpus")
+        {
+            autoCpus = true;
+            continue;
+        }
+
+        if (arg == "--warmup" || arg == "--mlock")
+        {
+            warmup = true;
+            warmupOptions.lockMemory |= arg == "--mlock";
+            continue;
+        }
 
-    numOrders = atoi(argv[1]);
+        if (i + 1 >= argc)
+        {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+        const char* value = argv[++i];
+
+        if (arg == "--scenario")
+        {
+            auto parsed = ParseScenario(value);
+            if (!parsed)
+            {
+                std::cout << "Unknown scenario: " << value << "\n";
+                return 1;
+            }
+            scenario = *parsed;
+        }
+        else if (arg == "--replay")
+        {
+            replayPath = value;
+        }
+        else if (arg == "--symbols")
+        {
+            symbolConfigPath = value;
+        }
+        else if (arg == "--capture")
+        {
+            capturePath = value;
+        }
+        else if (arg == "--capture-cpu")
+        {
+            captureCpu = atoi(value);
+        }
+        else if (arg == "--feed-a" || arg == "--feed-b")
+        {
+            auto parsed = FeedAddress::Parse(value);
+            if (!parsed)
+            {
+                std::cout << arg << " expects <multicast group>:<port>\n";
+                return 1;
+            }
+            (arg == "--feed-a" ? feedA : feedB.emplace()) = *parsed;
+        }
+        else if (arg == "--rate" || arg == "--speed")
+        {
+            replayMode = arg == "--rate" ? ReplayMode::FIXED_RATE : ReplayMode::RECORDED;
+            replayRate = atof(value);
+            if (replayRate <= 0.0)
+            {
+                std::cout << arg << " must be greater than 0\n";
+                return 1;
+            }
+        }
+        else if (arg == "--cpus")
+        {
+            if (sscanf(value, "%d,%d,%d", &cpus.gatewayCpu, &cpus.engineCpu, &cpus.publisherCpu) != 3)
+            {
+                std::cout << "--cpus expects <gateway>,<engine>,<publisher>\n";
+                return 1;
+            }
+        }
+        else
+        {
+            std::cout << "Unknown option: " << arg << "\n";
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
 
-    if (numOrders <= 0)
+    size_t argIdx = 0;
+    if (replayPath.empty())
     {
-        std::cout << "num_orders must be greater than 0\n";
-        return 1;
+        if (positional.empty())
+        {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+
+        numOrders = atoi(positional[argIdx++]);
+
+        if (numOrders <= 0)
+        {
+            std::cout << "num_orders must be greater than 0\n";
+            return 1;
+        }
     }
 
-    if (argc >= 3)
+    if (positional.size() > argIdx)
     {
-        numSymbols = atoi(argv[2]);
-        if (numSymbols <= 0 || numSymbols > MAX_NUM_SYMBOLS)
+        numSymbols = atoi(positional[argIdx++]);
+        if (numSymbols <= 0)
         {
-            std::cout << "num_symbols must be between 1 and " << MAX_NUM_SYMBOLS << "\n";
+            std::cout << "num_symbols must be greater than 0\n";
             return 1;
         }
     }
 
-    if (argc >= 4)
+    if (positional.size() > argIdx)
     {
-        queueSize = atoi(argv[3]);
+        queueSize = atoi(positional[argIdx++]);
         if (queueSize <= 1)
         {
             std::cout << "queue_size must be greater than 1\n";
@@ -47,14 +205,101 @@ int main(int argc, char **argv)
         }
     }
 
-    auto inputQueue = std::make_shared<SPSCQueue<OrderRequest>>(queueSize);
-    auto outputQueue = std::make_shared<SPSCQueue<MarketDataEvent>>(queueSize);
+    // Books are only created for symbols that get orders, so a large directory costs little
+    SymbolDirectory symbols = symbolConfigPath.empty() ? SymbolDirectory::Default() : SymbolDirectory::Load(symbolConfigPath);
+    if (numSymbols == 0)
+        numSymbols = symbols.Size();
+    if (numSymbols > int(symbols.Size()))
+    {
+        std::cout << "num_symbols must be at most " << symbols.Size() << ", the size of the symbol directory\n";
+        return 1;
+    }
+
+    CpuTopology topology = CpuTopology::Detect();
+    if (autoCpus)
+    {
+        auto picked = topology.PickCpus(3, true);
+        cpus = { picked[0], picked[1], picked[2] };
+    }
+
+    std::cout << "TSC: " << Timer::tsc_hz() / 1e6 << " MHz (" << Timer::calibration_source() << ")\n";
+    if (!Timer::invariant_tsc())
+        std::cout << "Warning: TSC is not invariant, latencies in cycles may not convert to time\n";
+
+    std::cout << "CPUs: gateway " << cpus.gatewayCpu << " (node " << topology.NodeOf(cpus.gatewayCpu) << ")"
+              << ", engine " << cpus.engineCpu << " (node " << topology.NodeOf(cpus.engineCpu) << ")"
+              << ", publisher " << cpus.publisherCpu << " (node " << topology.NodeOf(cpus.publisherCpu) << ")\n";
+    if (topology.AreSiblings(cpus.engineCpu, cpus.gatewayCpu) || topology.AreSiblings(cpus.engineCpu, cpus.publisherCpu))
+        std::cout << "Warning: matching engine shares a physical core with another pipeline thread\n";
+
+    std::cout << "Market data feed: A " << feedA.ToString();
+    if (feedB)
+        std::cout << ", B " << feedB->ToString();
+    std::cout << "\n";
+
+    // Each component is constructed while running on the CPU of the thread that will use it,
+    // so that first touch places its rings and pools on that CPU's NUMA node.
+    std::shared_ptr<SPSCQueue<OrderRequest>> inputQueue;
+    std::shared_ptr<SPSCQueue<MarketDataEvent>> outputQueue;
+    std::unique_ptr<OrderGateway> gatewayPtr;
+    std::unique_ptr<QueueOutputPolicy> output;
+    std::unique_ptr<Engine> enginePtr;
+    std::unique_ptr<FeedCapture> capture;
+    std::unique_ptr<Transmitter> transmitterA;
+    std::unique_ptr<Transmitter> transmitterB;
+    std::unique_ptr<Publisher> publisherPtr;
 
-    OrderGateway gateway(inputQueue, numSymbols, numOrders);
-    QueueOutputPolicy output(outputQueue);
-    MatchingEngine<QueueOutputPolicy> engine(inputQueue, output, numSymbols, numOrders);
-    UDPTransmitter transmitter;
-    MarketDataPublisher publisher(outputQueue, transmitter, numOrders);
+    {
+        ScopedAffinity affinity(cpus.engineCpu);
+        inputQueue = std::make_shared<SPSCQueue<OrderRequest>>(queueSize);
+    }
+    {
+        ScopedAffinity affinity(cpus.publisherCpu);
+        outputQueue = std::make_shared<SPSCQueue<MarketDataEvent>>(queueSize);
+    }
+    {
+        ScopedAffinity affinity(cpus.gatewayCpu);
+        gatewayPtr = replayPath.empty()
+            ? std::make_unique<OrderGateway>(inputQueue, ScenarioConfig::Preset(scenario, numOrders, numSymbols))
+            : std::make_unique<OrderGateway>(inputQueue, replayPath);
+        gatewayPtr->SetReplayMode(replayMode, replayRate);
+        gatewayPtr->SetCpu(cpus.gatewayCpu);
+        numOrders = gatewayPtr->NumRequests();
+    }
+    {
+        ScopedAffinity affinity(cpus.engineCpu);
+        output = std::make_unique<QueueOutputPolicy>(outputQueue);
+        enginePtr = std::make_unique<Engine>(inputQueue, *output, symbols, numOrders);
+        enginePtr->SetCpu(cpus.engineCpu);
+    }
+    // Created outside the publisher's affinity, so that the writer thread does not inherit it
+    if (!capturePath.empty())
+        capture = std::make_unique<FeedCapture>(capturePath, feedA, captureCpu);
+    {
+        ScopedAffinity affinity(cpus.publisherCpu);
+        transmitterA = std::make_unique<Transmitter>(feedA);
+        if (feedB)
+            transmitterB = std::make_unique<Transmitter>(*feedB);
+        transmitterA->SetMirror(transmitterB.get());
+        transmitterA->SetCapture(capture.get());
+        publisherPtr = std::make_unique<Publisher>(outputQueue, *transmitterA, numOrders, symbols);
+        publisherPtr->SetCpu(cpus.publisherCpu);
+    }
+
+    OrderGateway & gateway = *gatewayPtr;
+    Engine & engine = *enginePtr;
+    Publisher & publisher = *publisherPtr;
+
+    if (warmup)
+    {
+        ScopedAffinity affinity(cpus.engineCpu);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < numSymbols; i++)
+            engine.GetBook(i);
+        engine.WarmUp(warmupOptions);
+        auto durationMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Engine warm-up took " << durationMs << " ms\n";
+    }
 
     publisher.Start();
     engine.Start();
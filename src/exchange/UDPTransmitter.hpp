@@ -2,15 +2,38 @@
 
 #include <iostream>
 #include <cstring>
+#include <span>
+#include <vector>
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 
+#include "FeedAddress.hpp"
+#include "FeedCapture.hpp"
+#include "ItchEncoder.hpp"
 #include "ItchMessage.hpp"
 #include "Timer.hpp"
 
+// UDP socket sending to a market data multicast group on the loopback interface
+inline int OpenMulticastSocket(const FeedAddress & address, sockaddr_in & group)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock == -1)
+    {
+        perror("socket");
+        throw std::runtime_error{ "Failed to create socket" };
+    }
+
+    group = address.SocketAddress();
+
+    in_addr localIface = {};
+    localIface.s_addr = inet_addr("127.0.0.1");
+    setsockopt(sock, IPPROTO_IP, IP_MULTICAST_IF, &localIface, sizeof(localIface));
+    return sock;
+}
+
 class UDPTransmitter
 {
 private:
@@ -18,12 +41,26 @@ private:
     sockaddr_in groupSock;
 
     uint64_t nextSequenceNumber = 1;
+    FeedCapture* capture = nullptr;
+    UDPTransmitter* mirror = nullptr;
+
+    // Events encoded per sendmmsg call and the buffers they are encoded into
+    static constexpr size_t MAX_BATCH_EVENTS = 64;
+    std::vector<char> packetBuffer = std::vector<char>(ItchEncoder::BufferSize(MAX_BATCH_EVENTS));
+    std::vector<uint16_t> lengths = std::vector<uint16_t>(MAX_BATCH_EVENTS * ItchEncoder::MAX_MESSAGES_PER_EVENT);
+    std::vector<iovec> iovecs = std::vector<iovec>(lengths.size());
+    std::vector<mmsghdr> headers = std::vector<mmsghdr>(lengths.size());
 
     template<typename MsgType>
     void SendMsg(const MsgType & msg)
     {
         const char* buf = reinterpret_cast<const char*>(&msg);
         size_t bytesToSend = sizeof(msg);
+        if (capture)
+        {
+            uint16_t length = sizeof(msg);
+            capture->Write(buf, &length, 1);
+        }
         size_t sent = 0;
         while (sent < bytesToSend)
         {
@@ -35,6 +72,41 @@ private:
             }
             sent += res;
         }
+        if (mirror)
+        {
+            uint16_t length = sizeof(msg);
+            mirror->SendEncoded(buf, &length, 1);
+        }
+    }
+
+    // One datagram per message, with a sendmmsg call per `headers.size()` messages
+    void SendDatagrams(const char* data, const uint16_t* sizes, size_t count)
+    {
+        for (size_t start = 0; start < count; start += headers.size())
+        {
+            size_t chunk = std::min(headers.size(), count - start);
+            for (size_t i = 0; i < chunk; i++)
+            {
+                iovecs[i] = { const_cast<char*>(data), sizes[start + i] };
+                headers[i] = {};
+                headers[i].msg_hdr.msg_name = &groupSock;
+                headers[i].msg_hdr.msg_namelen = sizeof(groupSock);
+                headers[i].msg_hdr.msg_iov = &iovecs[i];
+                headers[i].msg_hdr.msg_iovlen = 1;
+                data += sizes[start + i];
+            }
+
+            for (size_t sent = 0; sent < chunk;)
+            {
+                int res = sendmmsg(sock, headers.data() + sent, chunk - sent, 0);
+                if (res == -1)
+                {
+                    perror("sendmmsg");
+                    return;
+                }
+                sent += res;
+            }
+        }
     }
 
     void MakeHeader(ItchHeader* header, char msgType, uint64_t timestamp)
@@ -45,23 +117,19 @@ private:
     }
 
 public:
-    UDPTransmitter()
-    {
-        sock = socket(AF_INET, SOCK_DGRAM, 0);
-        if (sock == -1)
-        {
-            perror("socket");
-            throw std::runtime_error{ "Failed to create socket" };
-        }
+    explicit UDPTransmitter(const FeedAddress & address = {}) : sock(OpenMulticastSocket(address, groupSock)) {}
 
-        groupSock.sin_family = AF_INET;
-        groupSock.sin_addr.s_addr = inet_addr("239.0.0.1");
-        groupSock.sin_port = htons(12345);
-        memset(groupSock.sin_zero, 0, sizeof(groupSock.sin_zero));
+    // Also records everything sent to `capture`, nullptr to stop
+    void SetCapture(FeedCapture* capture_)
+    {
+        capture = capture_;
+    }
 
-        in_addr localIface = {};
-        localIface.s_addr = inet_addr("127.0.0.1");
-        setsockopt(sock, IPPROTO_IP, IP_MULTICAST_IF, &localIface, sizeof(localIface));
+    // Also sends every message as encoded for this feed on `mirror`, the redundant B feed, so
+    // both feeds carry the same sequence numbers. nullptr to stop.
+    void SetMirror(UDPTransmitter* mirror_)
+    {
+        mirror = mirror_;
     }
 
     ~UDPTransmitter()
@@ -78,7 +146,7 @@ public:
         msg.side = side;
         msg.quantity = htobe32(quantity);
         memset(msg.symbol, 0, sizeof(msg.symbol));
-        memcpy(msg.symbol, symbol.data(), std::min(symbol.length(), size_t(4)));
+        memcpy(msg.symbol, symbol.data(), std::min(symbol.length(), sizeof(msg.symbol)));
         msg.price = htobe32(price);
         SendMsg(msg);
     }
@@ -101,6 +169,16 @@ public:
         SendMsg(msg);
     }
 
+    void SendOrderReplaced(uint64_t orderId, uint32_t quantity, uint32_t price, uint64_t timestamp)
+    {
+        OrderReplaceMsg msg;
+        MakeHeader(&msg.header, 'U', timestamp);
+        msg.orderId = htobe64(orderId);
+        msg.quantity = htobe32(quantity);
+        msg.price = htobe32(price);
+        SendMsg(msg);
+    }
+
     void SendTradeMessage(std::string_view symbol, uint8_t side, uint32_t price, uint32_t quantity, uint64_t matchNumber, uint64_t timestamp)
     {
         TradeMsg msg;
@@ -108,12 +186,47 @@ public:
         msg.side = side;
         msg.quantity = htobe32(quantity);
         memset(msg.symbol, 0, sizeof(msg.symbol));
-        memcpy(msg.symbol, symbol.data(), std::min(symbol.length(), size_t(4)));
+        memcpy(msg.symbol, symbol.data(), std::min(symbol.length(), sizeof(msg.symbol)));
         msg.price = htobe32(price);
         msg.matchId = htobe64(matchNumber);
         SendMsg(msg);
     }
 
+    void SendTradingAction(std::string_view symbol, char tradingState, uint64_t timestamp)
+    {
+        TradingActionMsg msg;
+        MakeHeader(&msg.header, 'H', timestamp);
+        memset(msg.symbol, 0, sizeof(msg.symbol));
+        memcpy(msg.symbol, symbol.data(), std::min(symbol.length(), sizeof(msg.symbol)));
+        msg.tradingState = tradingState;
+        SendMsg(msg);
+    }
+
+    // Encodes the messages of a batch of events into one buffer and sends them, one datagram
+    // per message, with a single sendmmsg call per MAX_BATCH_EVENTS events
+    void SendBatch(std::span<const MarketDataEvent> events, const ItchEncoder & encoder)
+    {
+        for (size_t start = 0; start < events.size(); start += MAX_BATCH_EVENTS)
+        {
+            auto chunk = events.subspan(start, std::min(MAX_BATCH_EVENTS, events.size() - start));
+            size_t count = encoder.Encode(chunk, nextSequenceNumber, packetBuffer.data(), lengths.data());
+            if (capture)
+                capture->Write(packetBuffer.data(), lengths.data(), count);
+            SendDatagrams(packetBuffer.data(), lengths.data(), count);
+            if (mirror)
+                mirror->SendEncoded(packetBuffer.data(), lengths.data(), count);
+        }
+    }
+
+    // Sends `count` messages encoded elsewhere, laid out back to back in `data`
+    void SendEncoded(const char* data, const uint16_t* sizes, size_t count)
+    {
+        nextSequenceNumber += count;
+        if (capture)
+            capture->Write(data, sizes, count);
+        SendDatagrams(data, sizes, count);
+    }
+
     void SendEndMarketHours()
     {
         EndMarketMsg msg;
@@ -128,6 +241,8 @@ public:
     void SendOrderAdd(uint64_t orderId, std::string_view symbol, uint8_t side, uint32_t price, uint32_t quantity, uint64_t timestamp) {}
     void SendOrderExecuted(uint64_t orderId, uint32_t quantity, uint64_t matchNumber, uint64_t timestamp) {}
     void SendOrderDeleted(uint64_t orderId, uint64_t timestamp) {}
+    void SendOrderReplaced(uint64_t orderId, uint32_t quantity, uint32_t price, uint64_t timestamp) {}
     void SendTradeMessage(std::string_view symbol, uint8_t side, uint32_t price, uint32_t quantity, uint64_t matchNumber, uint64_t timestamp) {}
+    void SendTradingAction(std::string_view symbol, char tradingState, uint64_t timestamp) {}
     void SendEndMarketHours() {}
 };
\ No newline at end of file
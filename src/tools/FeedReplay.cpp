@@ -0,0 +1,174 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "FeedDecoder.hpp"
+#include "PcapFile.hpp"
+#include "UDPTransmitter.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+void PrintUsage(const char* program)
+{
+    std::cout << "Usage: " << program << " <capture file> [options]\n"
+              << "Options:\n"
+              << "  --speed <x>      replay x times faster than recorded (default 1, the original pacing)\n"
+              << "  --flat           replay as fast as possible\n"
+              << "  --decode         decode in process with the feed handler's decoder instead of sending\n"
+              << "                   to the market data multicast group on loopback\n"
+              << "  --feed <g>:<p>   multicast group and port to send to (default " << FeedAddress{}.ToString() << ")\n";
+}
+
+// Sends datagrams to the market data group, those that are due together with one sendmmsg
+class MulticastSender
+{
+private:
+    static constexpr size_t MAX_BATCH = 64;
+
+    sockaddr_in group;
+    int sock;
+    std::vector<iovec> iovecs = std::vector<iovec>(MAX_BATCH);
+    std::vector<mmsghdr> headers = std::vector<mmsghdr>(MAX_BATCH);
+    size_t count = 0;
+
+public:
+    explicit MulticastSender(const FeedAddress & address) : sock(OpenMulticastSocket(address, group)) {}
+
+    ~MulticastSender()
+    {
+        close(sock);
+    }
+
+    void Add(std::span<const char> payload)
+    {
+        iovecs[count] = { const_cast<char*>(payload.data()), payload.size() };
+        headers[count] = {};
+        headers[count].msg_hdr.msg_name = &group;
+        headers[count].msg_hdr.msg_namelen = sizeof(group);
+        headers[count].msg_hdr.msg_iov = &iovecs[count];
+        headers[count].msg_hdr.msg_iovlen = 1;
+        if (++count == MAX_BATCH)
+            Flush();
+    }
+
+    void Flush()
+    {
+        for (size_t sent = 0; sent < count;)
+        {
+            int res = sendmmsg(sock, headers.data() + sent, count - sent, 0);
+            if (res == -1)
+            {
+                perror("sendmmsg");
+                break;
+            }
+            sent += res;
+        }
+        count = 0;
+    }
+};
+
+// Replays every packet of the capture to `consume`. Packets are paced by their capture
+// timestamps divided by `speed`, or not paced at all when `speed` is 0. `flush` is called
+// before waiting for the next packet to become due.
+template<typename Consume, typename Flush>
+size_t Replay(PcapReader & reader, double speed, Consume consume, Flush flush)
+{
+    PcapReader::Packet packet;
+    size_t numPackets = 0;
+    uint64_t firstTimestampNs = 0;
+    auto start = Clock::now();
+
+    while (reader.Next(packet))
+    {
+        if (numPackets++ == 0)
+            firstTimestampNs = packet.timestampNs;
+
+        if (speed > 0)
+        {
+            auto due = start + std::chrono::nanoseconds(static_cast<int64_t>((packet.timestampNs - firstTimestampNs) / speed));
+            if (Clock::now() < due)
+            {
+                flush();
+                while (Clock::now() < due);
+            }
+        }
+        consume(packet.payload);
+    }
+    flush();
+    return numPackets;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    std::string path = argv[1];
+    double speed = 1.0;
+    bool decode = false;
+    FeedAddress feed;
+    for (int i = 2; i < argc; i++)
+    {
+        std::string_view arg = argv[i];
+        if (arg == "--speed" && i + 1 < argc)
+        {
+            speed = atof(argv[++i]);
+            if (speed <= 0)
+            {
+                std::cout << "speed must be greater than 0\n";
+                return 1;
+            }
+        }
+        else if (arg == "--flat")
+            speed = 0;
+        else if (arg == "--decode")
+            decode = true;
+        else if (arg == "--feed" && i + 1 < argc)
+        {
+            auto parsed = FeedAddress::Parse(argv[++i]);
+            if (!parsed)
+            {
+                std::cout << "--feed expects <multicast group>:<port>\n";
+                return 1;
+            }
+            feed = *parsed;
+        }
+        else
+        {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    PcapReader reader(path);
+    auto start = Clock::now();
+    size_t numPackets;
+
+    FeedStats stats;
+    FeedDecoder decoder(stats);
+    if (decode)
+    {
+        numPackets = Replay(reader, speed, [&](std::span<const char> payload) { decoder.Decode(payload.data(), payload.size()); }, [] {});
+    }
+    else
+    {
+        MulticastSender sender(feed);
+        numPackets = Replay(reader, speed, [&](std::span<const char> payload) { sender.Add(payload); }, [&] { sender.Flush(); });
+    }
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::cout << "Replayed " << numPackets << " messages in " << seconds * 1e3 << " ms (" << numPackets / seconds << " messages/s)\n";
+    if (decode)
+    {
+        std::cout << "Adds: " << stats.orderAdds << " Executions: " << stats.orderExecutions << " Deletes: " << stats.orderDeletes
+                  << " Replaces: " << stats.orderReplaces << " Trades: " << stats.trades << " (volume " << stats.volume << ")"
+                  << " Trading actions: " << stats.tradingActions << "\n";
+        std::cout << "Messages processed: " << decoder.MessagesProcessed() << " Messages dropped: " << decoder.MessagesDropped() << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,53 @@
+#include <iostream>
+#include <string>
+
+#include "ScenarioGenerator.hpp"
+#include "RequestFile.hpp"
+
+int main(int argc, char **argv)
+{
+    if (argc < 4)
+    {
+        std::cout << "Usage: " << argv[0] << " <scenario> <num_requests> <output_file> [<num_symbols> (default " << NUM_DEFAULT_SYMBOLS << ")] [<seed> (default 42)]\n";
+        std::cout << "Scenarios:";
+        for (auto name : SCENARIO_NAMES)
+            std::cout << " " << name;
+        std::cout << "\n";
+        return 1;
+    }
+
+    auto scenario = ParseScenario(argv[1]);
+    if (!scenario)
+    {
+        std::cout << "Unknown scenario: " << argv[1] << "\n";
+        return 1;
+    }
+
+    int numRequests = atoi(argv[2]);
+    if (numRequests <= 0)
+    {
+        std::cout << "num_requests must be greater than 0\n";
+        return 1;
+    }
+
+    int numSymbols = NUM_DEFAULT_SYMBOLS;
+    if (argc >= 5)
+    {
+        numSymbols = atoi(argv[4]);
+        if (numSymbols <= 0 || numSymbols > int(MAX_NUM_SYMBOLS))
+        {
+            std::cout << "num_symbols must be between 1 and " << MAX_NUM_SYMBOLS << "\n";
+            return 1;
+        }
+    }
+
+    ScenarioConfig config = ScenarioConfig::Preset(*scenario, numRequests, numSymbols);
+    if (argc >= 6)
+        config.seed = atoi(argv[5]);
+
+    auto records = GenerateScenario(config);
+    WriteRequestFile(argv[3], records);
+
+    std::cout << "Wrote " << records.size() << " " << ScenarioName(*scenario) << " requests to " << argv[3] << "\n";
+    return 0;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+// Multicast group and port of one market data feed. The exchange can publish the same feed to
+// two groups, A and B, for clients to arbitrate between.
+struct FeedAddress
+{
+    std::string group = "239.0.0.1";
+    uint16_t port = 12345;
+
+    static FeedAddress DefaultB()
+    {
+        return { "239.0.0.2", 12346 };
+    }
+
+    // "<group>:<port>"
+    static std::optional<FeedAddress> Parse(std::string_view text)
+    {
+        auto colon = text.rfind(':');
+        if (colon == std::string_view::npos)
+            return std::nullopt;
+
+        FeedAddress address{ std::string(text.substr(0, colon)), 0 };
+        int port = atoi(std::string(text.substr(colon + 1)).c_str());
+        in_addr parsed;
+        if (port <= 0 || port > 65535 || inet_pton(AF_INET, address.group.c_str(), &parsed) != 1 || !IN_MULTICAST(ntohl(parsed.s_addr)))
+            return std::nullopt;
+        address.port = port;
+        return address;
+    }
+
+    sockaddr_in SocketAddress() const
+    {
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = inet_addr(group.c_str());
+        addr.sin_port = htons(port);
+        return addr;
+    }
+
+    std::string ToString() const
+    {
+        return group + ":" + std::to_string(port);
+    }
+};
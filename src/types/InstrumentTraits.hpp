@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string_view>
+
+// Prices are whole ticks from zero, so an instrument class's tick size and top price fix the
+// length of its ladder. Quantity is the width of a resting order's open and filled quantity,
+// orders above its maximum are rejected.
+constexpr size_t LadderSize(double maxPrice, double tickSize)
+{
+    return static_cast<size_t>(maxPrice / tickSize + 0.5) + 1;
+}
+
+// $0.01 up to $10,000.00
+struct EquityTraits
+{
+    static constexpr std::string_view NAME = "equity";
+    static constexpr double TICK_SIZE = 0.01;
+    static constexpr double MAX_PRICE = 10000.0;
+    static constexpr size_t NUM_PRICE_LEVELS = LadderSize(MAX_PRICE, TICK_SIZE);
+    using Quantity = uint32_t;
+};
+
+// Index futures: quarter point ticks up to 10,000 points, sizes in contracts
+struct FutureTraits
+{
+    static constexpr std::string_view NAME = "future";
+    static constexpr double TICK_SIZE = 0.25;
+    static constexpr double MAX_PRICE = 10000.0;
+    static constexpr size_t NUM_PRICE_LEVELS = LadderSize(MAX_PRICE, TICK_SIZE);
+    using Quantity = uint16_t;
+};
+
+// Sub-dollar stocks quoted in $0.0001 up to $1.00
+struct PennyStockTraits
+{
+    static constexpr std::string_view NAME = "penny";
+    static constexpr double TICK_SIZE = 0.0001;
+    static constexpr double MAX_PRICE = 1.0;
+    static constexpr size_t NUM_PRICE_LEVELS = LadderSize(MAX_PRICE, TICK_SIZE);
+    using Quantity = uint32_t;
+};
+
+template<typename Traits>
+concept InstrumentTraits = requires {
+    Traits::NAME;
+    Traits::NUM_PRICE_LEVELS;
+    typename Traits::Quantity;
+} && std::numeric_limits<typename Traits::Quantity>::max() <= UINT32_MAX && Traits::NUM_PRICE_LEVELS < UINT32_MAX;
+
+// The instrument classes books are precompiled for, in the order AnyOrderBook holds them
+enum class InstrumentClass : uint8_t
+{
+    EQUITY,
+    FUTURE,
+    PENNY_STOCK
+};
+
+inline std::optional<InstrumentClass> ParseInstrumentClass(std::string_view name)
+{
+    if (name == EquityTraits::NAME) return InstrumentClass::EQUITY;
+    if (name == FutureTraits::NAME) return InstrumentClass::FUTURE;
+    if (name == PennyStockTraits::NAME) return InstrumentClass::PENNY_STOCK;
+    return std::nullopt;
+}
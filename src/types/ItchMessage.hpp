@@ -16,7 +16,7 @@ struct OrderAddMsg
     uint64_t orderId;
     uint8_t side;
     uint32_t quantity;
-    char symbol[4];
+    char symbol[8];
     uint32_t price;
 };
 
@@ -34,16 +34,33 @@ struct OrderDeleteMsg
     uint64_t orderId;
 };
 
+// Same order reference, new open quantity and price
+struct OrderReplaceMsg
+{
+    ItchHeader header;
+    uint64_t orderId;
+    uint32_t quantity;
+    uint32_t price;
+};
+
 struct TradeMsg
 {
     ItchHeader header;
     uint8_t side;
     uint32_t quantity;
-    char symbol[4];
+    char symbol[8];
     uint32_t price;
     uint64_t matchId;
 };
 
+// Trading state of one symbol, 'H' halted or 'T' trading
+struct TradingActionMsg
+{
+    ItchHeader header;
+    char symbol[8];
+    char tradingState;
+};
+
 struct EndMarketMsg
 {
     ItchHeader header;
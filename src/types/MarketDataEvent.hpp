@@ -5,12 +5,45 @@
 #include "Order.hpp"
 #include "Timer.hpp"
 
+// Events carry the time their request started processing. The engine reads the TSC once per
+// request (StartRequest) and every event of that request copies it, so a sweep of 100 orders
+// costs one rdtsc rather than one per fill. Building with PER_EVENT_TIMESTAMPS makes each event
+// read the TSC when it is created instead.
+class EventClock
+{
+private:
+    static inline thread_local uint64_t requestTime = 0;
+
+public:
+    static void StartRequest()
+    {
+#ifndef PER_EVENT_TIMESTAMPS
+        requestTime = Timer::rdtsc();
+#endif
+    }
+
+    static uint64_t Now()
+    {
+#ifdef PER_EVENT_TIMESTAMPS
+        return Timer::rdtsc();
+#else
+        return requestTime;
+#endif
+    }
+};
+
 enum class EventType
 {
     ORDER_ACKED,
     ORDER_FILLED,
     ORDER_CANCELLED,
-    ORDER_REJECTED
+    ORDER_REJECTED,
+    ORDER_REPLACED,
+    ORDER_REPLENISHED,
+    STOP_ACCEPTED,
+    STOP_CANCELLED,
+    TRADING_HALTED,
+    TRADING_RESUMED
 };
 
 enum class RejectionType
@@ -19,6 +52,14 @@ enum class RejectionType
     INVALID_QUANTITY,
     INVALID_PRICE,
     ORDER_NOT_FOUND,
+    INVALID_SESSION,
+    INVALID_ACCOUNT,
+    ORDER_SIZE_LIMIT,
+    NOTIONAL_LIMIT,
+    OPEN_ORDER_LIMIT,
+    POSITION_LIMIT,
+    SYMBOL_HALTED,
+    NOT_ALLOWED_IN_AUCTION,
 };
 
 struct MarketDataEvent
@@ -26,28 +67,31 @@ struct MarketDataEvent
     EventType type;
     uint64_t orderId;
     uint64_t requestId;
-    uint8_t symbolId;
-    Side side;
+    SymbolId symbolId = 0;
+    Side side = Side::BUY;
     uint64_t timestamp;
 
-    uint64_t tradeId;
-    uint64_t restingOrderId;
-    uint32_t price;
-    uint32_t quantity;
+    uint64_t tradeId = 0;
+    uint64_t restingOrderId = 0;
+    uint32_t price = 0;
+    uint32_t quantity = 0;
 
-    RejectionType rejectionReason;
+    RejectionType rejectionReason = RejectionType::NONE;
 
     MarketDataEvent() {}
 
-    MarketDataEvent(uint64_t oId, uint64_t rId, uint8_t sId, Side s, uint32_t p, uint32_t q)
-        : type(EventType::ORDER_ACKED), orderId(oId), requestId(rId), symbolId(sId), side(s), price(p), quantity(q), timestamp(Timer::rdtsc()) {}
+    MarketDataEvent(uint64_t oId, uint64_t rId, SymbolId sId, Side s, uint32_t p, uint32_t q)
+        : type(EventType::ORDER_ACKED), orderId(oId), requestId(rId), symbolId(sId), side(s), price(p), quantity(q), timestamp(EventClock::Now()) {}
+
+    MarketDataEvent(EventType t, uint64_t oId, uint64_t rId, SymbolId sId, Side s, uint32_t p, uint32_t q)
+        : type(t), orderId(oId), requestId(rId), symbolId(sId), side(s), price(p), quantity(q), timestamp(EventClock::Now()) {}
 
-    MarketDataEvent(uint64_t oId, uint64_t rId, uint8_t sId, uint64_t tId, uint64_t restingId, uint32_t p, uint32_t q)
-        : type(EventType::ORDER_FILLED), orderId(oId), requestId(rId), symbolId(sId), tradeId(tId), restingOrderId(restingId), price(p), quantity(q), timestamp(Timer::rdtsc()) {}
+    MarketDataEvent(uint64_t oId, uint64_t rId, SymbolId sId, uint64_t tId, uint64_t restingId, uint32_t p, uint32_t q)
+        : type(EventType::ORDER_FILLED), orderId(oId), requestId(rId), symbolId(sId), tradeId(tId), restingOrderId(restingId), price(p), quantity(q), timestamp(EventClock::Now()) {}
 
     MarketDataEvent(uint64_t oId, uint64_t rId)
-        : type(EventType::ORDER_CANCELLED), orderId(oId), requestId(rId), timestamp(Timer::rdtsc()) {}
+        : type(EventType::ORDER_CANCELLED), orderId(oId), requestId(rId), timestamp(EventClock::Now()) {}
 
     MarketDataEvent(uint64_t oId, uint64_t rId, RejectionType rej)
-        : type(EventType::ORDER_REJECTED), orderId(oId), requestId(rId), rejectionReason(rej), timestamp(Timer::rdtsc()) {}
+        : type(EventType::ORDER_REJECTED), orderId(oId), requestId(rId), rejectionReason(rej), timestamp(EventClock::Now()) {}
 };
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <chrono>
 #include <list>
 #include <memory>
+#include <optional>
 #include <variant>
 #include "Timer.hpp"
 
@@ -18,28 +19,49 @@ enum class OrderType
     MARKET,
     LIMIT,
     IOC,
-    FOK
+    FOK,
+    STOP,       // becomes a market order once triggered
+    STOP_LIMIT  // becomes a limit order at `price` once triggered
 };
 
+// Sessions own orders and can mass cancel them, ids are below MAX_SESSIONS
+static constexpr size_t MAX_SESSIONS = 1024;
+// Accounts carry risk limits and positions, ids are below MAX_ACCOUNTS
+static constexpr size_t MAX_ACCOUNTS = 1024;
+
+// Index of a symbol in the SymbolDirectory, the top value is kept for "all symbols"
+using SymbolId = uint16_t;
+static constexpr size_t MAX_NUM_SYMBOLS = UINT16_MAX;
+
 struct Order
 {
     uint64_t orderId;
-    uint8_t symbolId;
+    SymbolId symbolId;
     Side side;
     OrderType type;
+    uint16_t sessionId = 0;
+    uint16_t accountId = 0;
     uint32_t quantity;
     uint32_t price;
     uint64_t timestamp;
 
     uint32_t filledQuantity = 0;
 
-    Order* next = nullptr;
-    Order* prev = nullptr;
+    // Iceberg orders show at most displayQuantity at a time and hold the rest in reserve,
+    // zero shows everything
+    uint32_t displayQuantity = 0;
+
+    // Trade price that triggers a stop or stop-limit order
+    uint32_t stopPrice = 0;
 
     Order() {}
 
-    Order(uint64_t id, uint8_t symId, Side s, OrderType t, uint32_t qty, uint32_t p)
-        : orderId(id), symbolId(symId), side(s), type(t), quantity(qty), price(p), timestamp(Timer::rdtsc()) {}
+    Order(uint64_t id, SymbolId symId, Side s, OrderType t, uint32_t qty, uint32_t p, uint16_t session = 0, uint16_t account = 0)
+        : orderId(id), symbolId(symId), side(s), type(t), sessionId(session), accountId(account), quantity(qty), price(p), timestamp(Timer::rdtsc()) {}
+
+    // For orders the engine builds itself, stamped with a time it already has instead of a TSC read
+    Order(uint64_t id, SymbolId symId, Side s, OrderType t, uint32_t qty, uint32_t p, uint16_t session, uint16_t account, uint64_t ts)
+        : orderId(id), symbolId(symId), side(s), type(t), sessionId(session), accountId(account), quantity(qty), price(p), timestamp(ts) {}
 
     uint32_t RemainingQuantity() const
     {
@@ -59,7 +81,31 @@ struct CancelRequest
     uint64_t timestamp;
 };
 
+// Changes a resting order to `quantity` open shares at `price`. Reducing size at the same price
+// keeps time priority, anything else re-enters the order at the back of the new level.
+struct ModifyRequest
+{
+    uint64_t requestId;
+    uint64_t targetOrderId;
+    uint32_t quantity;
+    uint32_t price;
+    uint64_t timestamp;
+};
+
+// Cancels every resting order that matches all three filters
+struct MassCancelRequest
+{
+    static constexpr SymbolId ALL_SYMBOLS = UINT16_MAX;
+    static constexpr uint16_t ALL_SESSIONS = UINT16_MAX;
+
+    uint64_t requestId;
+    SymbolId symbolId = ALL_SYMBOLS;
+    std::optional<Side> side;
+    uint16_t sessionId = ALL_SESSIONS;
+    uint64_t timestamp;
+};
+
 struct OrderRequest
 {
-    std::variant<Order, CancelRequest> data;
+    std::variant<Order, CancelRequest, ModifyRequest, MassCancelRequest> data;
 };
\ No newline at end of file
@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+
+#include "Order.hpp"
+#include "Timer.hpp"
+
+enum class RequestKind : uint8_t
+{
+    ORDER = 'O',
+    CANCEL = 'C',
+    MODIFY = 'M',
+    MASS_CANCEL = 'X'
+};
+
+// Side value of a mass cancel record that applies to both sides
+static constexpr uint8_t ANY_SIDE = UINT8_MAX;
+
+#pragma pack(push, 1)
+
+// Fixed-size, self-contained form of an OrderRequest. This is what the scenario generator
+// produces, what request files store on disk and what the gateway replays from.
+struct RequestRecord
+{
+    uint64_t sendTimeNs;
+    uint64_t requestId;
+    uint64_t targetOrderId;
+    uint32_t quantity;
+    uint32_t price;
+    RequestKind kind;
+    SymbolId symbolId;
+    uint8_t side;
+    uint8_t type;
+    uint16_t sessionId;
+    uint16_t accountId;
+    uint32_t displayQuantity;
+    uint32_t stopPrice;
+
+    static RequestRecord MakeOrder(uint64_t sendTimeNs, uint64_t id, SymbolId symbolId, Side side, OrderType type, uint32_t qty, uint32_t price, uint16_t sessionId = 0, uint16_t accountId = 0, uint32_t displayQuantity = 0, uint32_t stopPrice = 0)
+    {
+        return RequestRecord{ sendTimeNs, id, 0, qty, price, RequestKind::ORDER, symbolId, static_cast<uint8_t>(side), static_cast<uint8_t>(type), sessionId, accountId, displayQuantity, stopPrice };
+    }
+
+    static RequestRecord MakeCancel(uint64_t sendTimeNs, uint64_t id, uint64_t targetOrderId)
+    {
+        return RequestRecord{ sendTimeNs, id, targetOrderId, 0, 0, RequestKind::CANCEL, 0, 0, 0, 0, 0, 0, 0 };
+    }
+
+    static RequestRecord MakeModify(uint64_t sendTimeNs, uint64_t id, uint64_t targetOrderId, uint32_t qty, uint32_t price)
+    {
+        return RequestRecord{ sendTimeNs, id, targetOrderId, qty, price, RequestKind::MODIFY, 0, 0, 0, 0, 0, 0, 0 };
+    }
+
+    static RequestRecord MakeMassCancel(uint64_t sendTimeNs, uint64_t id, SymbolId symbolId, uint8_t side, uint16_t sessionId)
+    {
+        return RequestRecord{ sendTimeNs, id, 0, 0, 0, RequestKind::MASS_CANCEL, symbolId, side, 0, sessionId, 0, 0, 0 };
+    }
+
+    void Decode(OrderRequest & req) const
+    {
+        if (kind == RequestKind::ORDER)
+        {
+            Order order(requestId, symbolId, static_cast<Side>(side), static_cast<OrderType>(type), quantity, price, sessionId, accountId);
+            order.displayQuantity = displayQuantity;
+            order.stopPrice = stopPrice;
+            req.data = order;
+        }
+        else if (kind == RequestKind::MASS_CANCEL)
+            req.data = MassCancelRequest{ requestId, symbolId, side == ANY_SIDE ? std::nullopt : std::optional(static_cast<Side>(side)), sessionId, Timer::rdtsc() };
+        else if (kind == RequestKind::MODIFY)
+            req.data = ModifyRequest{ requestId, targetOrderId, quantity, price, Timer::rdtsc() };
+        else
+            req.data = CancelRequest{ requestId, targetOrderId, Timer::rdtsc() };
+    }
+};
+
+#pragma pack(pop)
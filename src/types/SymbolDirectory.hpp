@@ -0,0 +1,151 @@
+#pragma once
+#include <array>
+#include <deque>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Order.hpp"
+#include "InstrumentTraits.hpp"
+
+constexpr size_t NUM_DEFAULT_SYMBOLS = 50;
+
+constexpr std::array<std::string_view, NUM_DEFAULT_SYMBOLS> DEFAULT_SYMBOLS = {
+    "AAPL", "MSFT", "NVDA", "GOOGL", "AMZN",
+    "META", "TSLA", "AMD", "INTC", "NFLX",
+
+    "JPM", "BAC", "WFC", "C", "GS",
+    "MS", "BLK", "V", "MA", "PYPL",
+
+    "WMT", "TGT", "COST", "HD", "MCD",
+    "SBUX", "KO", "PEP", "PG", "NKE",
+
+    "XOM", "CVX", "GE", "BA", "CAT",
+    "UNP", "UPS", "F", "GM", "DE",
+
+    "JNJ", "PFE", "MRK", "ABBV", "LLY",
+    "UNH", "CVS", "BMY", "AMGN", "GILD"
+};
+
+// The tradable universe, loaded at startup: symbol ids are indices in load order and each
+// symbol has an instrument class. Names are stored once and handed out as views that stay
+// valid for the directory's lifetime.
+class SymbolDirectory
+{
+private:
+    std::deque<std::string> names;
+    std::vector<InstrumentClass> classes;
+    std::unordered_map<std::string_view, SymbolId> ids;
+
+public:
+    SymbolDirectory() = default;
+
+    SymbolDirectory(const SymbolDirectory & other)
+    {
+        for (size_t i = 0; i < other.Size(); i++)
+            Add(other.names[i], other.classes[i]);
+    }
+
+    SymbolDirectory & operator=(const SymbolDirectory & other)
+    {
+        if (this != &other)
+        {
+            names.clear();
+            classes.clear();
+            ids.clear();
+            for (size_t i = 0; i < other.Size(); i++)
+                Add(other.names[i], other.classes[i]);
+        }
+        return *this;
+    }
+
+    // The first `count` built-in tickers, all equities
+    static SymbolDirectory Default(size_t count = NUM_DEFAULT_SYMBOLS)
+    {
+        if (count > NUM_DEFAULT_SYMBOLS)
+            throw std::runtime_error{ "Only " + std::to_string(NUM_DEFAULT_SYMBOLS) + " built-in symbols" };
+
+        SymbolDirectory directory;
+        for (size_t i = 0; i < count; i++)
+            directory.Add(DEFAULT_SYMBOLS[i]);
+        return directory;
+    }
+
+    // `count` generated names (S0, S1, ...) of one class, for tests and benchmarks
+    static SymbolDirectory Synthetic(size_t count, InstrumentClass instrumentClass = InstrumentClass::EQUITY)
+    {
+        SymbolDirectory directory;
+        for (size_t i = 0; i < count; i++)
+            directory.Add("S" + std::to_string(i), instrumentClass);
+        return directory;
+    }
+
+    // One "<symbol> [<class>]" per line, in id order. The class defaults to equity. Blank lines
+    // and lines starting with '#' are skipped.
+    static SymbolDirectory Load(const std::string & path)
+    {
+        std::ifstream in(path);
+        if (!in)
+            throw std::runtime_error{ "Failed to open symbol directory: " + path };
+
+        SymbolDirectory directory;
+        std::string line;
+        for (size_t lineNumber = 1; std::getline(in, line); lineNumber++)
+        {
+            std::istringstream fields(line);
+            std::string symbol, className;
+            if (!(fields >> symbol) || symbol.starts_with('#'))
+                continue;
+
+            auto where = path + ":" + std::to_string(lineNumber) + ": ";
+            auto instrumentClass = fields >> className ? ParseInstrumentClass(className) : InstrumentClass::EQUITY;
+            if (!instrumentClass)
+                throw std::runtime_error{ where + "unknown instrument class " + className };
+            if (directory.Find(symbol))
+                throw std::runtime_error{ where + "duplicate symbol " + symbol };
+
+            directory.Add(symbol, *instrumentClass);
+        }
+        return directory;
+    }
+
+    SymbolId Add(std::string_view symbol, InstrumentClass instrumentClass = InstrumentClass::EQUITY)
+    {
+        if (names.size() >= MAX_NUM_SYMBOLS)
+            throw std::runtime_error{ "Too many symbols" };
+        if (ids.contains(symbol))
+            throw std::runtime_error{ "Duplicate symbol " + std::string(symbol) };
+
+        SymbolId id = names.size();
+        names.emplace_back(symbol);
+        classes.push_back(instrumentClass);
+        ids.emplace(names.back(), id);
+        return id;
+    }
+
+    size_t Size() const
+    {
+        return names.size();
+    }
+
+    std::string_view Name(SymbolId id) const
+    {
+        return names[id];
+    }
+
+    InstrumentClass Class(SymbolId id) const
+    {
+        return classes[id];
+    }
+
+    std::optional<SymbolId> Find(std::string_view symbol) const
+    {
+        auto it = ids.find(symbol);
+        return it == ids.end() ? std::nullopt : std::optional(it->second);
+    }
+};
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct CpuInfo
+{
+    int cpu;
+    int core;
+    int package;
+    int node;
+};
+
+// Online CPUs as described by /sys/devices/system/cpu.
+class CpuTopology
+{
+private:
+    std::vector<CpuInfo> cpus;
+
+    static int ReadInt(const std::filesystem::path & path, int fallback)
+    {
+        std::ifstream in(path);
+        int value;
+        if (in >> value)
+            return value;
+        return fallback;
+    }
+
+    // Parses cpu lists like "0-3,8,10-11"
+    static std::vector<int> ParseCpuList(const std::string & list)
+    {
+        std::vector<int> result;
+        std::stringstream ss(list);
+        std::string range;
+        while (std::getline(ss, range, ','))
+        {
+            if (range.empty())
+                continue;
+            auto dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; cpu++)
+                result.push_back(cpu);
+        }
+        return result;
+    }
+
+public:
+    static CpuTopology Detect(const std::filesystem::path & root = "/sys/devices/system/cpu")
+    {
+        CpuTopology topology;
+
+        std::ifstream onlineFile(root / "online");
+        std::string online;
+        std::getline(onlineFile, online);
+
+        for (int cpu : ParseCpuList(online))
+        {
+            auto cpuDir = root / ("cpu" + std::to_string(cpu));
+
+            int node = 0;
+            std::error_code ec;
+            for (const auto & entry : std::filesystem::directory_iterator(cpuDir, ec))
+            {
+                auto name = entry.path().filename().string();
+                if (name.starts_with("node") && name.size() > 4 && std::isdigit(name[4]))
+                {
+                    node = std::stoi(name.substr(4));
+                    break;
+                }
+            }
+
+            topology.cpus.push_back({
+                cpu,
+                ReadInt(cpuDir / "topology" / "core_id", cpu),
+                ReadInt(cpuDir / "topology" / "physical_package_id", 0),
+                node
+            });
+        }
+        return topology;
+    }
+
+    const std::vector<CpuInfo> & Cpus() const
+    {
+        return cpus;
+    }
+
+    const CpuInfo* Find(int cpu) const
+    {
+        auto it = std::find_if(cpus.begin(), cpus.end(), [cpu](const CpuInfo & info) { return info.cpu == cpu; });
+        return it == cpus.end() ? nullptr : &*it;
+    }
+
+    int NodeOf(int cpu) const
+    {
+        auto info = Find(cpu);
+        return info ? info->node : -1;
+    }
+
+    // True if both CPUs are hyperthreads of the same physical core.
+    bool AreSiblings(int a, int b) const
+    {
+        auto infoA = Find(a);
+        auto infoB = Find(b);
+        return a != b && infoA && infoB && infoA->package == infoB->package && infoA->core == infoB->core;
+    }
+
+    // Picks `count` CPUs on one NUMA node, preferring the node with the most physical cores.
+    // With avoidSmt at most one CPU per physical core is used, and CPU 0 is left for the OS.
+    // Both restrictions are relaxed if the machine is too small, as a last resort CPUs repeat.
+    std::vector<int> PickCpus(size_t count, bool avoidSmt) const
+    {
+        std::vector<int> nodes;
+        for (const auto & info : cpus)
+            if (std::find(nodes.begin(), nodes.end(), info.node) == nodes.end())
+                nodes.push_back(info.node);
+
+        auto pick = [&](int node, bool skipCpu0, bool oneFromCore) {
+            std::vector<int> picked;
+            std::vector<std::pair<int, int>> usedCores;
+            for (const auto & info : cpus)
+            {
+                if (info.node != node || (skipCpu0 && info.cpu == 0))
+                    continue;
+                std::pair<int, int> core{ info.package, info.core };
+                if (oneFromCore && std::find(usedCores.begin(), usedCores.end(), core) != usedCores.end())
+                    continue;
+                usedCores.push_back(core);
+                picked.push_back(info.cpu);
+            }
+            return picked;
+        };
+
+        std::vector<int> best;
+        for (bool oneFromCore : { avoidSmt, false })
+        {
+            for (bool skipCpu0 : { true, false })
+            {
+                for (int node : nodes)
+                {
+                    auto picked = pick(node, skipCpu0, oneFromCore);
+                    if (picked.size() > best.size())
+                        best = picked;
+                }
+                if (best.size() >= count)
+                {
+                    best.resize(count);
+                    return best;
+                }
+            }
+        }
+
+        if (best.empty())
+            return std::vector<int>(count, -1);
+
+        for (size_t i = best.size(); i < count; i++)
+            best.push_back(best[i % best.size()]);
+        return best;
+    }
+};
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#include <sys/mman.h>
+
+#include "Memory.hpp"
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+// One anonymous mapping that containers carve their storage from with a bump pointer.
+// Backing is tried in order: explicit 1 GB pages (for arenas of at least 512 MB), explicit
+// 2 MB pages (at least 1 MB), then normal pages advised for transparent huge pages. Explicit
+// huge pages need a reserved hugetlbfs pool (vm.nr_hugepages), without one we fall back.
+// Memory is zero-filled and only faulted in when first touched. An arena made without huge
+// pages only costs the 4 KB pages it touches, it gets the transparent huge page advice once it
+// is prefaulted.
+class HugePageArena
+{
+private:
+    static constexpr size_t HUGE_1GB_SIZE = 1024 * 1024 * 1024;
+
+    void* base = MAP_FAILED;
+    size_t capacity = 0;
+    size_t used = 0;
+    size_t pageSize = 0;
+
+    static size_t RoundUp(size_t bytes, size_t alignment)
+    {
+        return (bytes + alignment - 1) / alignment * alignment;
+    }
+
+    bool TryMap(size_t bytes, size_t page, int flags)
+    {
+        size_t rounded = RoundUp(bytes, page);
+        // Huge pages are reserved up front so a short pool fails here instead of with SIGBUS on first touch
+        int reserve = (flags & MAP_HUGETLB) ? 0 : MAP_NORESERVE;
+        void* ptr = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | reserve | flags, -1, 0);
+        if (ptr == MAP_FAILED)
+            return false;
+        base = ptr;
+        capacity = rounded;
+        pageSize = page;
+        return true;
+    }
+
+public:
+    explicit HugePageArena(size_t bytes, bool hugePages = true)
+    {
+        bytes = std::max<size_t>(bytes, 1);
+
+        if (!hugePages)
+        {
+            if (!TryMap(bytes, HUGE_PAGE_SIZE, 0))
+                throw std::bad_alloc{};
+            pageSize = 0;
+            return;
+        }
+        if (bytes >= HUGE_1GB_SIZE / 2 && TryMap(bytes, HUGE_1GB_SIZE, MAP_HUGETLB | MAP_HUGE_1GB))
+            return;
+        if (bytes >= HUGE_PAGE_SIZE / 2 && TryMap(bytes, HUGE_PAGE_SIZE, MAP_HUGETLB | MAP_HUGE_2MB))
+            return;
+        if (!TryMap(bytes, HUGE_PAGE_SIZE, 0))
+            throw std::bad_alloc{};
+        madvise(base, capacity, MADV_HUGEPAGE);
+        pageSize = 0;
+    }
+
+    HugePageArena(const HugePageArena&) = delete;
+    HugePageArena& operator=(const HugePageArena&) = delete;
+
+    ~HugePageArena()
+    {
+        if (base != MAP_FAILED)
+            munmap(base, capacity);
+    }
+
+    // Bytes an arena needs to hold `count` objects of type T, including alignment padding
+    template<typename T>
+    static constexpr size_t BytesFor(size_t count)
+    {
+        return RoundUp(count * sizeof(T), CACHE_LINE_SIZE) + CACHE_LINE_SIZE;
+    }
+
+    // Uninitialized (zero-filled) storage for `count` objects, cache line aligned
+    template<typename T>
+    T* Allocate(size_t count)
+    {
+        size_t offset = RoundUp(used, std::max(alignof(T), CACHE_LINE_SIZE));
+        size_t bytes = count * sizeof(T);
+        if (offset + bytes > capacity)
+            throw std::bad_alloc{};
+        used = offset + bytes;
+        return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+    }
+
+    void Prefault(const WarmupOptions & options)
+    {
+        if (pageSize == 0)
+            madvise(base, capacity, MADV_HUGEPAGE);
+        PrefaultRange(base, used, options);
+    }
+
+    // Explicit huge page size backing the arena, 0 for normal (possibly transparent huge) pages
+    size_t HugePageSize() const
+    {
+        return pageSize;
+    }
+};
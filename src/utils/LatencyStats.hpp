@@ -13,19 +13,37 @@ public:
     void record(uint64_t cycles)
     {
         samples.push_back(cycles);
+        sorted = false;
+    }
+
+    size_t size() const
+    {
+        return samples.size();
+    }
+
+    // Percentile in cycles, p in [0, 1]
+    uint64_t percentile(double p)
+    {
+        sort();
+        return samples[std::min((size_t)(samples.size() * p), samples.size() - 1)];
+    }
+
+    double mean() const
+    {
+        return std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
     }
 
     void print_stats()
     {
-        std::sort(samples.begin(), samples.end());
+        sort();
 
         double min = samples.front();
         double max = samples.back();
-        double mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
-        double median = samples[samples.size() / 2];
-        double p95 = samples[(size_t)(samples.size() * 0.95)];
-        double p99 = samples[(size_t)(samples.size() * 0.99)];
-        double p999 = samples[(size_t)(samples.size() * 0.999)];
+        double mean = this->mean();
+        double median = percentile(0.5);
+        double p95 = percentile(0.95);
+        double p99 = percentile(0.99);
+        double p999 = percentile(0.999);
 
         std::cout << std::fixed << std::setprecision(2);
         std::cout << "Min:    " << std::setw(10) << Timer::cycles_to_ns(min) << " ns\n";
@@ -38,5 +56,13 @@ public:
     }
 
 private:
+    void sort()
+    {
+        if (!sorted)
+            std::sort(samples.begin(), samples.end());
+        sorted = true;
+    }
+
     std::vector<uint64_t> samples;
+    bool sorted = false;
 };
\ No newline at end of file
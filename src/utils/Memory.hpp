@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+static constexpr size_t CACHE_LINE_SIZE = 64;
+static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+struct WarmupOptions
+{
+    bool lockMemory = false;          // mlock every pool and ring
+    size_t syntheticOrders = 100'000; // requests run through the matching code, 0 to skip
+};
+
+// Touches every page of the range so that page faults happen now rather than on the hot path.
+// Existing contents are preserved.
+inline void PrefaultRange(void* ptr, size_t bytes)
+{
+    static const size_t pageSize = sysconf(_SC_PAGESIZE);
+    volatile char* bytesPtr = static_cast<volatile char*>(ptr);
+    for (size_t offset = 0; offset < bytes; offset += pageSize)
+        bytesPtr[offset] = bytesPtr[offset];
+    if (bytes > 0)
+        bytesPtr[bytes - 1] = bytesPtr[bytes - 1];
+}
+
+inline void PrefaultRange(void* ptr, size_t bytes, const WarmupOptions & options)
+{
+    PrefaultRange(ptr, bytes);
+    if (options.lockMemory && mlock(ptr, bytes) != 0)
+        perror("mlock");
+}
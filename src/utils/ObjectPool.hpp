@@ -1,38 +1,71 @@
 #pragma once
 
-#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
 
+#include "HugePageArena.hpp"
+
+// Fixed-capacity pool drawing its storage from an arena, handing out 32-bit slot indices rather
+// than pointers. Slot 0 is never handed out so it can serve as the null index. Free objects form
+// an intrusive list threaded through their own first bytes, so there is no separate free list to
+// keep in cache, and slots that were never handed out are not touched until first allocated.
 template<typename T>
 class ObjectPool
 {
+    static_assert(std::is_trivial_v<T> && sizeof(T) >= sizeof(uint32_t), "ObjectPool stores its free list inside free objects");
+
 private:
     T* storage;
-    std::vector<T*> freeList;
+    uint32_t size;
+    uint32_t nextUnused = 1;
+    uint32_t freeHead = NULL_SLOT;
 
 public:
-    ObjectPool(size_t size)
+    static constexpr uint32_t NULL_SLOT = 0;
+
+    ObjectPool(size_t size_, HugePageArena & arena)
+    {
+        if (size_ >= UINT32_MAX)
+            throw std::runtime_error{ "Pool capacity exceeds 32-bit slot range" };
+        size = size_ + 1;
+        storage = arena.Allocate<T>(size);
+    }
+
+    // Arena bytes needed for a pool of `count` objects
+    static constexpr size_t BytesFor(size_t count)
     {
-        storage = new T[size];
-        freeList.reserve(size);
-        for (int i = 0; i < size; i++)
-            freeList.push_back(&storage[i]);
+        return HugePageArena::BytesFor<T>(count + 1);
+    }
+
+    uint32_t Allocate()
+    {
+        if (freeHead != NULL_SLOT)
+        {
+            uint32_t slot = freeHead;
+            memcpy(&freeHead, &storage[slot], sizeof(uint32_t));
+            return slot;
+        }
+
+        if (nextUnused == size) return NULL_SLOT;
+        return nextUnused++;
     }
 
-    ~ObjectPool()
+    void Deallocate(uint32_t slot)
     {
-        delete[] storage;
+        memcpy(&storage[slot], &freeHead, sizeof(uint32_t));
+        freeHead = slot;
     }
 
-    T* Allocate()
+    T & operator[](uint32_t slot)
     {
-        if (freeList.empty()) return nullptr;
-        T* node = freeList.back();
-        freeList.pop_back();
-        return node;
+        return storage[slot];
     }
 
-    void Deallocate(T* node)
+    // Number of slots including the null slot, for arrays indexed in parallel with the pool
+    size_t Slots() const
     {
-        freeList.push_back(node);
+        return size;
     }
-};
\ No newline at end of file
+};
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// pcap files of UDP datagrams. Written files use nanosecond timestamps and raw IPv4 link
+// type, so each record is an IPv4 and a UDP header followed by the datagram. Readers also
+// take microsecond files and Ethernet or Linux cooked captures, e.g. from tcpdump on lo.
+namespace pcap
+{
+    constexpr uint32_t MAGIC_MICROSECONDS = 0xa1b2c3d4;
+    constexpr uint32_t MAGIC_NANOSECONDS = 0xa1b23c4d;
+
+    constexpr uint32_t LINKTYPE_ETHERNET = 1;
+    constexpr uint32_t LINKTYPE_RAW = 101;
+    constexpr uint32_t LINKTYPE_LINUX_SLL = 113;
+    constexpr uint32_t LINKTYPE_IPV4 = 228;
+
+    struct FileHeader
+    {
+        uint32_t magic;
+        uint16_t versionMajor;
+        uint16_t versionMinor;
+        int32_t thisZone;
+        uint32_t sigFigs;
+        uint32_t snapLength;
+        uint32_t linkType;
+    };
+
+    struct RecordHeader
+    {
+        uint32_t seconds;
+        uint32_t fraction;
+        uint32_t capturedLength;
+        uint32_t originalLength;
+    };
+
+    struct Ipv4Header
+    {
+        uint8_t versionAndLength;
+        uint8_t typeOfService;
+        uint16_t totalLength;
+        uint16_t id;
+        uint16_t fragmentOffset;
+        uint8_t ttl;
+        uint8_t protocol;
+        uint16_t checksum;
+        uint32_t source;
+        uint32_t destination;
+    };
+
+    struct UdpHeader
+    {
+        uint16_t sourcePort;
+        uint16_t destinationPort;
+        uint16_t length;
+        uint16_t checksum;
+    };
+
+    static_assert(sizeof(FileHeader) == 24 && sizeof(RecordHeader) == 16);
+    static_assert(sizeof(Ipv4Header) == 20 && sizeof(UdpHeader) == 8);
+
+    constexpr size_t PACKET_OVERHEAD = sizeof(RecordHeader) + sizeof(Ipv4Header) + sizeof(UdpHeader);
+}
+
+// Appends datagrams to a pcap file through a buffer that is written out when full
+class PcapWriter
+{
+private:
+    static constexpr size_t BUFFER_SIZE = 1 << 20;
+
+    int fd = -1;
+    std::vector<char> buffer;
+    size_t used = 0;
+    pcap::Ipv4Header ip{};
+    pcap::UdpHeader udp{};
+
+    void Append(const void* data, size_t size)
+    {
+        memcpy(buffer.data() + used, data, size);
+        used += size;
+    }
+
+public:
+    PcapWriter(const std::string & path, in_addr_t source, in_addr_t destination, uint16_t port) : buffer(BUFFER_SIZE)
+    {
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd == -1)
+            throw std::runtime_error{ "Failed to open capture file for writing: " + path };
+
+        pcap::FileHeader header{ pcap::MAGIC_NANOSECONDS, 2, 4, 0, 0, 65535, pcap::LINKTYPE_RAW };
+        Append(&header, sizeof(header));
+
+        ip.versionAndLength = 0x45;
+        ip.ttl = 1;
+        ip.protocol = IPPROTO_UDP;
+        ip.source = source;
+        ip.destination = destination;
+        udp.destinationPort = htons(port);
+    }
+
+    PcapWriter(const PcapWriter&) = delete;
+    PcapWriter& operator=(const PcapWriter&) = delete;
+
+    ~PcapWriter()
+    {
+        try
+        {
+            Flush();
+        }
+        catch (const std::runtime_error & e)
+        {
+            std::cerr << e.what() << "\n";
+        }
+        close(fd);
+    }
+
+    void Write(uint64_t timestampNs, const char* data, uint16_t length)
+    {
+        if (used + pcap::PACKET_OVERHEAD + length > buffer.size())
+            Flush();
+
+        uint32_t packetLength = sizeof(ip) + sizeof(udp) + length;
+        pcap::RecordHeader record{ static_cast<uint32_t>(timestampNs / 1'000'000'000), static_cast<uint32_t>(timestampNs % 1'000'000'000), packetLength, packetLength };
+        Append(&record, sizeof(record));
+
+        ip.totalLength = htons(packetLength);
+        ip.id = htons(ntohs(ip.id) + 1);
+        ip.checksum = 0;
+        uint32_t sum = 0;
+        for (size_t i = 0; i < sizeof(ip) / 2; i++)
+            sum += reinterpret_cast<const uint16_t*>(&ip)[i];
+        sum = (sum & 0xffff) + (sum >> 16);
+        ip.checksum = ~static_cast<uint16_t>(sum + (sum >> 16));
+        Append(&ip, sizeof(ip));
+
+        udp.length = htons(sizeof(udp) + length);
+        Append(&udp, sizeof(udp));
+        Append(data, length);
+    }
+
+    void Flush()
+    {
+        for (size_t written = 0; written < used;)
+        {
+            auto res = write(fd, buffer.data() + written, used - written);
+            if (res == -1)
+            {
+                // The buffered packets are lost, so a later flush does not fail on them again
+                used = 0;
+                throw std::runtime_error{ std::string("Failed to write capture file: ") + strerror(errno) };
+            }
+            written += res;
+        }
+        used = 0;
+    }
+};
+
+// Read-only memory mapping of a pcap file, iterated packet by packet. Packets that are not
+// IPv4 UDP datagrams are skipped.
+class PcapReader
+{
+private:
+    void* mapping = MAP_FAILED;
+    size_t mappingSize = 0;
+    size_t offset = sizeof(pcap::FileHeader);
+    size_t linkHeaderSize = 0;
+    bool nanoseconds = true;
+
+public:
+    struct Packet
+    {
+        uint64_t timestampNs;
+        std::span<const char> payload;
+    };
+
+    explicit PcapReader(const std::string & path)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd == -1)
+            throw std::runtime_error{ "Failed to open capture file: " + path };
+
+        struct stat st;
+        if (fstat(fd, &st) == -1 || st.st_size < (off_t)sizeof(pcap::FileHeader))
+        {
+            close(fd);
+            throw std::runtime_error{ "Invalid capture file: " + path };
+        }
+
+        mappingSize = st.st_size;
+        mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED)
+            throw std::runtime_error{ "Failed to mmap capture file: " + path };
+
+        auto header = static_cast<const pcap::FileHeader*>(mapping);
+        nanoseconds = header->magic == pcap::MAGIC_NANOSECONDS;
+        switch (header->linkType)
+        {
+        case pcap::LINKTYPE_RAW:
+        case pcap::LINKTYPE_IPV4:
+            linkHeaderSize = 0;
+            break;
+        case pcap::LINKTYPE_ETHERNET:
+            linkHeaderSize = 14;
+            break;
+        case pcap::LINKTYPE_LINUX_SLL:
+            linkHeaderSize = 16;
+            break;
+        default:
+            linkHeaderSize = SIZE_MAX;
+        }
+        if ((header->magic != pcap::MAGIC_NANOSECONDS && header->magic != pcap::MAGIC_MICROSECONDS) || linkHeaderSize == SIZE_MAX)
+        {
+            munmap(mapping, mappingSize);
+            throw std::runtime_error{ "Unsupported capture file format: " + path };
+        }
+        madvise(mapping, mappingSize, MADV_SEQUENTIAL);
+    }
+
+    PcapReader(const PcapReader&) = delete;
+    PcapReader& operator=(const PcapReader&) = delete;
+
+    ~PcapReader()
+    {
+        if (mapping != MAP_FAILED)
+            munmap(mapping, mappingSize);
+    }
+
+    // The next UDP datagram, false at the end of the file
+    bool Next(Packet & packet)
+    {
+        const char* data = static_cast<const char*>(mapping);
+        while (offset + sizeof(pcap::RecordHeader) <= mappingSize)
+        {
+            pcap::RecordHeader record;
+            memcpy(&record, data + offset, sizeof(record));
+            const char* frame = data + offset + sizeof(record);
+            offset += sizeof(record) + record.capturedLength;
+            if (offset > mappingSize)
+                break;
+
+            if (record.capturedLength < linkHeaderSize + sizeof(pcap::Ipv4Header))
+                continue;
+            pcap::Ipv4Header ip;
+            memcpy(&ip, frame + linkHeaderSize, sizeof(ip));
+            size_t ipHeaderSize = (ip.versionAndLength & 0x0f) * 4;
+            size_t udpOffset = linkHeaderSize + ipHeaderSize;
+            if ((ip.versionAndLength >> 4) != 4 || ip.protocol != IPPROTO_UDP || record.capturedLength < udpOffset + sizeof(pcap::UdpHeader))
+                continue;
+
+            pcap::UdpHeader udp;
+            memcpy(&udp, frame + udpOffset, sizeof(udp));
+            if (ntohs(udp.length) < sizeof(udp))
+                continue;
+            size_t payloadOffset = udpOffset + sizeof(udp);
+            size_t payloadLength = std::min<size_t>(ntohs(udp.length) - sizeof(udp), record.capturedLength - payloadOffset);
+
+            packet.timestampNs = uint64_t(record.seconds) * 1'000'000'000 + (nanoseconds ? record.fraction : uint64_t(record.fraction) * 1'000);
+            packet.payload = { frame + payloadOffset, payloadLength };
+            return true;
+        }
+        return false;
+    }
+};
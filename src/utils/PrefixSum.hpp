@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// Inclusive prefix sum, out[i] = in[0] + ... + in[i]. With AVX2 each group of four is scanned in
+// registers with two shifted adds, and the running total is carried as a broadcast vector.
+inline void InclusivePrefixSum(const uint64_t* in, uint64_t* out, size_t count)
+{
+    size_t i = 0;
+    uint64_t total = 0;
+
+#ifdef __AVX2__
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i carry = zero;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        x = _mm256_add_epi64(x, _mm256_blend_epi32(_mm256_permute4x64_epi64(x, _MM_SHUFFLE(2, 1, 0, 0)), zero, 0x03));
+        x = _mm256_add_epi64(x, _mm256_blend_epi32(_mm256_permute4x64_epi64(x, _MM_SHUFFLE(1, 0, 0, 0)), zero, 0x0F));
+        x = _mm256_add_epi64(x, carry);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), x);
+        carry = _mm256_permute4x64_epi64(x, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+    if (i > 0)
+        total = out[i - 1];
+#endif
+
+    for (; i < count; i++)
+    {
+        total += in[i];
+        out[i] = total;
+    }
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "HugePageArena.hpp"
+
+// One bit per price level plus one summary bit per 64-level word, so the next occupied level
+// in either direction is found with a couple of bit scans instead of walking empty levels.
+// Either owns its words or takes them zero-filled from an arena, where they cost nothing
+// until touched.
+class PriceBitmap
+{
+private:
+    std::vector<uint64_t> storage;
+    std::span<uint64_t> words;
+    std::span<uint64_t> summary;
+
+    static constexpr size_t NumWords(size_t numLevels)
+    {
+        return (numLevels + 63) / 64;
+    }
+
+    static constexpr size_t NumSummaryWords(size_t numLevels)
+    {
+        return (NumWords(numLevels) + 63) / 64;
+    }
+
+public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    explicit PriceBitmap(size_t numLevels)
+        : storage(NumWords(numLevels) + NumSummaryWords(numLevels)),
+          words(storage.data(), NumWords(numLevels)),
+          summary(storage.data() + NumWords(numLevels), NumSummaryWords(numLevels)) {}
+
+    PriceBitmap(size_t numLevels, HugePageArena & arena)
+        : words(arena.Allocate<uint64_t>(NumWords(numLevels)), NumWords(numLevels)),
+          summary(arena.Allocate<uint64_t>(NumSummaryWords(numLevels)), NumSummaryWords(numLevels)) {}
+
+    PriceBitmap(const PriceBitmap&) = delete;
+    PriceBitmap& operator=(const PriceBitmap&) = delete;
+
+    // Arena bytes for the words of a bitmap of `numLevels`
+    static constexpr size_t BytesFor(size_t numLevels)
+    {
+        return HugePageArena::BytesFor<uint64_t>(NumWords(numLevels)) + HugePageArena::BytesFor<uint64_t>(NumSummaryWords(numLevels));
+    }
+
+    void Set(uint32_t price)
+    {
+        words[price >> 6] |= 1ull << (price & 63);
+        summary[price >> 12] |= 1ull << ((price >> 6) & 63);
+    }
+
+    void Clear(uint32_t price)
+    {
+        auto & word = words[price >> 6];
+        word &= ~(1ull << (price & 63));
+        if (word == 0)
+            summary[price >> 12] &= ~(1ull << ((price >> 6) & 63));
+    }
+
+    // Lowest set price at or above `price`, NONE if there is none
+    uint32_t NextSet(uint32_t price) const
+    {
+        size_t wordIdx = price >> 6;
+        if (wordIdx >= words.size())
+            return NONE;
+
+        if (uint64_t bits = words[wordIdx] & (~0ull << (price & 63)))
+            return (wordIdx << 6) + std::countr_zero(bits);
+
+        size_t next = wordIdx + 1;
+        for (size_t i = next >> 6; i < summary.size(); i++)
+        {
+            uint64_t bits = summary[i];
+            if (i == next >> 6)
+                bits &= ~0ull << (next & 63);
+            if (bits)
+            {
+                size_t found = (i << 6) + std::countr_zero(bits);
+                return (found << 6) + std::countr_zero(words[found]);
+            }
+        }
+        return NONE;
+    }
+
+    // Highest set price at or below `price`, NONE if there is none
+    uint32_t PrevSet(uint32_t price) const
+    {
+        size_t wordIdx = price >> 6;
+        if (uint64_t bits = words[wordIdx] & (~0ull >> (63 - (price & 63))))
+            return (wordIdx << 6) + 63 - std::countl_zero(bits);
+
+        if (wordIdx == 0)
+            return NONE;
+
+        size_t prev = wordIdx - 1;
+        for (size_t i = (prev >> 6) + 1; i-- > 0;)
+        {
+            uint64_t bits = summary[i];
+            if (i == prev >> 6)
+                bits &= ~0ull >> (63 - (prev & 63));
+            if (bits)
+            {
+                size_t found = (i << 6) + 63 - std::countl_zero(bits);
+                return (found << 6) + 63 - std::countl_zero(words[found]);
+            }
+        }
+        return NONE;
+    }
+};
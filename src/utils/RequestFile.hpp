@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "RequestRecord.hpp"
+
+// Request file layout: RequestFileHeader followed by `count` packed RequestRecords.
+struct RequestFileHeader
+{
+    static constexpr char MAGIC[8] = { 'E', 'X', 'C', 'H', 'R', 'E', 'Q', 'S' };
+    static constexpr uint32_t VERSION = 6;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t count;
+};
+
+inline void WriteRequestFile(const std::string & path, std::span<const RequestRecord> records)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+        throw std::runtime_error{ "Failed to open request file for writing: " + path };
+
+    RequestFileHeader header;
+    memcpy(header.magic, RequestFileHeader::MAGIC, sizeof(header.magic));
+    header.version = RequestFileHeader::VERSION;
+    header.recordSize = sizeof(RequestRecord);
+    header.count = records.size();
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(records.data()), records.size_bytes());
+    if (!out)
+        throw std::runtime_error{ "Failed to write request file: " + path };
+}
+
+// Read-only memory mapping of a request file. Pages are populated up front so that replay
+// does not take page faults on the gateway thread.
+class RequestFile
+{
+private:
+    void* mapping = MAP_FAILED;
+    size_t mappingSize = 0;
+    std::span<const RequestRecord> records;
+
+public:
+    explicit RequestFile(const std::string & path)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd == -1)
+            throw std::runtime_error{ "Failed to open request file: " + path };
+
+        struct stat st;
+        if (fstat(fd, &st) == -1 || st.st_size < (off_t)sizeof(RequestFileHeader))
+        {
+            close(fd);
+            throw std::runtime_error{ "Invalid request file: " + path };
+        }
+
+        mappingSize = st.st_size;
+        mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED)
+            throw std::runtime_error{ "Failed to mmap request file: " + path };
+
+        auto header = static_cast<const RequestFileHeader*>(mapping);
+        if (memcmp(header->magic, RequestFileHeader::MAGIC, sizeof(header->magic)) != 0
+            || header->version != RequestFileHeader::VERSION
+            || header->recordSize != sizeof(RequestRecord)
+            || sizeof(RequestFileHeader) + header->count * sizeof(RequestRecord) > mappingSize)
+        {
+            munmap(mapping, mappingSize);
+            throw std::runtime_error{ "Unsupported request file format: " + path };
+        }
+
+        auto first = reinterpret_cast<const RequestRecord*>(static_cast<const char*>(mapping) + sizeof(RequestFileHeader));
+        records = { first, header->count };
+        madvise(mapping, mappingSize, MADV_SEQUENTIAL);
+    }
+
+    RequestFile(const RequestFile&) = delete;
+    RequestFile& operator=(const RequestFile&) = delete;
+
+    ~RequestFile()
+    {
+        if (mapping != MAP_FAILED)
+            munmap(mapping, mappingSize);
+    }
+
+    std::span<const RequestRecord> Records() const
+    {
+        return records;
+    }
+};
@@ -1,26 +1,82 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <span>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "HugePageArena.hpp"
 
 template <class T>
 class SPSCQueue
 {
 private:
+    HugePageArena arena;
     T* data;
     size_t size;
     std::atomic<size_t> head;
     std::atomic<size_t> tail;
 
+    // Only touched by consumers that block (see WaitForData) and by producers to check for them
+    alignas(64) std::atomic<uint32_t> consumerSleeping{ 0 };
+    std::atomic<uint32_t> wakeups{ 0 };
+
+    void WakeConsumer()
+    {
+        if (consumerSleeping.load(std::memory_order_relaxed))
+        {
+            wakeups.fetch_add(1, std::memory_order_release);
+            syscall(SYS_futex, &wakeups, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+        }
+    }
+
 public:
-    SPSCQueue(size_t size_) : size(size_), head(0), tail(0)
+    SPSCQueue(size_t size_) : arena(HugePageArena::BytesFor<T>(size_)), size(size_), head(0), tail(0)
     {
-        data = new T[size];
+        data = arena.Allocate<T>(size);
+        std::uninitialized_default_construct_n(data, size);
     }
 
     ~SPSCQueue()
     {
-        delete[] data;
+        std::destroy_n(data, size);
+    }
+
+    void Prefault(const WarmupOptions & options)
+    {
+        arena.Prefault(options);
+    }
+
+    // Slot `offset` places ahead of the write index, for producers that fill several slots
+    // before publishing them with UpdateWriteIndex(count). Null when the ring has no room.
+    T* GetWriteIndex(size_t offset)
+    {
+        auto currHead = head.load(std::memory_order_relaxed);
+        auto currTail = tail.load(std::memory_order_acquire);
+        auto used = currHead >= currTail ? currHead - currTail : currHead + size - currTail;
+        if (used + offset + 1 >= size)
+            return nullptr;
+
+        auto index = currHead + offset;
+        if (index >= size)
+            index -= size;
+        return &data[index];
+    }
+
+    void UpdateWriteIndex(size_t count)
+    {
+        auto nextHead = head.load(std::memory_order_relaxed) + count;
+        if (nextHead >= size)
+            nextHead -= size;
+        head.store(nextHead, std::memory_order_release);
+        WakeConsumer();
     }
 
     T* GetWriteIndex()
@@ -43,6 +99,7 @@ public:
         if (nextHead >= size)
             nextHead = 0;
         head.store(nextHead, std::memory_order_release);
+        WakeConsumer();
     }
 
     T* GetReadIndex()
@@ -63,8 +120,58 @@ public:
         tail.store(nextTail, std::memory_order_release);
     }
 
+    // Number of elements the consumer can read right now
+    size_t ReadAvailable()
+    {
+        auto currTail = tail.load(std::memory_order_relaxed);
+        auto currHead = head.load(std::memory_order_acquire);
+        return currHead >= currTail ? currHead - currTail : currHead + size - currTail;
+    }
+
+    // Up to `maxCount` readable elements that are contiguous in memory, from the read index
+    // up to the producer or the end of the ring, whichever comes first
+    std::span<T> ReadSpan(size_t maxCount)
+    {
+        auto currTail = tail.load(std::memory_order_relaxed);
+        auto count = std::min({ ReadAvailable(), size - currTail, maxCount });
+        return std::span<T>(data + currTail, count);
+    }
+
+    // Releases `count` elements at once
+    void UpdateReadIndex(size_t count)
+    {
+        auto nextTail = tail.load(std::memory_order_relaxed) + count;
+        if (nextTail >= size)
+            nextTail -= size;
+        tail.store(nextTail, std::memory_order_release);
+    }
+
     bool IsEmpty()
     {
         return tail.load() == head.load();
     }
+
+    // Blocks the consumer until the producer publishes or the timeout expires. The producer
+    // only does a relaxed check for a sleeping consumer, so a wakeup racing with going to
+    // sleep can be missed; the timeout bounds the cost of that instead of a full fence on
+    // every write.
+    void WaitForData(uint64_t timeoutNs)
+    {
+        uint32_t seen = wakeups.load(std::memory_order_acquire);
+        consumerSleeping.store(1, std::memory_order_seq_cst);
+
+        if (IsEmpty())
+        {
+            timespec timeout{ static_cast<time_t>(timeoutNs / 1'000'000'000), static_cast<long>(timeoutNs % 1'000'000'000) };
+            syscall(SYS_futex, &wakeups, FUTEX_WAIT_PRIVATE, seen, &timeout, nullptr, 0);
+        }
+
+        consumerSleeping.store(0, std::memory_order_relaxed);
+    }
+
+    // Address the producer writes on every publish, for monitor/wait style idling
+    const void* WriteIndexAddress() const
+    {
+        return &head;
+    }
 };
\ No newline at end of file
@@ -6,8 +6,19 @@
 #include <sched.h>
 #include <pthread.h>
 
-void PinThread(int cpuId)
+// CPU each pipeline thread is pinned to, -1 leaves the thread unpinned.
+struct CpuConfig
 {
+    int gatewayCpu = 5;
+    int engineCpu = 3;
+    int publisherCpu = 6;
+};
+
+inline void PinThread(int cpuId)
+{
+    if (cpuId < 0)
+        return;
+
     cpu_set_t cpuset;
     CPU_ZERO(&cpuset);
     CPU_SET(cpuId, &cpuset);
@@ -17,4 +28,32 @@ void PinThread(int cpuId)
     int rc = pthread_setaffinity_np(thread, sizeof(cpu_set_t), &cpuset);
     if (rc != 0)
         std::cerr << "Error calling pthread_setaffinity_np: " << rc << "\n";
-}
\ No newline at end of file
+}
+
+// Temporarily runs the calling thread on the given CPU. Memory allocated and first touched
+// inside the scope lands on that CPU's NUMA node.
+class ScopedAffinity
+{
+private:
+    cpu_set_t previous;
+    bool restore = false;
+
+public:
+    explicit ScopedAffinity(int cpuId)
+    {
+        if (cpuId < 0)
+            return;
+
+        restore = pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &previous) == 0;
+        PinThread(cpuId);
+    }
+
+    ScopedAffinity(const ScopedAffinity&) = delete;
+    ScopedAffinity& operator=(const ScopedAffinity&) = delete;
+
+    ~ScopedAffinity()
+    {
+        if (restore)
+            pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &previous);
+    }
+};
@@ -1,8 +1,15 @@
 #pragma once
 #include <cstdint>
 #include <chrono>
-#include <thread>
+#include <fstream>
+#include <string_view>
 
+#include <cpuid.h>
+
+// TSC reads and cycle <-> ns conversion. The TSC frequency is found once at program start:
+// from CPUID leaf 0x15 (TSC / crystal ratio and crystal frequency), else the nominal frequency
+// of leaf 0x16, else the kernel's tsc_freq_khz, else a 10 ms measurement against
+// steady_clock. Conversions are a 64x64 -> 128 bit multiply and a shift.
 class Timer
 {
 public:
@@ -13,26 +20,119 @@ public:
         return ((uint64_t)hi << 32) | lo;
     }
 
+    // Start of a measured window: earlier instructions complete before the TSC is read
+    static inline uint64_t rdtsc_fenced()
+    {
+        unsigned int lo, hi;
+        __asm__ __volatile__ ("lfence\n\trdtsc" : "=a" (lo), "=d" (hi) :: "memory");
+        return ((uint64_t)hi << 32) | lo;
+    }
+
+    // End of a measured window: waits for earlier instructions, and later ones do not start
+    // before the TSC is read
+    static inline uint64_t rdtscp()
+    {
+        unsigned int lo, hi, aux;
+        __asm__ __volatile__ ("rdtscp\n\tlfence" : "=a" (lo), "=d" (hi), "=c" (aux) :: "memory");
+        return ((uint64_t)hi << 32) | lo;
+    }
+
     static uint64_t cycles_to_ns(uint64_t cycles)
     {
-        static const double ns_per_cycle = EstimateNsPerCycle();
-        return static_cast<uint64_t>(cycles * ns_per_cycle);
+        return static_cast<uint64_t>((static_cast<unsigned __int128>(cycles) * calibration.nsPerCycle) >> FIXED_POINT_SHIFT);
+    }
+
+    static uint64_t ns_to_cycles(uint64_t ns)
+    {
+        return static_cast<uint64_t>((static_cast<unsigned __int128>(ns) * calibration.cyclesPerNs) >> FIXED_POINT_SHIFT);
+    }
+
+    static uint64_t tsc_hz()
+    {
+        return calibration.hz;
+    }
+
+    // Where tsc_hz came from: "cpuid 0x15", "cpuid 0x16", "sysfs" or "measured"
+    static std::string_view calibration_source()
+    {
+        return calibration.source;
+    }
+
+    // The TSC ticks at a constant rate through frequency changes and C-states (CPUID
+    // 0x80000007 EDX bit 8). Without it cycle counts do not convert to time.
+    static bool invariant_tsc()
+    {
+        return calibration.invariant;
     }
 
 private:
-    static double EstimateNsPerCycle()
+    static constexpr int FIXED_POINT_SHIFT = 32;
+
+    struct Calibration
     {
-        auto start_time = std::chrono::steady_clock::now();
-        uint64_t start_cycle = rdtsc();
+        uint64_t hz;
+        std::string_view source;
+        bool invariant;
+        uint64_t nsPerCycle;  // ns per cycle << FIXED_POINT_SHIFT
+        uint64_t cyclesPerNs; // cycles per ns << FIXED_POINT_SHIFT
+    };
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    static uint64_t CpuidHz(std::string_view & source)
+    {
+        unsigned int eax, ebx, ecx, edx;
+        if (__get_cpuid(0x15, &eax, &ebx, &ecx, &edx) && eax != 0 && ebx != 0 && ecx != 0)
+        {
+            source = "cpuid 0x15";
+            return static_cast<uint64_t>(ecx) * ebx / eax;
+        }
+        if (__get_cpuid(0x16, &eax, &ebx, &ecx, &edx) && (eax & 0xffff) != 0)
+        {
+            source = "cpuid 0x16";
+            return static_cast<uint64_t>(eax & 0xffff) * 1'000'000;
+        }
+        return 0;
+    }
 
-        auto end_time = std::chrono::steady_clock::now();
-        uint64_t end_cycle = rdtsc();
+    static uint64_t SysfsHz()
+    {
+        std::ifstream in("/sys/devices/system/cpu/cpu0/tsc_freq_khz");
+        uint64_t khz = 0;
+        return in >> khz ? khz * 1000 : 0;
+    }
 
-        auto duration_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count();
-        uint64_t cycles = end_cycle - start_cycle;
+    static uint64_t MeasuredHz()
+    {
+        auto startTime = std::chrono::steady_clock::now();
+        uint64_t startCycle = rdtsc_fenced();
+        auto endTime = startTime;
+        while (endTime - startTime < std::chrono::milliseconds(10))
+            endTime = std::chrono::steady_clock::now();
+        uint64_t endCycle = rdtscp();
+
+        auto durationNs = std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - startTime).count();
+        return static_cast<uint64_t>((endCycle - startCycle) * 1e9 / durationNs);
+    }
+
+    static Calibration Calibrate()
+    {
+        Calibration result{};
+
+        unsigned int eax, ebx, ecx, edx;
+        result.invariant = __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1u << 8));
 
-        return static_cast<double>(duration_ns) / static_cast<double>(cycles);
+        result.hz = CpuidHz(result.source);
+        if (result.hz == 0 && (result.hz = SysfsHz()) != 0)
+            result.source = "sysfs";
+        if (result.hz == 0)
+        {
+            result.hz = MeasuredHz();
+            result.source = "measured";
+        }
+
+        result.nsPerCycle = static_cast<uint64_t>(((static_cast<unsigned __int128>(1'000'000'000) << FIXED_POINT_SHIFT) + result.hz / 2) / result.hz);
+        result.cyclesPerNs = static_cast<uint64_t>(((static_cast<unsigned __int128>(result.hz) << FIXED_POINT_SHIFT) + 500'000'000) / 1'000'000'000);
+        return result;
     }
+
+    static inline const Calibration calibration = Calibrate();
 };
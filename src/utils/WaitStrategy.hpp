@@ -0,0 +1,141 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <immintrin.h>
+
+#include "Timer.hpp"
+
+// Consumer idle policies, selected per thread through a template parameter. Idle() is called
+// every time the consumer finds its queue empty and Reset() once it has work again.
+
+// Lowest wakeup latency, burns the whole core.
+struct BusySpinWait
+{
+    template<typename Queue>
+    void Idle(Queue & queue)
+    {
+        _mm_pause();
+    }
+
+    void Reset() {}
+};
+
+// Spins for a while, then gives the core to other threads between polls.
+template<uint32_t SpinLimit = 10'000>
+struct SpinYieldWaitT
+{
+    uint32_t spins = 0;
+
+    template<typename Queue>
+    void Idle(Queue & queue)
+    {
+        if (spins < SpinLimit)
+        {
+            spins++;
+            _mm_pause();
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    void Reset()
+    {
+        spins = 0;
+    }
+};
+using SpinYieldWait = SpinYieldWaitT<>;
+
+// Spins for a while, then sleeps in the kernel until the producer wakes it up.
+template<uint32_t SpinLimit = 10'000, uint64_t TimeoutNs = 1'000'000>
+struct SpinFutexWaitT
+{
+    uint32_t spins = 0;
+
+    template<typename Queue>
+    void Idle(Queue & queue)
+    {
+        if (spins < SpinLimit)
+        {
+            spins++;
+            _mm_pause();
+        }
+        else
+        {
+            queue.WaitForData(TimeoutNs);
+        }
+    }
+
+    void Reset()
+    {
+        spins = 0;
+    }
+};
+using SpinFutexWait = SpinFutexWaitT<>;
+
+// Spins for a while, then parks the core in a light C0.x state with umonitor/umwait until the
+// producer writes the queue index. Needs WAITPKG (-march=native on Tremont, Alder Lake,
+// Sapphire Rapids and later), otherwise it keeps spinning.
+template<uint32_t SpinLimit = 10'000, uint64_t TimeoutNs = 100'000>
+struct SpinUmwaitWaitT
+{
+    uint32_t spins = 0;
+
+    template<typename Queue>
+    void Idle(Queue & queue)
+    {
+        if (spins < SpinLimit)
+        {
+            spins++;
+            _mm_pause();
+            return;
+        }
+#ifdef __WAITPKG__
+        static const uint64_t timeoutCycles = Timer::ns_to_cycles(TimeoutNs);
+        _umonitor(const_cast<void*>(queue.WriteIndexAddress()));
+        if (queue.IsEmpty())
+            _umwait(0, Timer::rdtsc() + timeoutCycles);
+#else
+        _mm_pause();
+#endif
+    }
+
+    void Reset()
+    {
+        spins = 0;
+    }
+};
+using SpinUmwaitWait = SpinUmwaitWaitT<>;
+
+// Spins for a while, then sleeps for exponentially growing periods capped at MaxSleepNs, which
+// bounds the wakeup latency without needing the producer's cooperation.
+template<uint32_t SpinLimit = 10'000, uint64_t MinSleepNs = 1'000, uint64_t MaxSleepNs = 1'000'000>
+struct BackoffWaitT
+{
+    uint32_t spins = 0;
+    uint64_t sleepNs = MinSleepNs;
+
+    template<typename Queue>
+    void Idle(Queue & queue)
+    {
+        if (spins < SpinLimit)
+        {
+            spins++;
+            _mm_pause();
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::nanoseconds(sleepNs));
+        sleepNs = std::min(sleepNs * 2, MaxSleepNs);
+    }
+
+    void Reset()
+    {
+        spins = 0;
+        sleepNs = MinSleepNs;
+    }
+};
+using BackoffWait = BackoffWaitT<>;
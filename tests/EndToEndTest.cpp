@@ -1,6 +1,8 @@
 #include <gtest/gtest.h>
 #include <thread>
 #include <chrono>
+#include <iomanip>
+#include <vector>
 
 #include "MatchingEngine.hpp"
 #include "OrderGateway.hpp"
@@ -15,9 +17,9 @@ TEST(EndToEndTest, ThroughputTest)
     auto inputQueue = std::make_shared<SPSCQueue<OrderRequest>>(QUEUE_SIZE);
     auto outputQueue = std::make_shared<SPSCQueue<MarketDataEvent>>(QUEUE_SIZE);
 
-    OrderGateway gateway(inputQueue, MAX_NUM_SYMBOLS, NUM_ORDERS);
+    OrderGateway gateway(inputQueue, NUM_DEFAULT_SYMBOLS, NUM_ORDERS);
     QueueOutputPolicy output(outputQueue);
-    MatchingEngine<QueueOutputPolicy> engine(inputQueue, output, MAX_NUM_SYMBOLS, NUM_ORDERS);
+    MatchingEngine<QueueOutputPolicy> engine(inputQueue, output, NUM_DEFAULT_SYMBOLS, NUM_ORDERS);
     NoOpTransmitter transmitter;
     MarketDataPublisher publisher(outputQueue, transmitter, NUM_ORDERS);
 
@@ -59,9 +61,9 @@ TEST(EndToEndTest, LatencyTest)
     auto inputQueue = std::make_shared<SPSCQueue<OrderRequest>>(QUEUE_SIZE);
     auto outputQueue = std::make_shared<SPSCQueue<MarketDataEvent>>(QUEUE_SIZE);
 
-    OrderGateway gateway(inputQueue, MAX_NUM_SYMBOLS, NUM_ORDERS);
+    OrderGateway gateway(inputQueue, NUM_DEFAULT_SYMBOLS, NUM_ORDERS);
     QueueOutputPolicy output(outputQueue);
-    MatchingEngine<QueueOutputPolicy> engine(inputQueue, output, MAX_NUM_SYMBOLS, NUM_ORDERS);
+    MatchingEngine<QueueOutputPolicy> engine(inputQueue, output, NUM_DEFAULT_SYMBOLS, NUM_ORDERS);
     NoOpTransmitter transmitter;
     MarketDataPublisher publisher(outputQueue, transmitter, NUM_ORDERS);
 
@@ -92,3 +94,58 @@ TEST(EndToEndTest, LatencyTest)
 
     latencyStats.print_stats();
 }
+
+// Open-loop variant of LatencyTest: the gateway sends on a fixed-rate schedule regardless of
+// how far behind the engine is, and latency is measured from the intended send time. Sweeping
+// the rate gives a latency vs throughput curve that shows where the pipeline saturates.
+TEST(EndToEndTest, OpenLoopLatencyTest)
+{
+    const size_t NUM_ORDERS = 200'000;
+    const size_t QUEUE_SIZE = 100'000;
+    const std::vector<double> RATES = { 100'000, 500'000, 1'000'000, 2'000'000, 5'000'000 };
+
+    std::cout << std::fixed << std::setprecision(0);
+    std::cout << "      Target    Achieved      Median         P99       P99.9         Max\n";
+
+    for (double rate : RATES)
+    {
+        auto inputQueue = std::make_shared<SPSCQueue<OrderRequest>>(QUEUE_SIZE);
+        auto outputQueue = std::make_shared<SPSCQueue<MarketDataEvent>>(QUEUE_SIZE);
+
+        OrderGateway gateway(inputQueue, NUM_DEFAULT_SYMBOLS, NUM_ORDERS);
+        QueueOutputPolicy output(outputQueue);
+        MatchingEngine<QueueOutputPolicy> engine(inputQueue, output, NUM_DEFAULT_SYMBOLS, NUM_ORDERS);
+        NoOpTransmitter transmitter;
+        MarketDataPublisher publisher(outputQueue, transmitter, NUM_ORDERS);
+
+        gateway.SetReplayMode(ReplayMode::FIXED_RATE, rate);
+
+        publisher.Start();
+        engine.Start();
+        gateway.Start();
+
+        gateway.WaitUntilFinished();
+        for (size_t i = 0; i < NUM_ORDERS; i++)
+        {
+            while (!publisher.HasProcessed(i))
+                _mm_pause();
+        }
+
+        engine.Stop();
+        publisher.Stop();
+
+        LatencyStats latencyStats;
+        for (size_t i = 10000; i < NUM_ORDERS; i++) // Warmup
+            latencyStats.record(publisher.receiveTimes[i] - gateway.scheduledTimes[i]);
+
+        uint64_t lastReceive = *std::max_element(publisher.receiveTimes.begin(), publisher.receiveTimes.end());
+        double achieved = NUM_ORDERS * 1e9 / Timer::cycles_to_ns(lastReceive - gateway.scheduledTimes[0]);
+
+        std::cout << std::setw(12) << rate
+                  << std::setw(12) << achieved
+                  << std::setw(12) << Timer::cycles_to_ns(latencyStats.percentile(0.5))
+                  << std::setw(12) << Timer::cycles_to_ns(latencyStats.percentile(0.99))
+                  << std::setw(12) << Timer::cycles_to_ns(latencyStats.percentile(0.999))
+                  << std::setw(12) << Timer::cycles_to_ns(latencyStats.percentile(1.0)) << " ns\n";
+    }
+}
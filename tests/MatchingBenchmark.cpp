@@ -1,11 +1,22 @@
 #include <iostream>
 #include <chrono>
+#include <filesystem>
+#include <fstream>
 #include <thread>
 #include <random>
 
 #include <benchmark/benchmark.h>
 
 #include "MatchingEngine.hpp"
+#include "ItchEncoder.hpp"
+#include "MarketDataPublisher.hpp"
+#include "IoUringTransmitter.hpp"
+#include "FeedCapture.hpp"
+#include "FeedDecoder.hpp"
+#include "FeedArbitrator.hpp"
+#include "ScenarioGenerator.hpp"
+#include "LatencyStats.hpp"
+#include "PerfCounters.hpp"
 #include "Timer.hpp"
 
 static void BM_InsertOrderFixed(benchmark::State& state)
@@ -123,6 +134,75 @@ static void BM_MatchOrder(benchmark::State& state)
 
 BENCHMARK(BM_MatchOrder)->UseManualTime()->Arg(1)->Arg(10)->Arg(100);
 
+// A fat-finger market order against a ladder of N one-order levels, without a price band and
+// with a band of 10 ticks. The band caps the levels one request can walk, and the halt it trips
+// ends the request. The ladder is cleared between iterations.
+static void BM_MatchOrderBanded(benchmark::State& state)
+{
+    NoOpOutputPolicy output;
+    MatchingEngine engine(output, 1, 2'000'000);
+
+    const uint32_t levels = state.range(0);
+    const uint32_t band = state.range(1);
+    const uint32_t referencePrice = 15000;
+    engine.SetPriceBand(0, band, referencePrice);
+
+    uint64_t orderId = 0;
+    for (auto _ : state)
+    {
+        for (uint32_t i = 0; i < levels; i++)
+        {
+            Order sell(orderId++, 0, Side::SELL, OrderType::LIMIT, 10, referencePrice + 1 + i);
+            engine.SubmitOrder(&sell);
+        }
+
+        Order buy(orderId++, 0, Side::BUY, OrderType::MARKET, levels * 10, 0);
+
+        uint64_t start = Timer::rdtsc();
+        engine.SubmitOrder(&buy);
+        uint64_t end = Timer::rdtsc();
+
+        state.SetIterationTime(Timer::cycles_to_ns(end - start) / 1e9);
+
+        engine.GetBook(0)->Reset();
+    }
+}
+
+BENCHMARK(BM_MatchOrderBanded)->ArgNames({ "levels", "band" })->ArgsProduct({ { 100, 1'000, 10'000 }, { 0, 10 } })->UseManualTime()->Iterations(100)->Unit(benchmark::kMicrosecond);
+
+// One aggressive order sweeping a single level N orders deep, the walk is bound by how many
+// cache lines each resting order costs.
+static void BM_MatchDeepLevel(benchmark::State& state)
+{
+    NoOpOutputPolicy output;
+    MatchingEngine engine(output);
+
+    const size_t depth = state.range(0);
+    const uint32_t quantityPerOrder = 10;
+
+    uint64_t buyId = 10'000'000;
+
+    for (auto _ : state)
+    {
+        for (size_t i = 0; i < depth; i++)
+        {
+            Order sell(i, 0, Side::SELL, OrderType::LIMIT, quantityPerOrder, 15000);
+            engine.SubmitOrder(&sell);
+        }
+
+        Order buy(buyId++, 0, Side::BUY, OrderType::MARKET, depth * quantityPerOrder, 0);
+
+        uint64_t start = Timer::rdtsc();
+        engine.SubmitOrder(&buy);
+        uint64_t end = Timer::rdtsc();
+
+        state.SetIterationTime(Timer::cycles_to_ns(end - start) / 1e9);
+    }
+    state.counters["ns_per_order"] = benchmark::Counter(state.iterations() * depth, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+BENCHMARK(BM_MatchDeepLevel)->UseManualTime()->Arg(1'000)->Arg(10'000)->Arg(100'000);
+
 static void BM_CancelOrder(benchmark::State& state)
 {
     NoOpOutputPolicy output;
@@ -161,4 +241,977 @@ static void BM_CancelOrder(benchmark::State& state)
 
 BENCHMARK(BM_CancelOrder)->UseManualTime()->Arg(1)->Arg(1000)->Arg(1000000)->Iterations(1000000);
 
+// Same book as BM_CancelOrder, cancels go through CancelBatch 8 at a time. Time is per cancel.
+static void BM_CancelOrderBatch(benchmark::State& state)
+{
+    NoOpOutputPolicy output;
+    MatchingEngine engine(output);
+
+    const size_t batchSize = 8;
+    auto levels = state.range(0);
+    size_t ordersPerLevel = 1'000'000 / levels;
+    std::vector<CancelRequest> cancels;
+    cancels.reserve(levels * ordersPerLevel);
+    for (int i = 0; i < levels; ++i)
+    {
+        for (int j = 0; j < ordersPerLevel; j++)
+        {
+            Order order(i * ordersPerLevel + j, 0, Side::SELL, OrderType::LIMIT, 100, (uint32_t) i + 1);
+            engine.SubmitOrder(&order);
+            cancels.push_back(CancelRequest{ i * ordersPerLevel + j, i * ordersPerLevel + j, 0 });
+        }
+    }
+
+    std::mt19937 gen(std::random_device{}());
+    std::shuffle(cancels.begin(), cancels.end(), gen);
+
+    size_t index = 0;
+    for (auto _ : state)
+    {
+        uint64_t start = Timer::rdtsc();
+        engine.CancelBatch(std::span(cancels.data() + index, batchSize));
+        uint64_t end = Timer::rdtsc();
+
+        index += batchSize;
+        state.SetIterationTime(Timer::cycles_to_ns(end - start) / batchSize / 1e9);
+    }
+}
+
+BENCHMARK(BM_CancelOrderBatch)->UseManualTime()->Arg(1)->Arg(1000)->Arg(1000000)->Iterations(1000000 / 8);
+
+static void BM_Scenario(benchmark::State& state, Scenario scenario)
+{
+    const size_t numRequests = 500'000;
+    const size_t numSymbols = 10;
+    auto records = GenerateScenario(ScenarioConfig::Preset(scenario, numRequests, numSymbols));
+
+    for (auto _ : state)
+    {
+        NoOpOutputPolicy output;
+        MatchingEngine engine(output, numSymbols, numRequests);
+        LatencyStats latencies;
+        uint64_t totalCycles = 0;
+
+        OrderRequest req;
+        for (const auto & record : records)
+        {
+            record.Decode(req);
+
+            uint64_t start = Timer::rdtsc();
+            engine.ProcessRequest(req);
+            uint64_t end = Timer::rdtsc();
+
+            latencies.record(end - start);
+            totalCycles += end - start;
+        }
+
+        state.SetIterationTime(Timer::cycles_to_ns(totalCycles) / 1e9);
+        state.counters["p50_ns"] = Timer::cycles_to_ns(latencies.percentile(0.5));
+        state.counters["p99_ns"] = Timer::cycles_to_ns(latencies.percentile(0.99));
+        state.counters["p99.9_ns"] = Timer::cycles_to_ns(latencies.percentile(0.999));
+        state.counters["max_ns"] = Timer::cycles_to_ns(latencies.percentile(1.0));
+    }
+
+    state.SetItemsProcessed(state.iterations() * numRequests);
+}
+
+BENCHMARK_CAPTURE(BM_Scenario, uniform, Scenario::UNIFORM)->UseManualTime()->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Scenario, zipf, Scenario::ZIPF)->UseManualTime()->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Scenario, bursty, Scenario::BURSTY)->UseManualTime()->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Scenario, market_maker, Scenario::MARKET_MAKER)->UseManualTime()->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Scenario, trending, Scenario::TRENDING)->UseManualTime()->Iterations(1)->Unit(benchmark::kMillisecond);
+
+// N engines, each on its own thread with its own 10 symbols, replaying the same 500'000
+// generated requests. Engines share no writable state, so throughput should grow with N as
+// long as there are cores for the threads.
+static void BM_ParallelEngines(benchmark::State& state)
+{
+    const size_t numEngines = state.range(0);
+    const size_t numRequests = 500'000;
+    const size_t numSymbols = 10;
+    auto records = GenerateScenario(ScenarioConfig::Preset(Scenario::UNIFORM, numRequests, numSymbols));
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        std::vector<std::unique_ptr<NoOpOutputPolicy>> outputs;
+        std::vector<std::unique_ptr<MatchingEngine<NoOpOutputPolicy>>> engines;
+        std::vector<std::vector<OrderRequest>> requests(numEngines, std::vector<OrderRequest>(records.size()));
+        for (size_t e = 0; e < numEngines; e++)
+        {
+            outputs.push_back(std::make_unique<NoOpOutputPolicy>());
+            engines.push_back(std::make_unique<MatchingEngine<NoOpOutputPolicy>>(*outputs.back(), numSymbols, numRequests));
+            for (size_t i = 0; i < records.size(); i++)
+                records[i].Decode(requests[e][i]);
+        }
+        state.ResumeTiming();
+
+        std::vector<std::thread> threads;
+        for (size_t e = 0; e < numEngines; e++)
+            threads.emplace_back([&, e] {
+                for (auto & req : requests[e])
+                    engines[e]->ProcessRequest(req);
+            });
+        for (auto & thread : threads)
+            thread.join();
+    }
+
+    state.SetItemsProcessed(state.iterations() * numEngines * numRequests);
+}
+
+BENCHMARK(BM_ParallelEngines)->ArgName("engines")->Arg(1)->Arg(2)->Arg(4)->UseRealTime()->Iterations(3)->Unit(benchmark::kMillisecond);
+
+// First requests after start-up, with and without the warm-up phase.
+static void BM_FirstOrders(benchmark::State& state)
+{
+    const size_t numRequests = 50'000;
+    const size_t numSymbols = 10;
+    auto records = GenerateScenario(ScenarioConfig::Preset(Scenario::UNIFORM, numRequests, numSymbols));
+
+    for (auto _ : state)
+    {
+        NoOpOutputPolicy output;
+        MatchingEngine engine(output, numSymbols, numRequests);
+        if (state.range(0))
+            engine.WarmUp();
+
+        LatencyStats latencies;
+        uint64_t totalCycles = 0;
+        auto dtlbMisses = PerfCounter::DtlbLoadMisses();
+
+        OrderRequest req;
+        dtlbMisses.Start();
+        for (const auto & record : records)
+        {
+            record.Decode(req);
+
+            uint64_t start = Timer::rdtsc();
+            engine.ProcessRequest(req);
+            uint64_t end = Timer::rdtsc();
+
+            latencies.record(end - start);
+            totalCycles += end - start;
+        }
+        uint64_t misses = dtlbMisses.Stop();
+
+        state.SetIterationTime(Timer::cycles_to_ns(totalCycles) / 1e9);
+        state.counters["p99_ns"] = Timer::cycles_to_ns(latencies.percentile(0.99));
+        state.counters["max_ns"] = Timer::cycles_to_ns(latencies.percentile(1.0));
+        state.counters["dtlb_misses"] = dtlbMisses.IsValid() ? static_cast<double>(misses) : -1.0;
+    }
+}
+
+BENCHMARK(BM_FirstOrders)->ArgName("warmup")->Arg(0)->Arg(1)->UseManualTime()->Iterations(1);
+
+// Insert and cancel latency against a book holding N live orders spread over the ladder, where
+// order lookups and list walks are spread over gigabytes and TLB reach matters.
+static void BM_LargeBook(benchmark::State& state)
+{
+    const size_t numLive = state.range(0);
+    const size_t numOps = 100'000;
+
+    for (auto _ : state)
+    {
+        NoOpOutputPolicy output;
+        OrderStore<uint32_t> store(numLive + numOps);
+        StopStore stopStore(numLive + numOps);
+        OrderBook book(0, "LARGE", store, stopStore);
+        book.Prefault({});
+        store.Prefault({});
+
+        std::mt19937 gen(42);
+        std::uniform_int_distribution<uint32_t> priceDist(1, book.NumPriceLevels() / 2);
+        for (size_t i = 0; i < numLive; i++)
+        {
+            Order order(i, 0, Side::BUY, OrderType::LIMIT, 100, priceDist(gen));
+            book.MatchOrder(&order, output);
+        }
+
+        std::uniform_int_distribution<uint64_t> idDist(0, numLive - 1);
+        LatencyStats insertLatencies;
+        LatencyStats cancelLatencies;
+        uint64_t totalCycles = 0;
+        auto dtlbMisses = PerfCounter::DtlbLoadMisses();
+
+        dtlbMisses.Start();
+        for (size_t i = 0; i < numOps; i++)
+        {
+            Order order(numLive + i, 0, Side::BUY, OrderType::LIMIT, 100, priceDist(gen));
+            uint64_t targetId = idDist(gen);
+
+            uint64_t start = Timer::rdtsc();
+            book.MatchOrder(&order, output);
+            uint64_t mid = Timer::rdtsc();
+            book.CancelOrder(targetId, targetId, output);
+            uint64_t end = Timer::rdtsc();
+
+            insertLatencies.record(mid - start);
+            cancelLatencies.record(end - mid);
+            totalCycles += end - start;
+        }
+        uint64_t misses = dtlbMisses.Stop();
+
+        state.SetIterationTime(Timer::cycles_to_ns(totalCycles) / 1e9);
+        state.counters["insert_p50_ns"] = Timer::cycles_to_ns(insertLatencies.percentile(0.5));
+        state.counters["insert_p99_ns"] = Timer::cycles_to_ns(insertLatencies.percentile(0.99));
+        state.counters["cancel_p50_ns"] = Timer::cycles_to_ns(cancelLatencies.percentile(0.5));
+        state.counters["cancel_p99_ns"] = Timer::cycles_to_ns(cancelLatencies.percentile(0.99));
+        state.counters["dtlb_misses_per_op"] = dtlbMisses.IsValid() ? static_cast<double>(misses) / (2 * numOps) : -1.0;
+        state.counters["huge_page_kb"] = (book.HugePageSize() + store.HugePageSize()) / 1024;
+    }
+}
+
+BENCHMARK(BM_LargeBook)->Arg(1'000'000)->Arg(10'000'000)->UseManualTime()->Iterations(1)->Unit(benchmark::kMillisecond);
+
+// Bursts of generated requests into a queue output, handled one request at a time (0) or
+// through SubmitBatch with a batch of N. The output ring is drained between bursts.
+static void BM_SubmitBurst(benchmark::State& state)
+{
+    const size_t batchSize = state.range(0);
+    const size_t burstSize = 4096;
+    const size_t numSymbols = 10;
+    const size_t numRequests = 200'000;
+
+    auto records = GenerateScenario(ScenarioConfig::Preset(Scenario::UNIFORM, numRequests, numSymbols));
+
+    for (auto _ : state)
+    {
+        std::vector<OrderRequest> requests(records.size());
+        for (size_t i = 0; i < records.size(); i++)
+            records[i].Decode(requests[i]);
+
+        auto queue = std::make_shared<SPSCQueue<MarketDataEvent>>(1 << 16);
+        QueueOutputPolicy output(queue);
+        MatchingEngine engine(output, numSymbols, numRequests);
+
+        uint64_t totalCycles = 0;
+        for (size_t start = 0; start < requests.size(); start += burstSize)
+        {
+            auto burst = std::span(requests).subspan(start, std::min(burstSize, requests.size() - start));
+
+            uint64_t begin = Timer::rdtsc();
+            if (batchSize == 0)
+            {
+                for (auto & req : burst)
+                    engine.ProcessRequest(req);
+            }
+            else
+            {
+                for (size_t i = 0; i < burst.size(); i += batchSize)
+                    engine.SubmitBatch(burst.subspan(i, std::min(batchSize, burst.size() - i)));
+            }
+            totalCycles += Timer::rdtsc() - begin;
+
+            output.Discard();
+        }
+
+        state.SetIterationTime(Timer::cycles_to_ns(totalCycles) / 1e9);
+    }
+    state.SetItemsProcessed(state.iterations() * numRequests);
+}
+
+BENCHMARK(BM_SubmitBurst)->ArgName("batch")->Arg(0)->Arg(8)->Arg(32)->UseManualTime()->Iterations(5)->Unit(benchmark::kMillisecond);
+
+enum class QuoteUpdate { CANCEL_NEW, MODIFY };
+
+// A market maker keeps 1'000 quotes per side and updates a random one on each iteration,
+// half the time reducing its size and half the time moving it one tick. Either as a cancel
+// followed by a new order, or as a single modify.
+static void BM_QuoteUpdate(benchmark::State& state, QuoteUpdate mode)
+{
+    NoOpOutputPolicy output;
+    MatchingEngine engine(output);
+
+    const size_t numQuotes = 1'000;
+    struct Quote { uint64_t id; Side side; uint32_t quantity; uint32_t price; };
+    std::vector<Quote> quotes;
+    uint64_t nextId = 0;
+    for (size_t i = 0; i < numQuotes; i++)
+    {
+        Side side = i % 2 ? Side::BUY : Side::SELL;
+        uint32_t price = side == Side::BUY ? 14990 - i % 50 : 15010 + i % 50;
+        Order order(nextId, 0, side, OrderType::LIMIT, 1'000'000, price);
+        engine.SubmitOrder(&order);
+        quotes.push_back({ nextId++, side, 1'000'000, price });
+    }
+
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<size_t> quoteDist(0, numQuotes - 1);
+
+    for (auto _ : state)
+    {
+        auto & quote = quotes[quoteDist(gen)];
+        if (gen() % 2 && quote.quantity > 1)
+            quote.quantity--;
+        else
+            quote.price += (quote.side == Side::BUY ? -1 : 1) * (gen() % 2 ? 1 : -1);
+
+        uint64_t start = Timer::rdtsc();
+        if (mode == QuoteUpdate::MODIFY)
+        {
+            engine.ModifyOrder(quote.id, quote.quantity, quote.price);
+        }
+        else
+        {
+            engine.CancelOrder(quote.id);
+            quote.id = nextId++;
+            Order order(quote.id, 0, quote.side, OrderType::LIMIT, quote.quantity, quote.price);
+            engine.SubmitOrder(&order);
+        }
+        uint64_t end = Timer::rdtsc();
+
+        state.SetIterationTime(Timer::cycles_to_ns(end - start) / 1e9);
+    }
+}
+
+BENCHMARK_CAPTURE(BM_QuoteUpdate, cancel_new, QuoteUpdate::CANCEL_NEW)->UseManualTime()->Iterations(1'000'000);
+BENCHMARK_CAPTURE(BM_QuoteUpdate, modify, QuoteUpdate::MODIFY)->UseManualTime()->Iterations(1'000'000);
+
+enum class KillSwitch { CANCEL_EACH, MASS_CANCEL };
+
+// Session 1 has N resting orders over 10 symbols and 1000 levels per side, interleaved with as
+// many orders of session 2. Measures pulling all of session 1, either as N cancels or as one
+// mass cancel.
+static void BM_MassCancel(benchmark::State& state, KillSwitch mode)
+{
+    const size_t numOrders = state.range(0);
+    const size_t numSymbols = 10;
+
+    for (auto _ : state)
+    {
+        NoOpOutputPolicy output;
+        MatchingEngine engine(output, numSymbols, 2 * numOrders);
+
+        for (size_t i = 0; i < 2 * numOrders; i++)
+        {
+            Side side = i % 4 < 2 ? Side::BUY : Side::SELL;
+            uint32_t price = side == Side::BUY ? 14999 - i / 4 % 1000 : 15001 + i / 4 % 1000;
+            Order order(i, i / 2 % numSymbols, side, OrderType::LIMIT, 100, price, 1 + i % 2);
+            engine.SubmitOrder(&order);
+        }
+
+        uint64_t start = Timer::rdtsc();
+        if (mode == KillSwitch::MASS_CANCEL)
+        {
+            engine.MassCancel({ .requestId = 0, .sessionId = 1 });
+        }
+        else
+        {
+            for (size_t i = 0; i < 2 * numOrders; i += 2)
+                engine.CancelOrder(i, 0);
+        }
+        uint64_t end = Timer::rdtsc();
+
+        state.SetIterationTime(Timer::cycles_to_ns(end - start) / 1e9);
+    }
+}
+
+BENCHMARK_CAPTURE(BM_MassCancel, cancel_each, KillSwitch::CANCEL_EACH)->Arg(10'000)->Arg(100'000)->Arg(1'000'000)->UseManualTime()->Iterations(3)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_MassCancel, mass_cancel, KillSwitch::MASS_CANCEL)->Arg(10'000)->Arg(100'000)->Arg(1'000'000)->UseManualTime()->Iterations(3)->Unit(benchmark::kMicrosecond);
+
+enum class Liquidity { PLAIN, ICEBERG };
+
+// One market order taking a level that holds the same liquidity either as plain orders of 100
+// or as icebergs of 1'000 showing 100. Both give ten fills per 1'000 shares, the icebergs
+// refresh in place instead of each slice being a separate order.
+static void BM_IcebergSweep(benchmark::State& state, Liquidity mode)
+{
+    NoOpOutputPolicy output;
+    MatchingEngine engine(output);
+
+    const size_t icebergs = state.range(0);
+    const uint32_t display = 100;
+    const uint32_t total = 1'000;
+
+    uint64_t orderId = 0;
+    for (auto _ : state)
+    {
+        if (mode == Liquidity::ICEBERG)
+        {
+            for (size_t i = 0; i < icebergs; i++)
+            {
+                Order sell(orderId++, 0, Side::SELL, OrderType::LIMIT, total, 15000);
+                sell.displayQuantity = display;
+                engine.SubmitOrder(&sell);
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i < icebergs * total / display; i++)
+            {
+                Order sell(orderId++, 0, Side::SELL, OrderType::LIMIT, display, 15000);
+                engine.SubmitOrder(&sell);
+            }
+        }
+
+        Order buy(orderId++, 0, Side::BUY, OrderType::MARKET, icebergs * total, 0);
+
+        uint64_t start = Timer::rdtsc();
+        engine.SubmitOrder(&buy);
+        uint64_t end = Timer::rdtsc();
+
+        state.SetIterationTime(Timer::cycles_to_ns(end - start) / 1e9);
+    }
+    state.counters["ns_per_fill"] = benchmark::Counter(state.iterations() * icebergs * total / display, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+BENCHMARK_CAPTURE(BM_IcebergSweep, plain, Liquidity::PLAIN)->Arg(1'000)->Arg(10'000)->UseManualTime()->Iterations(100)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_IcebergSweep, iceberg, Liquidity::ICEBERG)->Arg(1'000)->Arg(10'000)->UseManualTime()->Iterations(100)->Unit(benchmark::kMicrosecond);
+
+enum class Cascade { CHAIN, BURST };
+
+// One trade setting off N buy stops. CHAIN gives every stop its own stop price, one tick above
+// the last, so each triggered stop's fill triggers the next. BURST puts all N at the trade
+// price so they trigger at once. The asks they lift sit one per tick above the trade.
+static void BM_StopCascade(benchmark::State& state, Cascade mode)
+{
+    NoOpOutputPolicy output;
+    MatchingEngine engine(output);
+
+    const size_t numStops = state.range(0);
+    const uint32_t basePrice = 15000;
+
+    uint64_t orderId = 0;
+    for (auto _ : state)
+    {
+        for (size_t i = 0; i <= numStops; i++)
+        {
+            Order sell(orderId++, 0, Side::SELL, OrderType::LIMIT, 10, basePrice + i);
+            engine.SubmitOrder(&sell);
+        }
+        for (size_t i = 0; i < numStops; i++)
+        {
+            Order stop(orderId++, 0, Side::BUY, OrderType::STOP, 10, 0);
+            stop.stopPrice = mode == Cascade::CHAIN ? basePrice + i : basePrice;
+            engine.SubmitOrder(&stop);
+        }
+
+        Order buy(orderId++, 0, Side::BUY, OrderType::LIMIT, 10, basePrice);
+
+        uint64_t start = Timer::rdtsc();
+        engine.SubmitOrder(&buy);
+        uint64_t end = Timer::rdtsc();
+
+        state.SetIterationTime(Timer::cycles_to_ns(end - start) / 1e9);
+        engine.GetBook(0)->Reset();
+    }
+    state.counters["ns_per_stop"] = benchmark::Counter(state.iterations() * numStops, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+BENCHMARK_CAPTURE(BM_StopCascade, chain, Cascade::CHAIN)->Arg(1'000)->Arg(10'000)->UseManualTime()->Iterations(50)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_StopCascade, burst, Cascade::BURST)->Arg(1'000)->Arg(10'000)->UseManualTime()->Iterations(50)->Unit(benchmark::kMicrosecond);
+
+// Uncross of all 50 symbols after a call phase that collected N limit orders, bids and asks
+// spread over the same 200 ticks so a large part of the book executes
+static void BM_AuctionUncross(benchmark::State& state)
+{
+    const size_t numSymbols = 50;
+    const size_t numOrders = state.range(0);
+
+    NoOpOutputPolicy output;
+    MatchingEngine engine(output, numSymbols, numOrders);
+
+    std::mt19937 gen(42);
+    std::vector<Order> orders;
+    orders.reserve(numOrders);
+    for (size_t i = 0; i < numOrders; i++)
+        orders.emplace_back(i, i % numSymbols, gen() % 2 ? Side::BUY : Side::SELL, OrderType::LIMIT, 1 + gen() % 1000, 14900 + gen() % 200);
+
+    for (auto _ : state)
+    {
+        engine.OpenAuction();
+        for (auto order : orders)
+            engine.SubmitOrder(&order);
+
+        uint64_t start = Timer::rdtsc();
+        uint64_t volume = engine.Uncross();
+        uint64_t end = Timer::rdtsc();
+
+        benchmark::DoNotOptimize(volume);
+        state.SetIterationTime(Timer::cycles_to_ns(end - start) / 1e9);
+        state.counters["volume"] = volume;
+
+        for (size_t symbolId = 0; symbolId < numSymbols; symbolId++)
+            engine.GetBook(symbolId)->Reset();
+    }
+}
+
+BENCHMARK(BM_AuctionUncross)->Arg(100'000)->Arg(1'000'000)->UseManualTime()->Iterations(3)->Unit(benchmark::kMillisecond);
+
+// Cost the risk module adds to an order: the pre-trade check plus counting the order as open,
+// for random accounts out of 1024 on 10 symbols, all with limits set.
+static void BM_RiskCheck(benchmark::State& state)
+{
+    const size_t numSymbols = 10;
+    const size_t batch = 4096;
+
+    RiskManager risk(numSymbols);
+    for (uint16_t account = 0; account < MAX_ACCOUNTS; account++)
+        risk.SetLimits(account, { .maxOrderQuantity = 10'000, .maxOpenOrders = 1'000'000, .maxNotional = 1'000'000'000, .maxPosition = 1'000'000'000 });
+
+    std::mt19937 gen(42);
+    std::vector<Order> orders;
+    for (size_t i = 0; i < batch; i++)
+        orders.emplace_back(i, gen() % numSymbols, gen() % 2 ? Side::BUY : Side::SELL, OrderType::LIMIT, 100 + gen() % 1000, 14000 + gen() % 2000, 0, gen() % MAX_ACCOUNTS);
+
+    for (auto _ : state)
+    {
+        size_t rejected = 0;
+        uint64_t start = Timer::rdtsc();
+        for (const auto & order : orders)
+        {
+            if (risk.Check(order) > RejectionType::NONE)
+                rejected++;
+            else
+                risk.OnOrderRested(order.accountId, order.symbolId);
+        }
+        uint64_t end = Timer::rdtsc();
+
+        benchmark::DoNotOptimize(rejected);
+        state.SetIterationTime(Timer::cycles_to_ns(end - start) / batch / 1e9);
+    }
+}
+
+BENCHMARK(BM_RiskCheck)->UseManualTime()->Iterations(10'000);
+
+// Inserts at random prices over the whole ladder of one instrument class, through the engine
+// and its runtime class dispatch. The ladder size is reported next to the time.
+static void BM_InstrumentClass(benchmark::State& state, InstrumentClass instrumentClass)
+{
+    NoOpOutputPolicy output;
+    SymbolDirectory symbols;
+    symbols.Add("X", instrumentClass);
+    MatchingEngine<NoOpOutputPolicy> engine(nullptr, output, symbols, state.max_iterations);
+    auto book = engine.GetBook(0);
+
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<uint32_t> priceDist(1, book->NumPriceLevels() - 1);
+    uint64_t orderId = 0;
+
+    for (auto _ : state)
+    {
+        Order order(orderId++, 0, Side::SELL, OrderType::LIMIT, 100, priceDist(gen));
+
+        uint64_t start = Timer::rdtsc();
+        engine.SubmitOrder(&order);
+        uint64_t end = Timer::rdtsc();
+
+        state.SetIterationTime(Timer::cycles_to_ns(end - start) / 1e9);
+    }
+
+    state.counters["ladder_kb"] = 2 * book->NumPriceLevels() * sizeof(PriceLevel) / 1024;
+}
+
+BENCHMARK_CAPTURE(BM_InstrumentClass, equity, InstrumentClass::EQUITY)->UseManualTime()->Iterations(1'000'000);
+BENCHMARK_CAPTURE(BM_InstrumentClass, future, InstrumentClass::FUTURE)->UseManualTime()->Iterations(1'000'000);
+BENCHMARK_CAPTURE(BM_InstrumentClass, penny, InstrumentClass::PENNY_STOCK)->UseManualTime()->Iterations(1'000'000);
+
+// Cost of the TSC reads and of a cycles to ns conversion, measured as the average over a run of
+// back-to-back calls
+template<uint64_t (*Read)()>
+static void BM_TscRead(benchmark::State& state)
+{
+    for (auto _ : state)
+        benchmark::DoNotOptimize(Read());
+}
+
+static uint64_t ConvertCycles()
+{
+    static uint64_t cycles = 123'456'789;
+    benchmark::DoNotOptimize(cycles);
+    return Timer::cycles_to_ns(cycles++);
+}
+
+BENCHMARK_TEMPLATE(BM_TscRead, Timer::rdtsc)->Name("BM_TscRead/rdtsc");
+BENCHMARK_TEMPLATE(BM_TscRead, Timer::rdtsc_fenced)->Name("BM_TscRead/rdtsc_fenced");
+BENCHMARK_TEMPLATE(BM_TscRead, Timer::rdtscp)->Name("BM_TscRead/rdtscp");
+BENCHMARK_TEMPLATE(BM_TscRead, ConvertCycles)->Name("BM_TscRead/cycles_to_ns");
+
+// Market data events of a generated uniform scenario
+static std::vector<MarketDataEvent> ScenarioEvents(size_t numRequests, size_t numSymbols)
+{
+    auto records = GenerateScenario(ScenarioConfig::Preset(Scenario::UNIFORM, numRequests, numSymbols));
+
+    VectorOutputPolicy output;
+    MatchingEngine engine(output, numSymbols, records.size());
+    OrderRequest req;
+    for (const auto & record : records)
+    {
+        record.Decode(req);
+        engine.ProcessRequest(req);
+    }
+    return output.events;
+}
+
+// The events of a generated scenario encoded into ITCH messages in batches of 64, as the
+// publisher does when draining its ring. Reports messages encoded per second.
+static void BM_ItchEncode(benchmark::State& state)
+{
+    const size_t numSymbols = 10;
+    const size_t batchSize = 64;
+    auto events = ScenarioEvents(100'000, numSymbols);
+
+    ItchEncoder encoder(SymbolDirectory::Default(numSymbols));
+    std::vector<char> buffer(ItchEncoder::BufferSize(batchSize));
+    std::vector<uint16_t> lengths(batchSize * ItchEncoder::MAX_MESSAGES_PER_EVENT);
+    uint64_t sequenceNumber = 1;
+    size_t start = 0;
+    size_t messages = 0;
+
+    for (auto _ : state)
+    {
+        auto batch = std::span(events).subspan(start, std::min(batchSize, events.size() - start));
+        messages += encoder.Encode(batch, sequenceNumber, buffer.data(), lengths.data());
+        benchmark::DoNotOptimize(buffer.data());
+        benchmark::ClobberMemory();
+        start = start + batchSize < events.size() ? start + batchSize : 0;
+    }
+
+    state.SetItemsProcessed(messages);
+}
+
+BENCHMARK(BM_ItchEncode);
+
+enum class MarketDataSend { SENDTO, SENDMMSG, SENDMMSG_CAPTURE, IO_URING, IO_URING_SQPOLL, IO_URING_ZERO_COPY };
+
+// UDPTransmitter without batches, so the publisher sends each message with its own sendto
+class SendtoTransmitter : public UDPTransmitter
+{
+public:
+    void SendBatch(std::span<const MarketDataEvent> events, const ItchEncoder & encoder) = delete;
+};
+
+template<typename Transmitter>
+static void PublishEvents(benchmark::State& state, const std::vector<MarketDataEvent> & events, Transmitter & transmitter)
+{
+    size_t numRequests = 0;
+    for (const auto & event : events)
+        numRequests = std::max<size_t>(numRequests, event.requestId + 1);
+
+    for (auto _ : state)
+    {
+        auto queue = std::make_shared<SPSCQueue<MarketDataEvent>>(events.size() + 1);
+        for (const auto & event : events)
+        {
+            *queue->GetWriteIndex() = event;
+            queue->UpdateWriteIndex();
+        }
+
+        MarketDataPublisher<Transmitter> publisher(queue, transmitter, numRequests, SymbolDirectory::Default(10));
+        publisher.SetCpu(-1);
+
+        auto start = std::chrono::steady_clock::now();
+        publisher.Start();
+        while (!queue->IsEmpty())
+            std::this_thread::yield();
+        publisher.Stop();
+        state.SetIterationTime(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+}
+
+// Calls `run` with a transmitter that sends the way `send` names: each message with sendto, in
+// batches with sendmmsg (also recording a pcap capture), or through an io_uring: one
+// io_uring_enter per batch, SQPOLL, or zero-copy sends from registered buffers without SQPOLL
+template<typename Run>
+static void WithTransmitter(benchmark::State& state, MarketDataSend send, Run run)
+{
+    switch (send)
+    {
+    case MarketDataSend::SENDTO:
+    {
+        SendtoTransmitter transmitter;
+        run(transmitter);
+        break;
+    }
+    case MarketDataSend::SENDMMSG:
+    {
+        UDPTransmitter transmitter;
+        run(transmitter);
+        break;
+    }
+    case MarketDataSend::SENDMMSG_CAPTURE:
+    {
+        auto path = std::filesystem::temp_directory_path() / "bm_publish_events.pcap";
+        {
+            FeedCapture capture(path);
+            UDPTransmitter transmitter;
+            transmitter.SetCapture(&capture);
+            run(transmitter);
+        }
+        std::filesystem::remove(path);
+        break;
+    }
+    default:
+    {
+        IoUringOptions options;
+        options.sqPoll = send == MarketDataSend::IO_URING_SQPOLL;
+        options.zeroCopy = send == MarketDataSend::IO_URING_ZERO_COPY;
+        IoUringTransmitter transmitter(FeedAddress{}, options);
+        if (options.sqPoll && !transmitter.UsesSqPoll())
+            state.SkipWithError("SQPOLL not permitted");
+        run(transmitter);
+        break;
+    }
+    }
+}
+
+// The publisher draining a queue of scenario events to loopback multicast. Reports messages
+// per second.
+static void BM_PublishEvents(benchmark::State& state, MarketDataSend send)
+{
+    auto events = ScenarioEvents(20'000, 10);
+
+    std::vector<char> buffer(ItchEncoder::BufferSize(events.size()));
+    std::vector<uint16_t> lengths(events.size() * ItchEncoder::MAX_MESSAGES_PER_EVENT);
+    uint64_t sequenceNumber = 1;
+    size_t numMessages = ItchEncoder(SymbolDirectory::Default(10)).Encode(events, sequenceNumber, buffer.data(), lengths.data());
+
+    WithTransmitter(state, send, [&](auto & transmitter) { PublishEvents(state, events, transmitter); });
+    state.SetItemsProcessed(state.iterations() * numMessages);
+}
+
+BENCHMARK_CAPTURE(BM_PublishEvents, sendto, MarketDataSend::SENDTO)->UseManualTime()->Iterations(3)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_PublishEvents, sendmmsg, MarketDataSend::SENDMMSG)->UseManualTime()->Iterations(3)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_PublishEvents, sendmmsg_capture, MarketDataSend::SENDMMSG_CAPTURE)->UseManualTime()->Iterations(3)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_PublishEvents, io_uring, MarketDataSend::IO_URING)->UseManualTime()->Iterations(3)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_PublishEvents, io_uring_sqpoll, MarketDataSend::IO_URING_SQPOLL)->UseManualTime()->Iterations(3)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_PublishEvents, io_uring_zero_copy, MarketDataSend::IO_URING_ZERO_COPY)->UseManualTime()->Iterations(3)->Unit(benchmark::kMillisecond);
+
+// Socket joined to the default market data group on loopback
+static int JoinMarketDataGroup()
+{
+    FeedAddress address;
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    int reuse = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    timeval timeout = { 1, 0 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    sockaddr_in local = address.SocketAddress();
+    bind(sock, reinterpret_cast<sockaddr*>(&local), sizeof(local));
+
+    ip_mreq group = {};
+    group.imr_multiaddr = local.sin_addr;
+    group.imr_interface.s_addr = inet_addr("127.0.0.1");
+    setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &group, sizeof(group));
+    return sock;
+}
+
+// One order add at a time through the publisher to a socket joined to the group. Each event is
+// stamped with the TSC when it is queued, and the latency is taken when its datagram is
+// received, so it covers the ring, encoding, the send path and loopback delivery. The
+// publisher yields when idle, so that on a machine with few cores it does not hold the CPU the
+// receiver needs.
+static void BM_PublishLatency(benchmark::State& state, MarketDataSend send)
+{
+    const size_t numSamples = 20'000;
+
+    // With one CPU, the spinning SQPOLL thread keeps it until the scheduler tick, for every message
+    if (send == MarketDataSend::IO_URING_SQPOLL && std::thread::hardware_concurrency() < 2)
+    {
+        state.SkipWithError("SQPOLL needs a second CPU for its kernel thread");
+        return;
+    }
+
+    MarketDataEvent add(1, 1, 0, Side::BUY, 10'000, 100);
+    int sock = JoinMarketDataGroup();
+
+    WithTransmitter(state, send, [&](auto & transmitter) {
+        using Transmitter = std::remove_reference_t<decltype(transmitter)>;
+        for (auto _ : state)
+        {
+            auto queue = std::make_shared<SPSCQueue<MarketDataEvent>>(1024);
+            MarketDataPublisher<Transmitter, SpinYieldWait> publisher(queue, transmitter, numSamples, SymbolDirectory::Default(10));
+            publisher.SetCpu(-1);
+            publisher.Start();
+
+            LatencyStats latencies;
+            uint64_t totalCycles = 0;
+            char buf[128];
+            for (size_t i = 0; i < numSamples; i++)
+            {
+                add.requestId = i;
+                add.timestamp = Timer::rdtsc();
+                *queue->GetWriteIndex() = add;
+                queue->UpdateWriteIndex();
+
+                if (recv(sock, buf, sizeof(buf), 0) < static_cast<ssize_t>(sizeof(ItchHeader)))
+                {
+                    state.SkipWithError("market data message not received");
+                    break;
+                }
+                uint64_t cycles = Timer::rdtsc() - be64toh(reinterpret_cast<const ItchHeader*>(buf)->timestamp);
+                latencies.record(cycles);
+                totalCycles += cycles;
+            }
+
+            publisher.Stop();
+            while (recv(sock, buf, sizeof(buf), 0) > 0 && reinterpret_cast<const ItchHeader*>(buf)->messageType != 'M');
+
+            if (latencies.size() == 0)
+                break;
+            state.SetIterationTime(Timer::cycles_to_ns(totalCycles) / 1e9);
+            state.counters["p50_ns"] = Timer::cycles_to_ns(latencies.percentile(0.5));
+            state.counters["p99_ns"] = Timer::cycles_to_ns(latencies.percentile(0.99));
+            state.counters["p99.9_ns"] = Timer::cycles_to_ns(latencies.percentile(0.999));
+        }
+    });
+    close(sock);
+    state.SetItemsProcessed(state.iterations() * numSamples);
+}
+
+BENCHMARK_CAPTURE(BM_PublishLatency, sendto, MarketDataSend::SENDTO)->UseManualTime()->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_PublishLatency, sendmmsg, MarketDataSend::SENDMMSG)->UseManualTime()->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_PublishLatency, io_uring, MarketDataSend::IO_URING)->UseManualTime()->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_PublishLatency, io_uring_sqpoll, MarketDataSend::IO_URING_SQPOLL)->UseManualTime()->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_PublishLatency, io_uring_zero_copy, MarketDataSend::IO_URING_ZERO_COPY)->UseManualTime()->Iterations(1)->Unit(benchmark::kMillisecond);
+
+// Reads a pcap capture of a scenario's market data and decodes it, as feedreplay --flat --decode
+// does. Reports messages per second.
+static void BM_FeedDecode(benchmark::State& state)
+{
+    auto events = ScenarioEvents(100'000, 10);
+    ItchEncoder encoder(SymbolDirectory::Default(10));
+    std::vector<char> buffer(ItchEncoder::BufferSize(events.size()));
+    std::vector<uint16_t> lengths(events.size() * ItchEncoder::MAX_MESSAGES_PER_EVENT);
+    uint64_t sequenceNumber = 1;
+    size_t numMessages = encoder.Encode(events, sequenceNumber, buffer.data(), lengths.data());
+
+    auto path = std::filesystem::temp_directory_path() / "bm_feed_decode.pcap";
+    {
+        FeedCapture capture(path);
+        capture.Write(buffer.data(), lengths.data(), numMessages);
+    }
+
+    for (auto _ : state)
+    {
+        PcapReader reader(path);
+        PcapReader::Packet packet;
+        FeedStats stats;
+        FeedDecoder decoder(stats);
+
+        auto start = std::chrono::steady_clock::now();
+        while (reader.Next(packet))
+            decoder.Decode(packet.payload.data(), packet.payload.size());
+        state.SetIterationTime(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+        if (decoder.MessagesProcessed() != numMessages)
+            state.SkipWithError("decoded message count does not match the capture");
+        benchmark::DoNotOptimize(stats);
+    }
+    std::filesystem::remove(path);
+    state.SetItemsProcessed(state.iterations() * numMessages);
+}
+
+BENCHMARK(BM_FeedDecode)->UseManualTime()->Iterations(10)->Unit(benchmark::kMillisecond);
+
+// The same messages as BM_FeedDecode arriving on both the A and the B feed, B a few messages
+// behind, each feed losing the given percentage independently. Items are unique messages.
+static void BM_FeedArbitrate(benchmark::State& state)
+{
+    const double lossRate = state.range(0) / 100.0;
+    const size_t lag = 5;
+
+    auto events = ScenarioEvents(100'000, 10);
+    ItchEncoder encoder(SymbolDirectory::Default(10));
+    std::vector<char> buffer(ItchEncoder::BufferSize(events.size()));
+    std::vector<uint16_t> lengths(events.size() * ItchEncoder::MAX_MESSAGES_PER_EVENT);
+    uint64_t sequenceNumber = 1;
+    size_t numMessages = encoder.Encode(events, sequenceNumber, buffer.data(), lengths.data());
+
+    struct Packet
+    {
+        Feed feed;
+        const char* data;
+        size_t length;
+    };
+    std::vector<const char*> messages(numMessages);
+    for (size_t i = 0, offset = 0; i < numMessages; offset += lengths[i++])
+        messages[i] = buffer.data() + offset;
+
+    std::mt19937 gen(42);
+    std::bernoulli_distribution lossDist(lossRate);
+    std::vector<Packet> packets;
+    for (size_t i = 0; i < numMessages + lag; i++)
+    {
+        if (i < numMessages && !lossDist(gen))
+            packets.push_back({ Feed::A, messages[i], lengths[i] });
+        if (i >= lag && !lossDist(gen))
+            packets.push_back({ Feed::B, messages[i - lag], lengths[i - lag] });
+    }
+
+    for (auto _ : state)
+    {
+        FeedStats stats;
+        auto arbitrator = std::make_unique<FeedArbitrator<FeedStats>>(stats);
+
+        auto start = std::chrono::steady_clock::now();
+        for (const auto & packet : packets)
+            arbitrator->OnPacket(packet.feed, packet.data, packet.length);
+        arbitrator->Flush();
+        state.SetIterationTime(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+        state.counters["dropped"] = arbitrator->Decoder().MessagesDropped();
+        benchmark::DoNotOptimize(stats);
+    }
+    state.SetItemsProcessed(state.iterations() * numMessages);
+}
+
+BENCHMARK(BM_FeedArbitrate)->ArgName("loss%")->Arg(0)->Arg(10)->UseManualTime()->Iterations(10)->Unit(benchmark::kMillisecond);
+
+static size_t ResidentKb()
+{
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, residentPages = 0;
+    statm >> pages >> residentPages;
+    return residentPages * sysconf(_SC_PAGESIZE) / 1024;
+}
+
+// A directory of N symbols of which only 50, spread over the id range, get orders. Reports the
+// resident memory the engine added, the latency of each symbol's first order (which creates
+// its book) and of the orders after that.
+static void BM_IdleSymbols(benchmark::State& state)
+{
+    const size_t numSymbols = state.range(0);
+    const size_t numActive = 50;
+    const size_t numOrders = 200'000;
+
+    for (auto _ : state)
+    {
+        size_t residentBefore = ResidentKb();
+        NoOpOutputPolicy output;
+        MatchingEngine<NoOpOutputPolicy> engine(nullptr, output, SymbolDirectory::Synthetic(numSymbols), numOrders);
+
+        std::mt19937 gen(42);
+        std::uniform_int_distribution<size_t> activeDist(0, numActive - 1);
+        std::uniform_int_distribution<uint32_t> priceDist(9'950, 10'050);
+        std::bernoulli_distribution sideDist(0.5);
+
+        LatencyStats firstLatencies;
+        LatencyStats orderLatencies;
+        uint64_t totalCycles = 0;
+        for (size_t i = 0; i < numOrders; i++)
+        {
+            SymbolId symbolId = i < numActive ? i * (numSymbols / numActive) : activeDist(gen) * (numSymbols / numActive);
+            Order order(i, symbolId, sideDist(gen) ? Side::BUY : Side::SELL, OrderType::LIMIT, 100, priceDist(gen));
+
+            uint64_t start = Timer::rdtsc();
+            engine.SubmitOrder(&order);
+            uint64_t end = Timer::rdtsc();
+
+            (i < numActive ? firstLatencies : orderLatencies).record(end - start);
+            totalCycles += end - start;
+        }
+
+        state.SetIterationTime(Timer::cycles_to_ns(totalCycles) / 1e9);
+        state.counters["active_books"] = engine.NumActiveBooks();
+        state.counters["resident_kb"] = ResidentKb() - residentBefore;
+        state.counters["first_order_p50_us"] = Timer::cycles_to_ns(firstLatencies.percentile(0.5)) / 1e3;
+        state.counters["order_p50_ns"] = Timer::cycles_to_ns(orderLatencies.percentile(0.5));
+        state.counters["order_p99_ns"] = Timer::cycles_to_ns(orderLatencies.percentile(0.99));
+    }
+}
+
+BENCHMARK(BM_IdleSymbols)->ArgName("symbols")->Arg(50)->Arg(1'000)->Arg(10'000)->UseManualTime()->Iterations(1)->Unit(benchmark::kMillisecond);
+
 BENCHMARK_MAIN();
\ No newline at end of file
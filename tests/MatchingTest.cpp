@@ -1,7 +1,21 @@
 #include <gtest/gtest.h>
 #include "MatchingEngine.hpp"
+#include "ScenarioGenerator.hpp"
+#include "PrefixSum.hpp"
+#include "PriceBitmap.hpp"
+#include "SymbolDirectory.hpp"
+#include "ItchEncoder.hpp"
+#include "IoUringTransmitter.hpp"
+#include "FeedCapture.hpp"
+#include "FeedDecoder.hpp"
+#include "FeedArbitrator.hpp"
 #include <thread>
 #include <chrono>
+#include <fstream>
+#include <map>
+#include <numeric>
+#include <set>
+#include <tuple>
 
 class MatchingEngineTest : public testing::Test
 {
@@ -197,4 +211,1342 @@ TEST_F(MatchingEngineTest, FOKOrderRejected)
     EXPECT_EQ(output.events[1].type, EventType::ORDER_ACKED);
     EXPECT_EQ(output.events[2].orderId, 3);
     EXPECT_EQ(output.events[2].type, EventType::ORDER_CANCELLED);
-}
\ No newline at end of file
+}
+
+TEST_F(MatchingEngineTest, WarmUpLeavesEngineEmpty)
+{
+    engine.WarmUp({ .syntheticOrders = 1000 });
+    EXPECT_EQ(output.events.size(), 0);
+
+    auto [bid, ask] = engine.GetBook(0)->GetTopOfBook();
+    EXPECT_EQ(bid, 0);
+    EXPECT_EQ(ask, engine.GetBook(0)->NumPriceLevels());
+
+    Order sell{ 1, 0, Side::SELL, OrderType::LIMIT, 100, 15000 };
+    engine.SubmitOrder(&sell);
+    Order buy{ 2, 0, Side::BUY, OrderType::LIMIT, 100, 15000 };
+    engine.SubmitOrder(&buy);
+
+    EXPECT_EQ(output.events.size(), 2);
+    EXPECT_EQ(output.events[0].type, EventType::ORDER_ACKED);
+    EXPECT_EQ(output.events[1].type, EventType::ORDER_FILLED);
+    EXPECT_EQ(output.events[1].restingOrderId, 1);
+}
+
+TEST_F(MatchingEngineTest, CancelBatchMatchesSequentialCancels)
+{
+    for (uint64_t id = 1; id <= 4; id++)
+    {
+        Order sell{ id, 0, Side::SELL, OrderType::LIMIT, 100, 15000 };
+        engine.SubmitOrder(&sell);
+    }
+
+    std::array<CancelRequest, 4> cancels{ {
+        { 10, 2, 0 },
+        { 11, 3, 0 },
+        { 12, 2, 0 },
+        { 13, 99, 0 },
+    } };
+    engine.CancelBatch(cancels);
+
+    ASSERT_EQ(output.events.size(), 7);
+    EXPECT_EQ(output.events[4].type, EventType::ORDER_CANCELLED);
+    EXPECT_EQ(output.events[4].orderId, 2);
+    EXPECT_EQ(output.events[5].type, EventType::ORDER_CANCELLED);
+    EXPECT_EQ(output.events[5].orderId, 3);
+    EXPECT_EQ(output.events[6].type, EventType::ORDER_REJECTED);
+    EXPECT_EQ(output.events[6].rejectionReason, RejectionType::ORDER_NOT_FOUND);
+
+    Order buy{ 5, 0, Side::BUY, OrderType::LIMIT, 200, 15000 };
+    engine.SubmitOrder(&buy);
+    ASSERT_EQ(output.events.size(), 9);
+    EXPECT_EQ(output.events[7].restingOrderId, 1);
+    EXPECT_EQ(output.events[8].restingOrderId, 4);
+}
+
+TEST_F(MatchingEngineTest, ModifyQuantityDecreaseKeepsPriority)
+{
+    Order sell1{ 1, 0, Side::SELL, OrderType::LIMIT, 100, 15000 };
+    Order sell2{ 2, 0, Side::SELL, OrderType::LIMIT, 100, 15000 };
+    engine.SubmitOrder(&sell1);
+    engine.SubmitOrder(&sell2);
+
+    EXPECT_TRUE(engine.ModifyOrder(1, 40, 15000, 3));
+    ASSERT_EQ(output.events.size(), 3);
+    EXPECT_EQ(output.events[2].type, EventType::ORDER_REPLACED);
+    EXPECT_EQ(output.events[2].orderId, 1);
+    EXPECT_EQ(output.events[2].requestId, 3);
+    EXPECT_EQ(output.events[2].quantity, 40);
+    EXPECT_EQ(output.events[2].price, 15000);
+
+    Order buy{ 4, 0, Side::BUY, OrderType::LIMIT, 60, 15000 };
+    engine.SubmitOrder(&buy);
+    ASSERT_EQ(output.events.size(), 5);
+    EXPECT_EQ(output.events[3].restingOrderId, 1);
+    EXPECT_EQ(output.events[3].quantity, 40);
+    EXPECT_EQ(output.events[4].restingOrderId, 2);
+    EXPECT_EQ(output.events[4].quantity, 20);
+}
+
+TEST_F(MatchingEngineTest, ModifyPriceChangeLosesPriority)
+{
+    Order sell1{ 1, 0, Side::SELL, OrderType::LIMIT, 100, 15001 };
+    Order sell2{ 2, 0, Side::SELL, OrderType::LIMIT, 100, 15000 };
+    engine.SubmitOrder(&sell1);
+    engine.SubmitOrder(&sell2);
+
+    // Moves to the level of order 2 and queues behind it
+    engine.ModifyOrder(1, 100, 15000, 3);
+    EXPECT_EQ(output.events[2].type, EventType::ORDER_REPLACED);
+    EXPECT_EQ(output.events[2].price, 15000);
+
+    Order buy{ 4, 0, Side::BUY, OrderType::LIMIT, 150, 15000 };
+    engine.SubmitOrder(&buy);
+    ASSERT_EQ(output.events.size(), 5);
+    EXPECT_EQ(output.events[3].restingOrderId, 2);
+    EXPECT_EQ(output.events[4].restingOrderId, 1);
+    EXPECT_EQ(output.events[4].quantity, 50);
+
+    auto [bid, ask] = engine.GetBook(0)->GetTopOfBook();
+    EXPECT_EQ(ask, 15000);
+}
+
+TEST_F(MatchingEngineTest, ModifyToCrossingPriceMatches)
+{
+    Order sell{ 1, 0, Side::SELL, OrderType::LIMIT, 100, 15000 };
+    Order buy{ 2, 0, Side::BUY, OrderType::LIMIT, 150, 14990 };
+    engine.SubmitOrder(&sell);
+    engine.SubmitOrder(&buy);
+
+    engine.ModifyOrder(2, 150, 15000, 3);
+    ASSERT_EQ(output.events.size(), 4);
+    EXPECT_EQ(output.events[2].type, EventType::ORDER_REPLACED);
+    EXPECT_EQ(output.events[3].type, EventType::ORDER_FILLED);
+    EXPECT_EQ(output.events[3].orderId, 2);
+    EXPECT_EQ(output.events[3].requestId, 3);
+    EXPECT_EQ(output.events[3].restingOrderId, 1);
+    EXPECT_EQ(output.events[3].quantity, 100);
+
+    auto [bid, ask] = engine.GetBook(0)->GetTopOfBook();
+    EXPECT_EQ(bid, 15000);
+
+    engine.ModifyOrder(99, 10, 15000, 5);
+    EXPECT_TRUE(engine.ModifyOrder(2, 0, 15000, 6) == false);
+    EXPECT_EQ(output.events.back().rejectionReason, RejectionType::INVALID_QUANTITY);
+}
+
+TEST_F(MatchingEngineTest, SweepEventsShareRequestTimestamp)
+{
+#ifdef PER_EVENT_TIMESTAMPS
+    GTEST_SKIP() << "each event reads the TSC itself";
+#endif
+    Order sell1{ 1, 0, Side::SELL, OrderType::LIMIT, 100, 15000 };
+    Order sell2{ 2, 0, Side::SELL, OrderType::LIMIT, 100, 15010 };
+    Order sell3{ 3, 0, Side::SELL, OrderType::LIMIT, 100, 15020 };
+    engine.SubmitOrder(&sell1);
+    engine.SubmitOrder(&sell2);
+    engine.SubmitOrder(&sell3);
+    output.events.clear();
+
+    // Fills all three levels and rests the remainder
+    Order buy{ 4, 0, Side::BUY, OrderType::LIMIT, 350, 15020 };
+    engine.SubmitOrder(&buy);
+    ASSERT_EQ(output.events.size(), 4);
+    EXPECT_EQ(output.events[3].type, EventType::ORDER_ACKED);
+    for (const auto & event : output.events)
+        EXPECT_EQ(event.timestamp, output.events[0].timestamp);
+}
+
+TEST_F(MatchingEngineTest, MassCancelBySessionAndSide)
+{
+    Order buy1{ 1, 0, Side::BUY, OrderType::LIMIT, 100, 14990, 7 };
+    Order buy2{ 2, 0, Side::BUY, OrderType::LIMIT, 100, 14980, 8 };
+    Order sell1{ 3, 0, Side::SELL, OrderType::LIMIT, 100, 15010, 7 };
+    Order buy3{ 4, 0, Side::BUY, OrderType::LIMIT, 100, 14995, 7 };
+    for (auto order : { &buy1, &buy2, &sell1, &buy3 })
+        engine.SubmitOrder(order);
+
+    EXPECT_EQ(engine.MassCancel({ .requestId = 5, .side = Side::BUY, .sessionId = 7 }), 2);
+    ASSERT_EQ(output.events.size(), 6);
+    for (size_t i = 4; i < 6; i++)
+    {
+        EXPECT_EQ(output.events[i].type, EventType::ORDER_CANCELLED);
+        EXPECT_EQ(output.events[i].requestId, 5);
+    }
+
+    // The best bid moved down to the surviving order of the other session
+    auto [bid, ask] = engine.GetBook(0)->GetTopOfBook();
+    EXPECT_EQ(bid, 14980);
+    EXPECT_EQ(ask, 15010);
+
+    EXPECT_EQ(engine.MassCancel({ .requestId = 6, .sessionId = 7 }), 1);
+    EXPECT_EQ(output.events.back().orderId, 3);
+
+    // Session 7 is empty now and a fill of session 8's order leaves nothing behind
+    Order sell2{ 7, 0, Side::SELL, OrderType::LIMIT, 100, 14980, 9 };
+    engine.SubmitOrder(&sell2);
+    EXPECT_EQ(output.events.back().restingOrderId, 2);
+    EXPECT_EQ(engine.MassCancel({ .requestId = 8 }), 0);
+}
+
+TEST_F(MatchingEngineTest, RiskLimitsRejectOrders)
+{
+    engine.GetRiskManager().SetLimits(3, 0, { .maxOrderQuantity = 1000, .maxOpenOrders = 2, .maxNotional = 10'000'000, .maxPosition = 500 });
+
+    Order tooLarge{ 1, 0, Side::BUY, OrderType::LIMIT, 1001, 100, 0, 3 };
+    Order tooExpensive{ 2, 0, Side::BUY, OrderType::LIMIT, 1000, 15000, 0, 3 };
+    Order tooLong{ 3, 0, Side::BUY, OrderType::LIMIT, 600, 100, 0, 3 };
+    Order otherAccount{ 4, 0, Side::BUY, OrderType::LIMIT, 5000, 100, 0, 4 };
+    for (auto order : { &tooLarge, &tooExpensive, &tooLong, &otherAccount })
+        engine.SubmitOrder(order);
+
+    ASSERT_EQ(output.events.size(), 4);
+    EXPECT_EQ(output.events[0].rejectionReason, RejectionType::ORDER_SIZE_LIMIT);
+    EXPECT_EQ(output.events[1].rejectionReason, RejectionType::NOTIONAL_LIMIT);
+    EXPECT_EQ(output.events[2].rejectionReason, RejectionType::POSITION_LIMIT);
+    EXPECT_EQ(output.events[3].type, EventType::ORDER_ACKED);
+
+    Order open1{ 5, 0, Side::SELL, OrderType::LIMIT, 100, 200, 0, 3 };
+    Order open2{ 6, 0, Side::SELL, OrderType::LIMIT, 100, 200, 0, 3 };
+    Order open3{ 7, 0, Side::SELL, OrderType::LIMIT, 100, 200, 0, 3 };
+    for (auto order : { &open1, &open2, &open3 })
+        engine.SubmitOrder(order);
+    EXPECT_EQ(output.events.back().rejectionReason, RejectionType::OPEN_ORDER_LIMIT);
+    EXPECT_EQ(engine.GetRiskManager().OpenOrders(3, 0), 2);
+
+    engine.CancelOrder(5, 8);
+    EXPECT_EQ(engine.GetRiskManager().OpenOrders(3, 0), 1);
+}
+
+TEST_F(MatchingEngineTest, RiskTracksPositionsThroughFills)
+{
+    Order sell{ 1, 0, Side::SELL, OrderType::LIMIT, 100, 15000, 0, 1 };
+    Order buy{ 2, 0, Side::BUY, OrderType::LIMIT, 60, 15000, 0, 2 };
+    engine.SubmitOrder(&sell);
+    engine.SubmitOrder(&buy);
+
+    auto & risk = engine.GetRiskManager();
+    EXPECT_EQ(risk.Position(1, 0), -60);
+    EXPECT_EQ(risk.Position(2, 0), 60);
+    EXPECT_EQ(risk.OpenOrders(1, 0), 1);
+    EXPECT_EQ(risk.OpenOrders(2, 0), 0);
+
+    // Market orders are valued at the last trade
+    risk.SetLimits(2, 0, { .maxNotional = 15000 * 40 });
+    Order market{ 3, 0, Side::BUY, OrderType::MARKET, 41, 0, 0, 2 };
+    engine.SubmitOrder(&market);
+    EXPECT_EQ(output.events.back().rejectionReason, RejectionType::NOTIONAL_LIMIT);
+
+    Order fill{ 4, 0, Side::BUY, OrderType::MARKET, 40, 0, 0, 2 };
+    engine.SubmitOrder(&fill);
+    EXPECT_EQ(risk.Position(1, 0), -100);
+    EXPECT_EQ(risk.OpenOrders(1, 0), 0);
+}
+
+TEST_F(MatchingEngineTest, RiskRejectsMarketOrderWithoutReferencePrice)
+{
+    // Liquidity rests but nothing has traded, so there is no last price to value a market order at
+    Order ask{ 1, 0, Side::SELL, OrderType::LIMIT, 100'000, 15000, 0, 1 };
+    engine.SubmitOrder(&ask);
+
+    engine.GetRiskManager().SetLimits(2, 0, { .maxNotional = 1'000'000 });
+    Order market{ 2, 0, Side::BUY, OrderType::MARKET, 100'000, 0, 0, 2 };
+    engine.SubmitOrder(&market);
+    EXPECT_EQ(output.events.back().type, EventType::ORDER_REJECTED);
+    EXPECT_EQ(output.events.back().rejectionReason, RejectionType::NOTIONAL_LIMIT);
+    EXPECT_EQ(engine.GetRiskManager().Position(2, 0), 0);
+
+    // An account without a notional limit still trades it
+    Order unlimited{ 3, 0, Side::BUY, OrderType::MARKET, 100, 0, 0, 3 };
+    engine.SubmitOrder(&unlimited);
+    EXPECT_EQ(engine.GetRiskManager().Position(3, 0), 100);
+}
+
+TEST_F(MatchingEngineTest, PriceBandStopsSweepAndHalts)
+{
+    engine.SetPriceBand(0, 10, 15000);
+
+    Order ask1{ 1, 0, Side::SELL, OrderType::LIMIT, 100, 15005 };
+    Order ask2{ 2, 0, Side::SELL, OrderType::LIMIT, 100, 15010 };
+    Order ask3{ 3, 0, Side::SELL, OrderType::LIMIT, 100, 15011 };
+    Order farBid{ 4, 0, Side::BUY, OrderType::LIMIT, 100, 10000 };
+    for (auto order : { &ask1, &ask2, &ask3, &farBid })
+        engine.SubmitOrder(order);
+    output.events.clear();
+
+    // Fills up to and including the band edge, then halts and cancels the rest
+    Order sweep{ 5, 0, Side::BUY, OrderType::MARKET, 300, 0 };
+    engine.SubmitOrder(&sweep);
+    ASSERT_EQ(output.events.size(), 4);
+    EXPECT_EQ(output.events[0].price, 15005);
+    EXPECT_EQ(output.events[1].price, 15010);
+    EXPECT_EQ(output.events[2].type, EventType::TRADING_HALTED);
+    EXPECT_EQ(output.events[3].type, EventType::ORDER_CANCELLED);
+    EXPECT_EQ(output.events[3].orderId, 5);
+    EXPECT_TRUE(engine.GetBook(0)->IsHalted());
+
+    Order whileHalted{ 6, 0, Side::SELL, OrderType::LIMIT, 100, 15020 };
+    engine.SubmitOrder(&whileHalted);
+    EXPECT_EQ(output.events.back().rejectionReason, RejectionType::SYMBOL_HALTED);
+    EXPECT_TRUE(engine.CancelOrder(4, 7));
+    EXPECT_EQ(output.events.back().type, EventType::ORDER_CANCELLED);
+
+    // The reference followed the last trade, so 15011 is now inside the band
+    engine.ResumeTrading(0);
+    EXPECT_EQ(output.events.back().type, EventType::TRADING_RESUMED);
+    EXPECT_EQ(output.events.back().price, 15010);
+
+    Order buy{ 8, 0, Side::BUY, OrderType::MARKET, 100, 0 };
+    engine.SubmitOrder(&buy);
+    EXPECT_EQ(output.events.back().type, EventType::ORDER_FILLED);
+    EXPECT_EQ(output.events.back().price, 15011);
+    EXPECT_FALSE(engine.GetBook(0)->IsHalted());
+}
+
+TEST_F(MatchingEngineTest, PriceBandLimitsFOKAndRestingOrders)
+{
+    engine.SetPriceBand(0, 10, 15000);
+
+    Order inside{ 1, 0, Side::BUY, OrderType::LIMIT, 100, 14995 };
+    Order outside{ 2, 0, Side::BUY, OrderType::LIMIT, 100, 14980 };
+    engine.SubmitOrder(&inside);
+    engine.SubmitOrder(&outside);
+
+    // Needs the bid beyond the band to fill completely, so it is killed without halting
+    Order fok{ 3, 0, Side::SELL, OrderType::FOK, 200, 0 };
+    engine.SubmitOrder(&fok);
+    EXPECT_EQ(output.events.back().type, EventType::ORDER_CANCELLED);
+    EXPECT_FALSE(engine.GetBook(0)->IsHalted());
+
+    // A limit order that stops at its own price before the band rests as usual
+    Order sell{ 4, 0, Side::SELL, OrderType::LIMIT, 200, 14995 };
+    engine.SubmitOrder(&sell);
+    EXPECT_EQ(output.events.back().type, EventType::ORDER_ACKED);
+    EXPECT_EQ(output.events.back().quantity, 100);
+    EXPECT_FALSE(engine.GetBook(0)->IsHalted());
+}
+
+TEST_F(MatchingEngineTest, AuctionUncrossesAtMaximumVolumePrice)
+{
+    engine.OpenAuction(0);
+
+    Order bid1{ 1, 0, Side::BUY, OrderType::LIMIT, 100, 15010 };
+    Order bid2{ 2, 0, Side::BUY, OrderType::LIMIT, 100, 15005 };
+    Order bid3{ 3, 0, Side::BUY, OrderType::LIMIT, 200, 15000 };
+    Order ask1{ 4, 0, Side::SELL, OrderType::LIMIT, 150, 14995 };
+    Order ask2{ 5, 0, Side::SELL, OrderType::LIMIT, 100, 15005 };
+    Order ask3{ 6, 0, Side::SELL, OrderType::LIMIT, 100, 15020 };
+    Order market{ 7, 0, Side::BUY, OrderType::MARKET, 100, 0 };
+    for (auto order : { &bid1, &bid2, &bid3, &ask1, &ask2, &ask3, &market })
+        engine.SubmitOrder(order);
+
+    // Nothing matches during the call phase
+    ASSERT_EQ(output.events.size(), 7);
+    for (size_t i = 0; i < 6; i++)
+        EXPECT_EQ(output.events[i].type, EventType::ORDER_ACKED);
+    EXPECT_EQ(output.events[6].rejectionReason, RejectionType::NOT_ALLOWED_IN_AUCTION);
+    output.events.clear();
+
+    // 15005 executes 200, every other price less
+    EXPECT_EQ(engine.Uncross(0, 8), 200);
+    ASSERT_EQ(output.events.size(), 3);
+    for (const auto & fill : output.events)
+    {
+        EXPECT_EQ(fill.type, EventType::ORDER_FILLED);
+        EXPECT_EQ(fill.price, 15005);
+    }
+    EXPECT_EQ(output.events[0].orderId, 1);
+    EXPECT_EQ(output.events[0].restingOrderId, 4);
+    EXPECT_EQ(output.events[0].quantity, 100);
+    EXPECT_EQ(output.events[1].orderId, 2);
+    EXPECT_EQ(output.events[1].restingOrderId, 4);
+    EXPECT_EQ(output.events[1].quantity, 50);
+    EXPECT_EQ(output.events[2].orderId, 2);
+    EXPECT_EQ(output.events[2].restingOrderId, 5);
+    EXPECT_EQ(output.events[2].quantity, 50);
+
+    EXPECT_EQ(engine.GetBook(0)->GetTopOfBook(), std::make_pair(15000u, 15005u));
+
+    // Back to continuous matching
+    Order sell{ 9, 0, Side::SELL, OrderType::LIMIT, 200, 15000 };
+    engine.SubmitOrder(&sell);
+    EXPECT_EQ(output.events.back().type, EventType::ORDER_FILLED);
+    EXPECT_EQ(output.events.back().restingOrderId, 3);
+}
+
+TEST_F(MatchingEngineTest, IcebergReplenishesAtBackOfLevel)
+{
+    Order iceberg{ 1, 0, Side::SELL, OrderType::LIMIT, 300, 15000 };
+    iceberg.displayQuantity = 100;
+    Order plain{ 2, 0, Side::SELL, OrderType::LIMIT, 100, 15000 };
+    engine.SubmitOrder(&iceberg);
+    engine.SubmitOrder(&plain);
+    EXPECT_EQ(output.events[0].quantity, 100);
+    output.events.clear();
+
+    // Uses up the shown slice, which refreshes behind the plain order
+    Order buy1{ 3, 0, Side::BUY, OrderType::LIMIT, 150, 15000 };
+    engine.SubmitOrder(&buy1);
+    ASSERT_EQ(output.events.size(), 3);
+    EXPECT_EQ(output.events[0].restingOrderId, 1);
+    EXPECT_EQ(output.events[0].quantity, 100);
+    EXPECT_EQ(output.events[1].type, EventType::ORDER_REPLENISHED);
+    EXPECT_EQ(output.events[1].orderId, 1);
+    EXPECT_EQ(output.events[1].quantity, 100);
+    EXPECT_EQ(output.events[2].restingOrderId, 2);
+    EXPECT_EQ(output.events[2].quantity, 50);
+    output.events.clear();
+
+    Order buy2{ 4, 0, Side::BUY, OrderType::LIMIT, 150, 15000 };
+    engine.SubmitOrder(&buy2);
+    ASSERT_EQ(output.events.size(), 3);
+    EXPECT_EQ(output.events[0].restingOrderId, 2);
+    EXPECT_EQ(output.events[1].restingOrderId, 1);
+    EXPECT_EQ(output.events[1].quantity, 100);
+    EXPECT_EQ(output.events[2].type, EventType::ORDER_REPLENISHED);
+    EXPECT_EQ(engine.GetRiskManager().OpenOrders(0, 0), 1);
+
+    // The hidden reserve counts for FOK orders
+    Order fokTooLarge{ 5, 0, Side::BUY, OrderType::FOK, 101, 15000 };
+    engine.SubmitOrder(&fokTooLarge);
+    EXPECT_EQ(output.events.back().type, EventType::ORDER_CANCELLED);
+    EXPECT_EQ(output.events.back().orderId, 5);
+
+    Order fok{ 6, 0, Side::BUY, OrderType::FOK, 100, 15000 };
+    engine.SubmitOrder(&fok);
+    EXPECT_EQ(output.events.back().type, EventType::ORDER_FILLED);
+    EXPECT_EQ(engine.GetBook(0)->GetTopOfBook().second, engine.GetBook(0)->NumPriceLevels());
+    EXPECT_EQ(engine.GetRiskManager().OpenOrders(0, 0), 0);
+}
+
+TEST_F(MatchingEngineTest, IcebergCancelAndModifyIncludeReserve)
+{
+    Order iceberg{ 1, 0, Side::BUY, OrderType::LIMIT, 500, 15000 };
+    iceberg.displayQuantity = 100;
+    engine.SubmitOrder(&iceberg);
+
+    // Reduction comes out of the reserve and keeps the shown slice
+    engine.ModifyOrder(1, 250, 15000, 2);
+    EXPECT_EQ(output.events.back().type, EventType::ORDER_REPLACED);
+    EXPECT_EQ(output.events.back().quantity, 100);
+
+    Order fokTooLarge{ 3, 0, Side::SELL, OrderType::FOK, 251, 15000 };
+    engine.SubmitOrder(&fokTooLarge);
+    EXPECT_EQ(output.events.back().type, EventType::ORDER_CANCELLED);
+
+    engine.CancelOrder(1, 4);
+    Order fok{ 5, 0, Side::SELL, OrderType::FOK, 1, 15000 };
+    engine.SubmitOrder(&fok);
+    EXPECT_EQ(output.events.back().type, EventType::ORDER_CANCELLED);
+    EXPECT_EQ(output.events.back().orderId, 5);
+}
+
+TEST_F(MatchingEngineTest, StopOrdersCascadeInTriggerOrder)
+{
+    Order ask1{ 1, 0, Side::SELL, OrderType::LIMIT, 100, 15000 };
+    Order ask2{ 2, 0, Side::SELL, OrderType::LIMIT, 100, 15001 };
+    Order ask3{ 3, 0, Side::SELL, OrderType::LIMIT, 100, 15002 };
+    Order stop{ 4, 0, Side::BUY, OrderType::STOP, 100, 0 };
+    stop.stopPrice = 15001;
+    Order stopLimit{ 5, 0, Side::BUY, OrderType::STOP_LIMIT, 100, 15001 };
+    stopLimit.stopPrice = 15000;
+    for (auto order : { &ask1, &ask2, &ask3, &stop, &stopLimit })
+        engine.SubmitOrder(order);
+    EXPECT_EQ(output.events[3].type, EventType::STOP_ACCEPTED);
+    EXPECT_EQ(output.events[4].type, EventType::STOP_ACCEPTED);
+    output.events.clear();
+
+    // The trade at 15000 triggers the stop-limit, whose trade at 15001 triggers the stop
+    Order buy{ 6, 0, Side::BUY, OrderType::LIMIT, 100, 15000 };
+    engine.SubmitOrder(&buy);
+    ASSERT_EQ(output.events.size(), 3);
+    EXPECT_EQ(output.events[0].orderId, 6);
+    EXPECT_EQ(output.events[0].price, 15000);
+    EXPECT_EQ(output.events[1].orderId, 5);
+    EXPECT_EQ(output.events[1].price, 15001);
+    EXPECT_EQ(output.events[2].orderId, 4);
+    EXPECT_EQ(output.events[2].price, 15002);
+
+    // Already through its stop price, so it runs at once, and finds no liquidity
+    Order late{ 7, 0, Side::BUY, OrderType::STOP, 100, 0 };
+    late.stopPrice = 15000;
+    engine.SubmitOrder(&late);
+    EXPECT_EQ(output.events.back().type, EventType::ORDER_CANCELLED);
+    EXPECT_EQ(output.events.back().orderId, 7);
+
+    Order invalid{ 8, 0, Side::SELL, OrderType::STOP, 100, 0 };
+    engine.SubmitOrder(&invalid);
+    EXPECT_EQ(output.events.back().rejectionReason, RejectionType::INVALID_PRICE);
+}
+
+TEST_F(MatchingEngineTest, PendingStopsCanBeCancelled)
+{
+    Order stop{ 1, 0, Side::SELL, OrderType::STOP, 100, 0, 3 };
+    stop.stopPrice = 14000;
+    Order other{ 2, 0, Side::SELL, OrderType::STOP_LIMIT, 100, 13900, 4 };
+    other.stopPrice = 14000;
+    engine.SubmitOrder(&stop);
+    engine.SubmitOrder(&other);
+
+    EXPECT_EQ(engine.MassCancel({ .requestId = 3, .sessionId = 3 }), 1);
+    EXPECT_EQ(output.events.back().type, EventType::STOP_CANCELLED);
+    EXPECT_EQ(output.events.back().orderId, 1);
+
+    EXPECT_TRUE(engine.CancelOrder(2, 4));
+    EXPECT_EQ(output.events.back().type, EventType::STOP_CANCELLED);
+    engine.CancelOrder(2, 5);
+    EXPECT_EQ(output.events.back().rejectionReason, RejectionType::ORDER_NOT_FOUND);
+
+    // Nothing left to trigger
+    Order bid{ 6, 0, Side::BUY, OrderType::LIMIT, 100, 13000 };
+    Order sell{ 7, 0, Side::SELL, OrderType::LIMIT, 100, 13000 };
+    engine.SubmitOrder(&bid);
+    engine.SubmitOrder(&sell);
+    EXPECT_EQ(output.events.back().type, EventType::ORDER_FILLED);
+    EXPECT_EQ(output.events.back().orderId, 7);
+}
+
+TEST_F(MatchingEngineTest, MassCancelStopsBySessionAndSide)
+{
+    std::vector<Order> stops{
+        { 1, 0, Side::SELL, OrderType::STOP, 100, 0, 3 },
+        { 2, 0, Side::BUY, OrderType::STOP, 100, 0, 3 },
+        { 3, 0, Side::SELL, OrderType::STOP, 100, 0, 3 },
+        { 4, 0, Side::SELL, OrderType::STOP, 100, 0, 4 },
+    };
+    for (auto & stop : stops)
+    {
+        stop.stopPrice = stop.side == Side::BUY ? 16000 : 14000;
+        engine.SubmitOrder(&stop);
+    }
+
+    // Unlinks the head of session 3's list
+    EXPECT_TRUE(engine.CancelOrder(3, 5));
+
+    EXPECT_EQ(engine.MassCancel({ .requestId = 6, .side = Side::SELL, .sessionId = 3 }), 1);
+    EXPECT_EQ(output.events.back().type, EventType::STOP_CANCELLED);
+    EXPECT_EQ(output.events.back().orderId, 1);
+
+    std::set<uint64_t> cancelled;
+    output.events.clear();
+    EXPECT_EQ(engine.MassCancel({ .requestId = 7 }), 2);
+    for (const auto & event : output.events)
+        cancelled.insert(event.orderId);
+    EXPECT_EQ(cancelled, (std::set<uint64_t>{ 2, 4 }));
+    EXPECT_EQ(engine.MassCancel({ .requestId = 8 }), 0);
+}
+
+TEST(InstrumentClassTest, BooksAreSizedAndLimitedPerClass)
+{
+    VectorOutputPolicy output;
+    SymbolDirectory symbols;
+    symbols.Add("AAPL");
+    symbols.Add("ES", InstrumentClass::FUTURE);
+    symbols.Add("PNY", InstrumentClass::PENNY_STOCK);
+    MatchingEngine<VectorOutputPolicy> engine(nullptr, output, symbols, 100);
+
+    EXPECT_EQ(engine.GetBook(0)->NumPriceLevels(), 1'000'001);
+    EXPECT_EQ(engine.GetBook(1)->NumPriceLevels(), 40'001);
+    EXPECT_EQ(engine.GetBook(2)->NumPriceLevels(), 10'001);
+    EXPECT_EQ(engine.GetBook(1)->Class(), InstrumentClass::FUTURE);
+
+    // Prices past the ladder and quantities wider than the class allows are rejected
+    Order farFuture{ 1, 1, Side::SELL, OrderType::LIMIT, 10, 40'001 };
+    engine.SubmitOrder(&farFuture);
+    EXPECT_EQ(output.events.back().rejectionReason, RejectionType::INVALID_PRICE);
+
+    Order bigFuture{ 2, 1, Side::SELL, OrderType::LIMIT, 70'000, 20'000 };
+    engine.SubmitOrder(&bigFuture);
+    EXPECT_EQ(output.events.back().rejectionReason, RejectionType::INVALID_QUANTITY);
+
+    Order bigEquity{ 3, 0, Side::SELL, OrderType::LIMIT, 70'000, 20'000 };
+    engine.SubmitOrder(&bigEquity);
+    EXPECT_EQ(output.events.back().type, EventType::ORDER_ACKED);
+
+    Order farPennyStop{ 4, 2, Side::BUY, OrderType::STOP, 10, 0 };
+    farPennyStop.stopPrice = 15'000;
+    engine.SubmitOrder(&farPennyStop);
+    EXPECT_EQ(output.events.back().rejectionReason, RejectionType::INVALID_PRICE);
+
+    // Matching is the same in every class
+    Order ask{ 5, 1, Side::SELL, OrderType::LIMIT, 65'000, 40'000 };
+    Order bid{ 6, 1, Side::BUY, OrderType::LIMIT, 65'535, 40'000 };
+    engine.SubmitOrder(&ask);
+    engine.SubmitOrder(&bid);
+    EXPECT_EQ(output.events[output.events.size() - 2].type, EventType::ORDER_FILLED);
+    EXPECT_EQ(output.events[output.events.size() - 2].quantity, 65'000);
+    EXPECT_EQ(output.events.back().type, EventType::ORDER_ACKED);
+    EXPECT_EQ(output.events.back().quantity, 535);
+    EXPECT_EQ(engine.GetBook(1)->GetTopOfBook(), std::make_pair(40'000u, 40'001u));
+
+    EXPECT_FALSE(engine.ModifyOrder(6, 600, 40'001, 7));
+    EXPECT_EQ(output.events.back().rejectionReason, RejectionType::INVALID_PRICE);
+}
+
+TEST(SymbolDirectoryTest, LoadsSymbolsAndClasses)
+{
+    auto path = testing::TempDir() + "symbols.txt";
+    {
+        std::ofstream out(path);
+        out << "# symbol class\n\nAAPL\nES future\n  PNY   penny  \n";
+    }
+
+    auto symbols = SymbolDirectory::Load(path);
+    ASSERT_EQ(symbols.Size(), 3);
+    EXPECT_EQ(symbols.Name(1), "ES");
+    EXPECT_EQ(symbols.Class(0), InstrumentClass::EQUITY);
+    EXPECT_EQ(symbols.Class(1), InstrumentClass::FUTURE);
+    EXPECT_EQ(symbols.Class(2), InstrumentClass::PENNY_STOCK);
+    EXPECT_EQ(symbols.Find("PNY"), 2);
+    EXPECT_EQ(symbols.Find("MSFT"), std::nullopt);
+
+    // Copies hand out views into their own names
+    SymbolDirectory copy = symbols;
+    symbols = SymbolDirectory::Default(1);
+    EXPECT_EQ(copy.Find("ES"), 1);
+    EXPECT_EQ(copy.Name(2), "PNY");
+
+    {
+        std::ofstream out(path);
+        out << "AAPL bond\n";
+    }
+    EXPECT_THROW(SymbolDirectory::Load(path), std::runtime_error);
+    {
+        std::ofstream out(path);
+        out << "AAPL\nAAPL future\n";
+    }
+    EXPECT_THROW(SymbolDirectory::Load(path), std::runtime_error);
+    std::remove(path.c_str());
+
+    EXPECT_THROW(SymbolDirectory::Default(NUM_DEFAULT_SYMBOLS + 1), std::runtime_error);
+}
+
+TEST(SymbolDirectoryTest, BooksAreCreatedOnFirstUse)
+{
+    VectorOutputPolicy output;
+    MatchingEngine<VectorOutputPolicy> engine(nullptr, output, SymbolDirectory::Synthetic(10'000), 100);
+    EXPECT_EQ(engine.NumActiveBooks(), 0);
+
+    // Account-wide limits and a market-wide auction also hold for books created afterwards
+    engine.GetRiskManager().SetLimits(1, RiskLimits{ .maxOrderQuantity = 500 });
+    engine.OpenAuction();
+
+    Order ask{ 1, 9'999, Side::SELL, OrderType::LIMIT, 100, 10'000 };
+    engine.SubmitOrder(&ask);
+    EXPECT_EQ(engine.NumActiveBooks(), 1);
+    EXPECT_EQ(output.events.back().type, EventType::ORDER_ACKED);
+    EXPECT_EQ(output.events.back().symbolId, 9'999);
+    EXPECT_TRUE(engine.GetBook(9'999)->InAuction());
+
+    Order big{ 2, 5'000, Side::BUY, OrderType::LIMIT, 1'000, 10'000 };
+    big.accountId = 1;
+    engine.SubmitOrder(&big);
+    EXPECT_EQ(output.events.back().rejectionReason, RejectionType::ORDER_SIZE_LIMIT);
+
+    Order market{ 3, 5'000, Side::BUY, OrderType::MARKET, 10, 0 };
+    engine.SubmitOrder(&market);
+    EXPECT_EQ(output.events.back().rejectionReason, RejectionType::NOT_ALLOWED_IN_AUCTION);
+
+    Order bid{ 4, 9'999, Side::BUY, OrderType::LIMIT, 40, 10'000 };
+    engine.SubmitOrder(&bid);
+    EXPECT_EQ(engine.Uncross(), 40);
+    EXPECT_FALSE(engine.GetBook(9'999)->InAuction());
+
+    // Market-wide requests only visit books that exist
+    EXPECT_EQ(engine.MassCancel(MassCancelRequest{}), 1);
+    EXPECT_EQ(output.events.back().orderId, 1);
+    EXPECT_EQ(engine.NumActiveBooks(), 2);
+    EXPECT_THROW(engine.GetBook(10'000), std::runtime_error);
+}
+
+TEST(PriceBitmapTest, FindsNeighboursAcrossWords)
+{
+    const uint32_t levels = 300'000;
+    PriceBitmap bitmap(levels);
+    std::vector<bool> reference(levels);
+
+    std::mt19937 gen(3);
+    for (int i = 0; i < 200; i++)
+    {
+        uint32_t price = gen() % levels;
+        bitmap.Set(price);
+        reference[price] = true;
+    }
+    for (int i = 0; i < 100; i++)
+    {
+        uint32_t price = gen() % levels;
+        bitmap.Clear(price);
+        reference[price] = false;
+    }
+
+    for (int i = 0; i < 2000; i++)
+    {
+        uint32_t price = gen() % levels;
+
+        uint32_t next = PriceBitmap::NONE;
+        for (uint32_t p = price; p < levels; p++)
+            if (reference[p]) { next = p; break; }
+
+        uint32_t prev = PriceBitmap::NONE;
+        for (uint32_t p = price + 1; p-- > 0;)
+            if (reference[p]) { prev = p; break; }
+
+        EXPECT_EQ(bitmap.NextSet(price), next);
+        EXPECT_EQ(bitmap.PrevSet(price), prev);
+    }
+}
+
+TEST(TimerTest, CalibrationConvertsBothWays)
+{
+    EXPECT_GT(Timer::tsc_hz(), 100'000'000);
+    EXPECT_LT(Timer::tsc_hz(), 10'000'000'000);
+    EXPECT_FALSE(Timer::calibration_source().empty());
+
+    uint64_t cycles = Timer::ns_to_cycles(1'000'000'000);
+    EXPECT_NEAR(static_cast<double>(cycles), Timer::tsc_hz(), Timer::tsc_hz() * 1e-6);
+    EXPECT_NEAR(static_cast<double>(Timer::cycles_to_ns(cycles)), 1e9, 1e3);
+
+    // A window measured with the fenced reads agrees with steady_clock
+    auto startTime = std::chrono::steady_clock::now();
+    uint64_t start = Timer::rdtsc_fenced();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    uint64_t end = Timer::rdtscp();
+    auto elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+    EXPECT_NEAR(static_cast<double>(Timer::cycles_to_ns(end - start)), elapsedNs, elapsedNs * 0.05);
+}
+
+TEST(ItchEncoderTest, EncodesBatchBackToBack)
+{
+    auto symbols = SymbolDirectory::Default(2);
+    ItchEncoder encoder(symbols);
+
+    std::vector<MarketDataEvent> events;
+    events.push_back(MarketDataEvent(7, 7, 1, Side::SELL, 15'000, 300));
+    events.push_back(MarketDataEvent(8, 8, 1, 0x0001'0000'0000'002a, 7, 15'000, 100));
+    events.back().side = Side::BUY;
+    events.push_back(MarketDataEvent(7, 9));
+    events.push_back(MarketDataEvent(8, 8, RejectionType::INVALID_PRICE));
+    events.push_back(MarketDataEvent(EventType::TRADING_HALTED, 0, 10, 0, Side::BUY, 14'000, 0));
+    for (auto & event : events)
+        event.timestamp = 0x0102'0304'0506'0708;
+
+    std::vector<char> buffer(ItchEncoder::BufferSize(events.size()));
+    std::vector<uint16_t> lengths(events.size() * ItchEncoder::MAX_MESSAGES_PER_EVENT);
+    uint64_t sequenceNumber = 100;
+    size_t count = encoder.Encode(events, sequenceNumber, buffer.data(), lengths.data());
+
+    ASSERT_EQ(count, 6);
+    EXPECT_EQ(sequenceNumber, 106);
+    std::vector<const char*> msgs;
+    for (size_t i = 0, offset = 0; i < count; offset += lengths[i++])
+    {
+        msgs.push_back(buffer.data() + offset);
+        auto header = reinterpret_cast<const ItchHeader*>(msgs.back());
+        EXPECT_EQ(be64toh(header->sequenceNumber), 100 + i);
+        EXPECT_EQ(be64toh(header->timestamp), 0x0102'0304'0506'0708);
+    }
+
+    auto add = reinterpret_cast<const OrderAddMsg*>(msgs[0]);
+    EXPECT_EQ(lengths[0], sizeof(OrderAddMsg));
+    EXPECT_EQ(add->header.messageType, 'A');
+    EXPECT_EQ(be64toh(add->orderId), 7);
+    EXPECT_EQ(add->side, 'S');
+    EXPECT_EQ(be32toh(add->quantity), 300);
+    EXPECT_EQ(be32toh(add->price), 15'000);
+    EXPECT_EQ(std::string_view(add->symbol, strnlen(add->symbol, sizeof(add->symbol))), "MSFT");
+
+    auto aggressor = reinterpret_cast<const OrderExecMsg*>(msgs[1]);
+    auto resting = reinterpret_cast<const OrderExecMsg*>(msgs[2]);
+    EXPECT_EQ(aggressor->header.messageType, 'E');
+    EXPECT_EQ(be64toh(aggressor->orderId), 8);
+    EXPECT_EQ(be64toh(resting->orderId), 7);
+    EXPECT_EQ(be32toh(resting->quantity), 100);
+    EXPECT_EQ(be64toh(resting->matchId), 0x0001'0000'0000'002a);
+
+    auto trade = reinterpret_cast<const TradeMsg*>(msgs[3]);
+    EXPECT_EQ(lengths[3], sizeof(TradeMsg));
+    EXPECT_EQ(trade->header.messageType, 'P');
+    EXPECT_EQ(trade->side, 'B');
+    EXPECT_EQ(be32toh(trade->price), 15'000);
+    EXPECT_EQ(be64toh(trade->matchId), 0x0001'0000'0000'002a);
+
+    auto deleted = reinterpret_cast<const OrderDeleteMsg*>(msgs[4]);
+    EXPECT_EQ(deleted->header.messageType, 'D');
+    EXPECT_EQ(be64toh(deleted->orderId), 7);
+
+    // The rejection produces no message
+    auto action = reinterpret_cast<const TradingActionMsg*>(msgs[5]);
+    EXPECT_EQ(action->header.messageType, 'H');
+    EXPECT_EQ(std::string_view(action->symbol, strnlen(action->symbol, sizeof(action->symbol))), "AAPL");
+    EXPECT_EQ(action->tradingState, 'H');
+}
+
+// Socket joined to a market data multicast group on loopback, as the feed handler does
+static int JoinMarketDataGroup(const FeedAddress & address = {})
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    int reuse = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    timeval timeout = { 1, 0 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    sockaddr_in local = address.SocketAddress();
+    bind(sock, reinterpret_cast<sockaddr*>(&local), sizeof(local));
+
+    ip_mreq group = {};
+    group.imr_multiaddr = local.sin_addr;
+    group.imr_interface.s_addr = inet_addr("127.0.0.1");
+    setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &group, sizeof(group));
+    return sock;
+}
+
+// A transmitter with a mirror sends each message once on A and the identical bytes on B
+template<typename Transmitter>
+static void ExpectMirroredFeeds(Transmitter & a, Transmitter & b, int sockA, int sockB)
+{
+    ItchEncoder encoder(SymbolDirectory::Default(2));
+    std::vector<MarketDataEvent> events;
+    events.push_back(MarketDataEvent(7, 7, 1, Side::SELL, 15'000, 300));
+    events.push_back(MarketDataEvent(8, 8, 1, 42, 7, 15'000, 100));
+
+    a.SetMirror(&b);
+    a.SendBatch(events, encoder);
+    a.SendEndMarketHours();
+
+    for (uint64_t s = 1; s <= 5; s++)
+    {
+        char bufA[128], bufB[128];
+        ssize_t lengthA = recv(sockA, bufA, sizeof(bufA), 0);
+        ssize_t lengthB = recv(sockB, bufB, sizeof(bufB), 0);
+        ASSERT_GE(lengthA, static_cast<ssize_t>(sizeof(ItchHeader))) << "message " << s;
+        ASSERT_EQ(lengthA, lengthB) << "message " << s;
+        EXPECT_EQ(memcmp(bufA, bufB, lengthA), 0) << "message " << s;
+        EXPECT_EQ(be64toh(reinterpret_cast<const ItchHeader*>(bufA)->sequenceNumber), s);
+    }
+}
+
+TEST(MirroredFeedTest, SendsSameMessagesOnBothFeeds)
+{
+    FeedAddress feedA, feedB = FeedAddress::DefaultB();
+    int sockA = JoinMarketDataGroup(feedA);
+    int sockB = JoinMarketDataGroup(feedB);
+    {
+        UDPTransmitter a(feedA), b(feedB);
+        ExpectMirroredFeeds(a, b, sockA, sockB);
+    }
+    try
+    {
+        IoUringTransmitter a(feedA, { .sqPoll = false }), b(feedB, { .sqPoll = false });
+        ExpectMirroredFeeds(a, b, sockA, sockB);
+    }
+    catch (const std::runtime_error & e)
+    {
+        std::cout << "io_uring not available: " << e.what() << "\n";
+    }
+    close(sockA);
+    close(sockB);
+}
+
+TEST(IoUringTransmitterTest, SendsEachMessageAsOneDatagram)
+{
+    auto symbols = SymbolDirectory::Default(2);
+    ItchEncoder encoder(symbols);
+
+    std::vector<MarketDataEvent> events;
+    events.push_back(MarketDataEvent(7, 7, 1, Side::SELL, 15'000, 300));
+    events.push_back(MarketDataEvent(8, 8, 1, 42, 7, 15'000, 100));
+    events.push_back(MarketDataEvent(7, 9));
+
+    std::vector<char> expected(ItchEncoder::BufferSize(events.size()));
+    std::vector<uint16_t> lengths(events.size() * ItchEncoder::MAX_MESSAGES_PER_EVENT);
+    uint64_t sequenceNumber = 1;
+    size_t count = encoder.Encode(events, sequenceNumber, expected.data(), lengths.data());
+    ASSERT_EQ(count, 5);
+
+    for (bool zeroCopy : { false, true })
+    {
+        int sock = JoinMarketDataGroup();
+        {
+            std::unique_ptr<IoUringTransmitter> transmitter;
+            try
+            {
+                transmitter = std::make_unique<IoUringTransmitter>(FeedAddress{}, IoUringOptions{ .sqPoll = false, .zeroCopy = zeroCopy });
+            }
+            catch (const std::runtime_error & e)
+            {
+                close(sock);
+                GTEST_SKIP() << e.what();
+            }
+            transmitter->SendBatch(events, encoder);
+            transmitter->SendEndMarketHours();
+        }
+
+        char datagram[64];
+        for (size_t i = 0, offset = 0; i < count; offset += lengths[i++])
+        {
+            ASSERT_EQ(recv(sock, datagram, sizeof(datagram), 0), lengths[i]) << "message " << i << ", zero copy " << zeroCopy;
+            EXPECT_EQ(memcmp(datagram, expected.data() + offset, lengths[i]), 0) << "message " << i << ", zero copy " << zeroCopy;
+        }
+        ASSERT_EQ(recv(sock, datagram, sizeof(datagram), 0), sizeof(EndMarketMsg));
+        EXPECT_EQ(reinterpret_cast<const EndMarketMsg*>(datagram)->header.messageType, 'M');
+        EXPECT_EQ(be64toh(reinterpret_cast<const EndMarketMsg*>(datagram)->header.sequenceNumber), count + 1);
+        close(sock);
+    }
+}
+
+TEST(FeedCaptureTest, CaptureReadsBackIntoDecoder)
+{
+    auto symbols = SymbolDirectory::Default(2);
+    ItchEncoder encoder(symbols);
+
+    std::vector<MarketDataEvent> events;
+    events.push_back(MarketDataEvent(7, 7, 1, Side::SELL, 15'000, 300));
+    events.push_back(MarketDataEvent(8, 8, 1, 42, 7, 15'000, 100));
+    events.push_back(MarketDataEvent(7, 9));
+    events.push_back(MarketDataEvent(EventType::TRADING_HALTED, 0, 10, 0, Side::BUY, 14'000, 0));
+
+    std::vector<char> encoded(ItchEncoder::BufferSize(events.size()));
+    std::vector<uint16_t> lengths(events.size() * ItchEncoder::MAX_MESSAGES_PER_EVENT);
+    std::vector<char> firstBatch;
+
+    // Enough batches to wrap the capture ring, then one skipped sequence number before the end
+    const size_t numBatches = 20'000;
+    uint64_t sequenceNumber = 1;
+    size_t count = 0;
+    auto path = testing::TempDir() + "feed_capture_test.pcap";
+    {
+        FeedCapture capture(path);
+        for (size_t i = 0; i < numBatches; i++)
+        {
+            count = encoder.Encode(events, sequenceNumber, encoded.data(), lengths.data());
+            capture.Write(encoded.data(), lengths.data(), count);
+            if (i == 0)
+                firstBatch.assign(encoded.begin(), encoded.begin() + std::accumulate(lengths.begin(), lengths.begin() + count, size_t(0)));
+        }
+
+        EndMarketMsg end{ { htobe64(sequenceNumber + 1), 'M', 0 } };
+        uint16_t endLength = sizeof(end);
+        capture.Write(reinterpret_cast<const char*>(&end), &endLength, 1);
+    }
+    ASSERT_EQ(count, 6);
+
+    PcapReader reader(path);
+    PcapReader::Packet packet;
+    FeedStats stats;
+    FeedDecoder decoder(stats);
+    uint64_t previousTimestamp = 0;
+    for (size_t i = 0, offset = 0; i < numBatches * count; i++)
+    {
+        ASSERT_TRUE(reader.Next(packet)) << "message " << i;
+        ASSERT_EQ(packet.payload.size(), lengths[i % count]) << "message " << i;
+        if (i < count)
+        {
+            EXPECT_EQ(memcmp(packet.payload.data(), firstBatch.data() + offset, packet.payload.size()), 0) << "message " << i;
+            offset += packet.payload.size();
+        }
+        EXPECT_GE(packet.timestampNs, previousTimestamp);
+        previousTimestamp = packet.timestampNs;
+        EXPECT_TRUE(decoder.Decode(packet.payload.data(), packet.payload.size()));
+    }
+    ASSERT_TRUE(reader.Next(packet));
+    EXPECT_FALSE(decoder.Decode(packet.payload.data(), packet.payload.size()));
+    EXPECT_FALSE(reader.Next(packet));
+
+    EXPECT_EQ(stats.orderAdds, numBatches);
+    EXPECT_EQ(stats.orderExecutions, 2 * numBatches);
+    EXPECT_EQ(stats.trades, numBatches);
+    EXPECT_EQ(stats.volume, 100 * numBatches);
+    EXPECT_EQ(stats.orderDeletes, numBatches);
+    EXPECT_EQ(stats.tradingActions, numBatches);
+    EXPECT_EQ(stats.gaps, 1);
+    EXPECT_EQ(decoder.MessagesDropped(), 1);
+    EXPECT_EQ(decoder.MessagesProcessed(), numBatches * count + 1);
+    EXPECT_TRUE(decoder.Finished());
+    std::remove(path.c_str());
+}
+
+TEST(FeedCaptureTest, FailedWriteStopsCaptureWithoutBlockingSender)
+{
+    if (access("/dev/full", W_OK) != 0)
+        GTEST_SKIP() << "/dev/full not available";
+
+    ItchEncoder encoder(SymbolDirectory::Default(2));
+    std::vector<MarketDataEvent> events(64, MarketDataEvent(7, 7, 1, Side::SELL, 15'000, 300));
+    std::vector<char> encoded(ItchEncoder::BufferSize(events.size()));
+    std::vector<uint16_t> lengths(events.size() * ItchEncoder::MAX_MESSAGES_PER_EVENT);
+
+    // Every write fails with ENOSPC. Far more than a ring's worth still goes through.
+    uint64_t sequenceNumber = 1;
+    FeedCapture capture("/dev/full");
+    for (size_t i = 0; i < 10'000; i++)
+    {
+        size_t count = encoder.Encode(events, sequenceNumber, encoded.data(), lengths.data());
+        capture.Write(encoded.data(), lengths.data(), count);
+    }
+    EXPECT_EQ(sequenceNumber, 64 * 10'000 + 1);
+}
+
+// Messages of `numBatches` encoded batches, numbered from 1, then the end of market hours message
+static std::vector<std::string> EncodeFeed(size_t numBatches)
+{
+    ItchEncoder encoder(SymbolDirectory::Default(2));
+    std::vector<MarketDataEvent> events;
+    events.push_back(MarketDataEvent(7, 7, 1, Side::SELL, 15'000, 300));
+    events.push_back(MarketDataEvent(8, 8, 1, 42, 7, 15'000, 100));
+    events.push_back(MarketDataEvent(7, 9));
+
+    std::vector<char> encoded(ItchEncoder::BufferSize(events.size()));
+    std::vector<uint16_t> lengths(events.size() * ItchEncoder::MAX_MESSAGES_PER_EVENT);
+    std::vector<std::string> messages;
+    uint64_t sequenceNumber = 1;
+    for (size_t i = 0; i < numBatches; i++)
+    {
+        size_t count = encoder.Encode(events, sequenceNumber, encoded.data(), lengths.data());
+        for (size_t j = 0, offset = 0; j < count; offset += lengths[j++])
+            messages.emplace_back(encoded.data() + offset, lengths[j]);
+    }
+
+    EndMarketMsg end{ { htobe64(sequenceNumber), 'M', 0 } };
+    messages.emplace_back(reinterpret_cast<const char*>(&end), sizeof(end));
+    return messages;
+}
+
+// Handler that records the sequence number of every message it is given
+struct SequenceRecorder
+{
+    std::vector<uint64_t> sequenceNumbers;
+    uint64_t gaps = 0;
+
+    template<typename Msg>
+    void Record(const Msg & msg) { sequenceNumbers.push_back(be64toh(msg.header.sequenceNumber)); }
+
+    void OnOrderAdd(const OrderAddMsg & msg) { Record(msg); }
+    void OnOrderExecuted(const OrderExecMsg & msg) { Record(msg); }
+    void OnOrderDeleted(const OrderDeleteMsg & msg) { Record(msg); }
+    void OnOrderReplaced(const OrderReplaceMsg & msg) { Record(msg); }
+    void OnTradingAction(const TradingActionMsg & msg) { Record(msg); }
+    void OnTrade(const TradeMsg & msg) { Record(msg); }
+    void OnSequenceGap(uint64_t expected, uint64_t received) { gaps++; }
+};
+
+TEST(FeedArbitratorTest, TakesFirstCopyAndOnlyLosesWhatBothFeedsMiss)
+{
+    auto messages = EncodeFeed(20'000);
+    const size_t numMessages = messages.size();
+    const size_t lag = 5;
+
+    // Each feed loses 10% of the messages independently, the end of market hours message excepted
+    std::mt19937 gen(11);
+    std::bernoulli_distribution lossDist(0.1);
+    std::vector<bool> lostA(numMessages), lostB(numMessages);
+    for (size_t i = 0; i + 1 < numMessages; i++)
+    {
+        lostA[i] = lossDist(gen);
+        lostB[i] = lossDist(gen);
+    }
+
+    SequenceRecorder recorder;
+    FeedArbitrator arbitrator(recorder);
+    bool running = true;
+    auto send = [&](Feed feed, size_t i) {
+        const auto & lost = feed == Feed::A ? lostA : lostB;
+        if (!lost[i])
+            running = arbitrator.OnPacket(feed, messages[i].data(), messages[i].size());
+    };
+
+    // B runs a few messages behind A, so its last copies arrive after the end and are duplicates
+    for (size_t i = 0; i < numMessages + lag; i++)
+    {
+        if (i < numMessages)
+            send(Feed::A, i);
+        if (i >= lag)
+            send(Feed::B, i - lag);
+    }
+    EXPECT_FALSE(running);
+
+    std::vector<uint64_t> expected;
+    uint64_t lostOnBoth = 0, onBoth = 0, onlyB = 0, gaps = 0;
+    for (size_t i = 0; i < numMessages; i++)
+    {
+        if (lostA[i] && lostB[i])
+        {
+            lostOnBoth++;
+            gaps += i == 0 || !(lostA[i - 1] && lostB[i - 1]);
+            continue;
+        }
+        onBoth += !lostA[i] && !lostB[i];
+        onlyB += lostA[i];
+        if (i + 1 < numMessages)
+            expected.push_back(i + 1);
+    }
+    ASSERT_GT(lostOnBoth, 0);
+
+    EXPECT_EQ(recorder.sequenceNumbers, expected);
+    EXPECT_EQ(recorder.gaps, gaps);
+
+    const auto & decoder = arbitrator.Decoder();
+    EXPECT_TRUE(decoder.Finished());
+    EXPECT_EQ(decoder.MessagesDropped(), lostOnBoth);
+    EXPECT_EQ(decoder.MessagesProcessed(), numMessages - lostOnBoth);
+
+    const auto & stats = arbitrator.GetStats();
+    EXPECT_EQ(stats.received[0], std::count(lostA.begin(), lostA.end(), false));
+    EXPECT_EQ(stats.received[1], std::count(lostB.begin(), lostB.end(), false));
+    EXPECT_EQ(stats.duplicates, onBoth);
+    EXPECT_EQ(stats.taken[1], onlyB);
+    EXPECT_EQ(stats.taken[0] + stats.taken[1], numMessages - lostOnBoth);
+}
+
+TEST(FeedArbitratorTest, FlushGivesUpHolesWhenAFeedStops)
+{
+    // 20 messages and the end of market hours message as 21
+    auto messages = EncodeFeed(4);
+    ASSERT_EQ(messages.size(), 21);
+
+    SequenceRecorder recorder;
+    FeedArbitrator arbitrator(recorder);
+
+    // B delivers 1 to 10 and stops, A misses 8 and 15
+    for (uint64_t s = 1; s <= 10; s++)
+        EXPECT_TRUE(arbitrator.OnPacket(Feed::B, messages[s - 1].data(), messages[s - 1].size()));
+    for (uint64_t s = 1; s <= 21; s++)
+    {
+        if (s != 8 && s != 15)
+            EXPECT_TRUE(arbitrator.OnPacket(Feed::A, messages[s - 1].data(), messages[s - 1].size()));
+    }
+
+    // 16 onwards wait for B to fill 15
+    EXPECT_EQ(recorder.sequenceNumbers.size(), 14);
+    EXPECT_FALSE(arbitrator.Decoder().Finished());
+    EXPECT_EQ(arbitrator.GetStats().duplicates, 9);
+
+    arbitrator.Flush();
+    EXPECT_EQ(recorder.sequenceNumbers.size(), 19);
+    EXPECT_EQ(recorder.sequenceNumbers.back(), 20);
+    EXPECT_EQ(recorder.gaps, 1);
+    EXPECT_EQ(arbitrator.Decoder().MessagesDropped(), 1);
+    EXPECT_TRUE(arbitrator.Decoder().Finished());
+}
+
+TEST(FeedArbitratorTest, GivesUpHoleOnceWindowOverflows)
+{
+    using Arbitrator = FeedArbitrator<SequenceRecorder>;
+    const uint64_t hole = 100;
+    const uint64_t lastHeld = hole + Arbitrator::WINDOW_SIZE - 1;
+
+    auto messages = EncodeFeed(1'000);
+    ASSERT_GT(messages.size(), lastHeld + 1);
+
+    SequenceRecorder recorder;
+    Arbitrator arbitrator(recorder);
+
+    // B delivers a few messages and stops, A misses one that B never fills
+    for (uint64_t s = 1; s <= 5; s++)
+        arbitrator.OnPacket(Feed::B, messages[s - 1].data(), messages[s - 1].size());
+
+    for (uint64_t s = 1; s <= lastHeld; s++)
+    {
+        if (s != hole)
+            arbitrator.OnPacket(Feed::A, messages[s - 1].data(), messages[s - 1].size());
+    }
+    // Everything after the hole waits in the full window
+    EXPECT_EQ(recorder.sequenceNumbers.size(), hole - 1);
+    EXPECT_EQ(recorder.gaps, 0);
+
+    // One more message than the window holds gives the hole up
+    arbitrator.OnPacket(Feed::A, messages[lastHeld].data(), messages[lastHeld].size());
+    EXPECT_EQ(recorder.sequenceNumbers.size(), lastHeld);
+    EXPECT_EQ(recorder.gaps, 1);
+
+    for (uint64_t s = lastHeld + 2; s <= messages.size(); s++)
+        arbitrator.OnPacket(Feed::A, messages[s - 1].data(), messages[s - 1].size());
+
+    std::vector<uint64_t> expected;
+    for (uint64_t s = 1; s < messages.size(); s++)
+    {
+        if (s != hole)
+            expected.push_back(s);
+    }
+    EXPECT_EQ(recorder.sequenceNumbers, expected);
+    EXPECT_EQ(recorder.gaps, 1);
+    EXPECT_EQ(arbitrator.Decoder().MessagesDropped(), 1);
+    EXPECT_TRUE(arbitrator.Decoder().Finished());
+}
+
+TEST(PrefixSumTest, MatchesScalarSum)
+{
+    std::mt19937 gen(7);
+    for (size_t count : { 0, 1, 3, 4, 5, 8, 37, 1000 })
+    {
+        std::vector<uint64_t> in(count), out(count);
+        for (auto & value : in)
+            value = gen() % 1000;
+
+        InclusivePrefixSum(in.data(), out.data(), count);
+
+        uint64_t total = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            total += in[i];
+            EXPECT_EQ(out[i], total);
+        }
+    }
+}
+
+TEST(MatchingEngineBatchTest, SubmitBatchMatchesSequentialSubmission)
+{
+    auto records = GenerateScenario(ScenarioConfig::Preset(Scenario::MARKET_MAKER, 20'000, 4));
+    // Matching fills the submitted orders in place, so each engine gets its own copy
+    std::vector<OrderRequest> requests(records.size());
+    std::vector<OrderRequest> batchRequests(records.size());
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        records[i].Decode(requests[i]);
+        records[i].Decode(batchRequests[i]);
+    }
+
+    VectorOutputPolicy sequentialOutput;
+    MatchingEngine<VectorOutputPolicy> sequential(sequentialOutput, 4, records.size());
+    for (auto & req : requests)
+        sequential.ProcessRequest(req);
+
+    VectorOutputPolicy batchOutput;
+    MatchingEngine<VectorOutputPolicy> batched(batchOutput, 4, records.size());
+    for (size_t start = 0; start < batchRequests.size(); start += 100)
+        batched.SubmitBatch(std::span(batchRequests).subspan(start, std::min<size_t>(100, batchRequests.size() - start)));
+
+    ASSERT_EQ(batchOutput.events.size(), sequentialOutput.events.size());
+    for (size_t i = 0; i < batchOutput.events.size(); i++)
+    {
+        const auto & expected = sequentialOutput.events[i];
+        const auto & actual = batchOutput.events[i];
+        ASSERT_EQ(actual.type, expected.type) << "event " << i;
+        ASSERT_EQ(actual.orderId, expected.orderId) << "event " << i;
+        ASSERT_EQ(actual.requestId, expected.requestId) << "event " << i;
+        if (expected.type == EventType::ORDER_FILLED)
+        {
+            ASSERT_EQ(actual.restingOrderId, expected.restingOrderId) << "event " << i;
+            ASSERT_EQ(actual.tradeId, expected.tradeId) << "event " << i;
+            ASSERT_EQ(actual.quantity, expected.quantity) << "event " << i;
+        }
+    }
+}
+
+TEST(MatchingEngineBatchTest, QueueOutputPublishesBatchAtEnd)
+{
+    auto queue = std::make_shared<SPSCQueue<MarketDataEvent>>(64);
+    QueueOutputPolicy output(queue);
+
+    output.BeginBatch();
+    for (uint64_t id = 0; id < 10; id++)
+        output.OnMarketEvent(MarketDataEvent(id, id));
+    EXPECT_TRUE(queue->IsEmpty());
+
+    output.EndBatch();
+    for (uint64_t id = 0; id < 10; id++)
+    {
+        auto event = queue->GetReadIndex();
+        ASSERT_NE(event, nullptr);
+        EXPECT_EQ(event->orderId, id);
+        queue->UpdateReadIndex();
+    }
+    EXPECT_TRUE(queue->IsEmpty());
+}
+
+// Every field but the timestamp
+static auto EventFields(const MarketDataEvent & e)
+{
+    return std::tuple(e.type, e.orderId, e.requestId, e.symbolId, e.side, e.tradeId, e.restingOrderId, e.price, e.quantity, e.rejectionReason);
+}
+
+static std::vector<MarketDataEvent> RunRequests(std::vector<OrderRequest> requests, size_t numSymbols, size_t maxNumOrders)
+{
+    VectorOutputPolicy output;
+    MatchingEngine<VectorOutputPolicy> engine(nullptr, output, numSymbols, maxNumOrders);
+    for (auto & req : requests)
+        engine.ProcessRequest(req);
+    return output.events;
+}
+
+TEST(DeterminismTest, ParallelEnginesReproduceSequentialRun)
+{
+    const size_t numSymbols = 10;
+    auto records = GenerateScenario(ScenarioConfig::Preset(Scenario::ZIPF, 50'000, numSymbols));
+    std::vector<OrderRequest> requests(records.size());
+    for (size_t i = 0; i < records.size(); i++)
+        records[i].Decode(requests[i]);
+
+    auto expected = RunRequests(requests, numSymbols, records.size());
+
+    // Engines share no state, so replays running side by side trade and number trades alike
+    std::vector<std::vector<MarketDataEvent>> results(4);
+    std::vector<std::thread> threads;
+    for (auto & result : results)
+        threads.emplace_back([&] { result = RunRequests(requests, numSymbols, records.size()); });
+    for (auto & thread : threads)
+        thread.join();
+
+    for (const auto & result : results)
+    {
+        ASSERT_EQ(result.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); i++)
+            ASSERT_EQ(EventFields(result[i]), EventFields(expected[i])) << "event " << i;
+    }
+}
+
+TEST(DeterminismTest, ShardedSymbolsNumberTradesLikeOneEngine)
+{
+    const size_t numSymbols = 10;
+    auto records = GenerateScenario(ScenarioConfig::Preset(Scenario::UNIFORM, 50'000, numSymbols));
+    std::vector<OrderRequest> requests(records.size());
+    for (size_t i = 0; i < records.size(); i++)
+        records[i].Decode(requests[i]);
+
+    // Orders go to the shard of their symbol's parity, cancels and modifies follow their
+    // target and mass cancels go to both
+    std::array<std::vector<OrderRequest>, 2> shards;
+    std::map<uint64_t, SymbolId> symbolOf;
+    for (const auto & req : requests)
+    {
+        std::optional<SymbolId> symbolId;
+        if (auto order = std::get_if<Order>(&req.data))
+            symbolId = symbolOf[order->orderId] = order->symbolId;
+        else if (auto cancel = std::get_if<CancelRequest>(&req.data); cancel && symbolOf.contains(cancel->targetOrderId))
+            symbolId = symbolOf[cancel->targetOrderId];
+        else if (auto modify = std::get_if<ModifyRequest>(&req.data); modify && symbolOf.contains(modify->targetOrderId))
+            symbolId = symbolOf[modify->targetOrderId];
+
+        if (symbolId)
+            shards[*symbolId % 2].push_back(req);
+        else
+        {
+            shards[0].push_back(req);
+            shards[1].push_back(req);
+        }
+    }
+
+    auto FillsBySymbol = [](const std::vector<MarketDataEvent> & events)
+    {
+        std::map<SymbolId, std::vector<decltype(EventFields(events[0]))>> fills;
+        for (const auto & event : events)
+            if (event.type == EventType::ORDER_FILLED)
+                fills[event.symbolId].push_back(EventFields(event));
+        return fills;
+    };
+
+    auto expected = FillsBySymbol(RunRequests(requests, numSymbols, records.size()));
+
+    std::array<std::vector<MarketDataEvent>, 2> shardEvents;
+    std::thread even([&] { shardEvents[0] = RunRequests(shards[0], numSymbols, records.size()); });
+    std::thread odd([&] { shardEvents[1] = RunRequests(shards[1], numSymbols, records.size()); });
+    even.join();
+    odd.join();
+
+    auto actual = FillsBySymbol(shardEvents[0]);
+    actual.merge(FillsBySymbol(shardEvents[1]));
+
+    ASSERT_EQ(actual.size(), numSymbols);
+    EXPECT_EQ(actual, expected);
+    for (const auto & [symbolId, fills] : actual)
+        EXPECT_EQ(std::get<5>(fills.front()) >> 48, symbolId);
+}
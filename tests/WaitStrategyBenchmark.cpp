@@ -0,0 +1,86 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <ctime>
+
+#include <benchmark/benchmark.h>
+
+#include "SPSCQueue.hpp"
+#include "WaitStrategy.hpp"
+#include "LatencyStats.hpp"
+#include "Timer.hpp"
+
+static double ThreadCpuNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Producer sends a timestamp after every idle gap of N microseconds. Reports how long the
+// consumer took to notice each message and how much CPU the consumer burnt meanwhile.
+template<typename WaitStrategy>
+static void BM_WakeupLatency(benchmark::State& state)
+{
+    const auto idleGap = std::chrono::microseconds(state.range(0));
+    const size_t numMessages = 500;
+
+    SPSCQueue<uint64_t> queue(1024);
+
+    for (auto _ : state)
+    {
+        LatencyStats latencies;
+        double consumerCpuNs = 0;
+
+        std::thread consumer([&] {
+            WaitStrategy waitStrategy;
+            double cpuStart = ThreadCpuNs();
+
+            size_t received = 0;
+            while (received < numMessages)
+            {
+                uint64_t* sent = queue.GetReadIndex();
+                if (sent == nullptr)
+                {
+                    waitStrategy.Idle(queue);
+                    continue;
+                }
+                waitStrategy.Reset();
+
+                latencies.record(Timer::rdtsc() - *sent);
+                queue.UpdateReadIndex();
+                received++;
+            }
+
+            consumerCpuNs = ThreadCpuNs() - cpuStart;
+        });
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < numMessages; i++)
+        {
+            std::this_thread::sleep_for(idleGap);
+
+            uint64_t* slot = nullptr;
+            while ((slot = queue.GetWriteIndex()) == nullptr)
+                _mm_pause();
+            *slot = Timer::rdtsc();
+            queue.UpdateWriteIndex();
+        }
+        consumer.join();
+        auto wallNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+        state.SetIterationTime(wallNs / 1e9);
+        state.counters["wakeup_p50_ns"] = Timer::cycles_to_ns(latencies.percentile(0.5));
+        state.counters["wakeup_p99_ns"] = Timer::cycles_to_ns(latencies.percentile(0.99));
+        state.counters["wakeup_max_ns"] = Timer::cycles_to_ns(latencies.percentile(1.0));
+        state.counters["consumer_cpu_pct"] = 100.0 * consumerCpuNs / wallNs;
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_WakeupLatency, BusySpinWait)->Arg(10)->Arg(100)->Arg(1000)->UseManualTime()->Iterations(1);
+BENCHMARK_TEMPLATE(BM_WakeupLatency, SpinYieldWait)->Arg(10)->Arg(100)->Arg(1000)->UseManualTime()->Iterations(1);
+BENCHMARK_TEMPLATE(BM_WakeupLatency, SpinFutexWait)->Arg(10)->Arg(100)->Arg(1000)->UseManualTime()->Iterations(1);
+BENCHMARK_TEMPLATE(BM_WakeupLatency, SpinUmwaitWait)->Arg(10)->Arg(100)->Arg(1000)->UseManualTime()->Iterations(1);
+BENCHMARK_TEMPLATE(BM_WakeupLatency, BackoffWait)->Arg(10)->Arg(100)->Arg(1000)->UseManualTime()->Iterations(1);
+
+BENCHMARK_MAIN();